@@ -19,6 +19,7 @@
 #include "phase_encoding.h"
 #include "progressbar.h"
 #include "algo/threaded_loop.h"
+#include "algo/voxel_block.h"
 #include "dwi/gradient.h"
 #include "dwi/shells.h"
 #include "math/SH.h"
@@ -106,6 +107,44 @@ class Amp2SHCommon { MEMALIGN(Amp2SHCommon)
 
 
 
+// Without Rician bias correction, the mapping is linear, and is computed for
+//   a whole row of voxels at a time as a single matrix-matrix product
+class Amp2SHLinear { MEMALIGN(Amp2SHLinear)
+  public:
+    Amp2SHLinear (const Amp2SHCommon& common) :
+      C (common),
+      a (amp_volumes (common)),
+      bzeros (common.bzeros) { }
+
+    void operator() (const size_t axis, Image<value_type>& SH, Image<value_type>& amp)
+    {
+      a.load (amp, axis);
+      c.data.noalias() = C.amp2sh * a.data;
+      if (C.normalise) {
+        bzeros.load (amp, axis);
+        for (ssize_t n = 0; n != c.data.cols(); ++n)
+          c.data.col (n) *= C.bzeros.size() / (1.0 + bzeros.data.col (n).sum());
+      }
+      c.store (SH, axis);
+    }
+
+  protected:
+    const Amp2SHCommon& C;
+    VoxelBlock<> a, bzeros, c;
+
+    static vector<size_t> amp_volumes (const Amp2SHCommon& common) {
+      if (common.dwis.size())
+        return common.dwis;
+      vector<size_t> volumes (common.amp2sh.cols());
+      for (size_t n = 0; n != volumes.size(); ++n)
+        volumes[n] = n;
+      return volumes;
+    }
+};
+
+
+
+
 class Amp2SH { MEMALIGN(Amp2SH)
   public:
     Amp2SH (const Amp2SHCommon& common) :
@@ -114,16 +153,6 @@ class Amp2SH { MEMALIGN(Amp2SH)
       s (common.amp2sh.rows()),
       c (common.amp2sh.rows()) { }
 
-    template <class SHImageType, class AmpImageType>
-      void operator() (SHImageType& SH, AmpImageType& amp)
-      {
-        get_amps (amp);
-        c.noalias() = C.amp2sh * a;
-        write_SH (SH);
-      }
-
-
-
     // Rician-corrected version:
     template <class SHImageType, class AmpImageType, class NoiseImageType>
       void operator() (SHImageType& SH, AmpImageType& amp, const NoiseImageType& noise)
@@ -262,7 +291,6 @@ void run ()
       .run (Amp2SH (common), SH, amp, noise);
   }
   else {
-    ThreadedLoop ("mapping amplitudes to SH coefficients", amp, 0, 3)
-      .run (Amp2SH (common), SH, amp);
+    ThreadedVoxelBlockLoop ("mapping amplitudes to SH coefficients", amp, Amp2SHLinear (common), SH, amp);
   }
 }
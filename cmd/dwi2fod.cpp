@@ -117,43 +117,60 @@ void usage ()
 
 
 
-class CSD_Processor { MEMALIGN(CSD_Processor)
+// Processes one line of voxels along the inner axis at a time, such that
+//   the deconvolution can be performed for all voxels in that line at once
+template <typename ValueType>
+class CSD_Processor { MEMALIGN(CSD_Processor<ValueType>)
   public:
-    CSD_Processor (const DWI::SDeconv::CSD::Shared& shared, Image<bool>& mask) :
+    CSD_Processor (const DWI::SDeconv::CSD::Shared& shared, const size_t axis, Image<float>& dwi, Image<float>& fod, Image<bool>& mask) :
       sdeconv (shared),
-      data (shared.dwis.size()),
-      mask (mask) { }
+      axis (axis),
+      dwi (dwi),
+      fod (fod),
+      mask (mask),
+      data (shared.dwis.size(), dwi.size (axis)) { }
 
 
-    void operator () (Image<float>& dwi, Image<float>& fod) {
-      if (!load_data (dwi)) {
-        for (auto l = Loop (3) (fod); l; ++l)
-          fod.value() = 0.0;
-        return;
+    void operator () (const Iterator& pos) {
+      assign_pos_of (pos).to (dwi, fod);
+
+      voxels.clear();
+      for (auto l = Loop (axis) (dwi); l; ++l) {
+        if (load_data (voxels.size()))
+          voxels.push_back (dwi.index (axis));
       }
 
-      sdeconv.set (data);
+      for (auto l = Loop (axis) (fod); l; ++l)
+        for (auto l2 = Loop (3) (fod); l2; ++l2)
+          fod.value() = 0.0;
+      if (voxels.empty())
+        return;
 
-      size_t n;
-      for (n = 0; n < sdeconv.shared.niter; n++)
-        if (sdeconv.iterate())
-          break;
+      sdeconv (data.leftCols (voxels.size()), FODs);
 
-      if (sdeconv.shared.niter && n >= sdeconv.shared.niter)
+      for (auto n : sdeconv.unconverged()) {
+        dwi.index (axis) = voxels[n];
         INFO ("voxel [ " + str (dwi.index(0)) + " " + str (dwi.index(1)) + " " + str (dwi.index(2)) +
             " ] did not reach full convergence");
+      }
 
-      fod.row(3) = sdeconv.FOD();
+      for (size_t n = 0; n != voxels.size(); ++n) {
+        fod.index (axis) = voxels[n];
+        fod.row(3) = FODs.col (n).template cast<float>();
+      }
     }
 
 
   private:
-    DWI::SDeconv::CSD sdeconv;
-    Eigen::VectorXd data;
+    DWI::SDeconv::CSD::Batch<ValueType> sdeconv;
+    const size_t axis;
+    Image<float> dwi, fod;
     Image<bool> mask;
+    typename DWI::SDeconv::CSD::Batch<ValueType>::matrix_type data, FODs;
+    vector<ssize_t> voxels;
 
 
-    bool load_data (Image<float>& dwi) {
+    bool load_data (const size_t column) {
       if (mask.valid()) {
         assign_pos_of (dwi, 0, 3).to (mask);
         if (!mask.value())
@@ -162,11 +179,11 @@ class CSD_Processor { MEMALIGN(CSD_Processor)
 
       for (size_t n = 0; n < sdeconv.shared.dwis.size(); n++) {
         dwi.index(3) = sdeconv.shared.dwis[n];
-        data[n] = dwi.value();
-        if (!std::isfinite (data[n]))
+        data(n, column) = dwi.value();
+        if (!std::isfinite (data(n, column)))
           return false;
-        if (data[n] < 0.0)
-          data[n] = 0.0;
+        if (data(n, column) < 0.0)
+          data(n, column) = 0.0;
       }
 
       return true;
@@ -187,7 +204,8 @@ class MSMT_Processor { MEMALIGN (MSMT_Processor)
         odf_images (odf_images),
         modelled_image (dwi_modelled),
         dwi_data (shared.grad.rows()),
-        output_data (shared.problem.H.cols()) { }
+        output_data (shared.problem.H.cols()),
+        previous_voxel (Eigen::Array3i::Constant (-2)) { }
 
 
     void operator() (Image<float>& dwi_image)
@@ -200,7 +218,16 @@ class MSMT_Processor { MEMALIGN (MSMT_Processor)
 
       dwi_data = dwi_image.row(3);
 
-      sdeconv (dwi_data, output_data);
+      // With -warm_start, if the previous voxel processed by this thread
+      //   is adjacent to this one, use its active set to initialise the
+      //   solver, since this is likely to be close to the final solution
+      const Eigen::Array3i voxel (dwi_image.index(0), dwi_image.index(1), dwi_image.index(2));
+      if (sdeconv.shared.warm_start && (voxel - previous_voxel).abs().sum() == 1)
+        sdeconv (dwi_data, output_data, previous_active_set);
+      else
+        sdeconv (dwi_data, output_data);
+      previous_voxel = voxel;
+      previous_active_set = sdeconv.active_set();
       if (sdeconv.niter >= sdeconv.shared.problem.max_niter) {
         INFO ("voxel [ " + str (dwi_image.index(0)) + " " + str (dwi_image.index(1)) + " " + str (dwi_image.index(2)) +
             " ] did not reach full convergence");
@@ -228,6 +255,8 @@ class MSMT_Processor { MEMALIGN (MSMT_Processor)
     Image<float> modelled_image;
     Eigen::VectorXd dwi_data;
     Eigen::VectorXd output_data;
+    Eigen::Array3i previous_voxel;
+    vector<bool> previous_active_set;
 };
 
 
@@ -275,10 +304,15 @@ void run ()
     header_out.size(3) = shared.nSH();
     auto fod = Image<float>::create (argument[3], header_out);
 
-    CSD_Processor processor (shared, mask);
     auto dwi = header_in.get_image<float>().with_direct_io (3);
-    ThreadedLoop ("performing constrained spherical deconvolution", dwi, 0, 3)
-        .run (processor, dwi, fod);
+    auto loop = ThreadedLoop ("performing constrained spherical deconvolution", dwi, 0, 3);
+    if (get_options ("single_precision").size()) {
+      CSD_Processor<float> processor (shared, loop.inner_axes[0], dwi, fod, mask);
+      loop.run_outer (processor);
+    } else {
+      CSD_Processor<double> processor (shared, loop.inner_axes[0], dwi, fod, mask);
+      loop.run_outer (processor);
+    }
 
   } else if (algorithm == 1) {
 
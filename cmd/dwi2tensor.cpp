@@ -19,6 +19,7 @@
 #include "progressbar.h"
 #include "image.h"
 #include "algo/threaded_copy.h"
+#include "algo/voxel_block.h"
 #include "dwi/gradient.h"
 #include "dwi/tensor.h"
 
@@ -107,6 +108,11 @@ void usage ()
 
 
 
+// Each row of voxels is processed at once: the data are log-transformed as a
+//   block and, with -ols, the initial ordinary least-squares fit is computed
+//   for all voxels as a single matrix-matrix product. The default initial WLS
+//   fit weights each voxel by its own signal intensities, so it, and any
+//   subsequent reweighted iterations, are performed voxel by voxel
 template <class MASKType, class B0Type, class DKTType, class PredictType>
 class Processor { MEMALIGN(Processor)
   public:
@@ -122,60 +128,89 @@ class Processor { MEMALIGN(Processor)
       work(b.cols(),b.cols()),
       llt(work.rows()),
       b(b),
+      ols_llt (b.transpose()*b),
       ols (ols),
       maxit(iter) { }
 
     template <class DWIType, class DTType>
-      void operator() (DWIType& dwi_image, DTType& dt_image)
+      void operator() (const size_t axis, DWIType& dwi_image, DTType& dt_image)
       {
         if (mask_image.valid()) {
           assign_pos_of (dwi_image, 0, 3).to (mask_image);
-          if (!mask_image.value())
-            return;
+          mask.load (mask_image, axis);
         }
 
-        for (auto l = Loop (3) (dwi_image); l; ++l)
-          dwi[dwi_image.index(3)] = dwi_image.value();
-
-        double small_intensity = 1.0e-6 * dwi.maxCoeff();
-        for (int i = 0; i < dwi.rows(); i++) {
-          if (dwi[i] < small_intensity)
-            dwi[i] = small_intensity;
-          w[i] = ( ols ? 1.0 : dwi[i] );
-          dwi[i] = std::log (dwi[i]);
+        dwi_block.load (dwi_image, axis);
+        const ssize_t num_voxels = dwi_block.data.cols();
+        weights.resize (dwi_block.data.rows(), num_voxels);
+        for (ssize_t n = 0; n < num_voxels; ++n) {
+          auto dwi_col = dwi_block.data.col (n);
+          double small_intensity = 1.0e-6 * dwi_col.maxCoeff();
+          for (int i = 0; i < dwi_col.rows(); i++) {
+            if (dwi_col[i] < small_intensity)
+              dwi_col[i] = small_intensity;
+            weights(i,n) = ( ols ? 1.0 : dwi_col[i] );
+            dwi_col[i] = std::log (dwi_col[i]);
+          }
         }
 
-        for (int it = 0; it <= maxit; it++) {
-          work.setZero();
-          work.selfadjointView<Eigen::Lower>().rankUpdate (b.transpose()*w.asDiagonal());
-          p = llt.compute (work.selfadjointView<Eigen::Lower>()).solve(b.transpose()*w.asDiagonal()*w.asDiagonal()*dwi);
-          if (maxit > 1)
-            w = (b*p).array().exp();
-        }
+        if (ols)
+          P = ols_llt.solve (b.transpose() * dwi_block.data);
+        else
+          P.resize (b.cols(), num_voxels);
+
+        for (ssize_t n = 0; n < num_voxels; ++n) {
+          if (mask_image.valid() && !mask.data(0,n)) {
+            P.col(n).setZero();
+            continue;
+          }
 
-        for (auto l = Loop(3)(dt_image); l; ++l) {
-          dt_image.value() = p[dt_image.index(3)];
+          dwi = dwi_block.data.col (n);
+          w = weights.col (n);
+          int it = 0;
+          if (ols) {
+            // first iteration already computed for the whole row
+            p = P.col (n);
+            if (maxit > 1)
+              w = (b*p).array().exp();
+            it = 1;
+          }
+          for (; it <= maxit; it++) {
+            work.setZero();
+            work.selfadjointView<Eigen::Lower>().rankUpdate (b.transpose()*w.asDiagonal());
+            p = llt.compute (work.selfadjointView<Eigen::Lower>()).solve(b.transpose()*w.asDiagonal()*w.asDiagonal()*dwi);
+            if (maxit > 1)
+              w = (b*p).array().exp();
+          }
+          P.col (n) = p;
         }
 
+        dt.data = P.topRows (6);
+        dt.store (dt_image, axis);
+
         if (b0_image.valid()) {
           assign_pos_of (dwi_image, 0, 3).to (b0_image);
-          b0_image.value() = exp(p[6]);
+          output.data = P.row (6).array().exp();
+          zero_outside_mask (output.data);
+          output.store (b0_image, axis);
         }
 
         if (dkt_image.valid()) {
           assign_pos_of (dwi_image, 0, 3).to (dkt_image);
-          double adc_sq = (p[0]+p[1]+p[2])*(p[0]+p[1]+p[2])/9.0;
-          for (auto l = Loop(3)(dkt_image); l; ++l) {
-            dkt_image.value() = p[dkt_image.index(3)+7]/adc_sq;
+          output.data.resize (15, num_voxels);
+          for (ssize_t n = 0; n < num_voxels; ++n) {
+            double adc_sq = (P(0,n)+P(1,n)+P(2,n))*(P(0,n)+P(1,n)+P(2,n))/9.0;
+            output.data.col (n) = P.col(n).segment (7, 15) / adc_sq;
           }
+          zero_outside_mask (output.data);
+          output.store (dkt_image, axis);
         }
 
         if (predict_image.valid()) {
           assign_pos_of (dwi_image, 0, 3).to (predict_image);
-          dwi = (b*p).array().exp();
-          for (auto l = Loop(3)(predict_image); l; ++l) {
-            predict_image.value() = dwi[predict_image.index(3)];
-          }
+          output.data = (b*P).array().exp();
+          zero_outside_mask (output.data);
+          output.store (predict_image, axis);
         }
 
       }
@@ -191,8 +226,20 @@ class Processor { MEMALIGN(Processor)
     Eigen::MatrixXd work;
     Eigen::LLT<Eigen::MatrixXd> llt;
     const Eigen::MatrixXd& b;
+    const Eigen::LLT<Eigen::MatrixXd> ols_llt;
     const bool ols;
     const int maxit;
+    VoxelBlock<> mask, dwi_block, dt, output;
+    Eigen::MatrixXd weights, P;
+
+    void zero_outside_mask (Eigen::MatrixXd& data) const {
+      if (!mask_image.valid())
+        return;
+      for (ssize_t n = 0; n < data.cols(); ++n) {
+        if (!mask.data(0,n))
+          data.col(n).setZero();
+      }
+    }
 };
 
 template <class MASKType, class B0Type, class DKTType, class PredictType>
@@ -248,6 +295,6 @@ void run ()
 
   Eigen::MatrixXd b = -DWI::grad2bmatrix<double> (grad, opt.size()>0);
 
-  ThreadedLoop("computing tensors", dwi, 0, 3).run (processor (b, ols, iter, mask, b0, dkt, predict), dwi, dt);
+  ThreadedVoxelBlockLoop ("computing tensors", dwi, processor (b, ols, iter, mask, b0, dkt, predict), dwi, dt);
 }
 
@@ -95,7 +95,9 @@ void usage ()
   + Argument ("in_fixel_directory", "the fixel directory containing the data files for each subject (after obtaining fixel correspondence").type_directory_in()
 
   + Argument ("subjects", "a text file listing the subject identifiers (one per line). This should correspond with the filenames "
-                          "in the fixel directory (including the file extension), and be listed in the same order as the rows of the design matrix.").type_image_in ()
+                          "in the fixel directory (including the file extension), and be listed in the same order as the rows of the design matrix. "
+                          "Alternatively, a packed fixel data file (as generated by the fixelconvert command) containing the data for all subjects, "
+                          "with columns in the same order as the rows of the design matrix.").type_image_in ()
 
   + Argument ("design", "the design matrix").type_file_in ()
 
@@ -159,7 +161,8 @@ class SubjectFixelImport : public Math::Stats::SubjectDataImportBase
     SubjectFixelImport (const std::string& path) :
         Math::Stats::SubjectDataImportBase (path),
         H (Header::open (path)),
-        data (H.get_image<float>())
+        data (H.get_image<float>()),
+        column (0)
     {
       for (size_t axis = 1; axis < data.ndim(); ++axis) {
         if (data.size(axis) > 1)
@@ -167,9 +170,22 @@ class SubjectFixelImport : public Math::Stats::SubjectDataImportBase
       }
     }
 
+    // Import a single column of a packed fixel data file; all columns
+    //   share the same (memory-mapped) image
+    SubjectFixelImport (const Header& packed_header, const Image<float>& packed_data, const std::string& name, const size_t column) :
+        Math::Stats::SubjectDataImportBase (name),
+        H (packed_header),
+        data (packed_data),
+        column (column)
+    {
+      H.size(1) = 1;
+      H.keyval().erase (Fixel::packed_columns_key);
+    }
+
     void operator() (matrix_type::RowXpr row) const override
     {
       Image<float> temp (data); // For thread-safety
+      temp.index(1) = column;
       for (temp.index(0) = 0; temp.index(0) != temp.size(0); ++temp.index(0))
         row [temp.index(0)] = temp.value();
     }
@@ -178,6 +194,7 @@ class SubjectFixelImport : public Math::Stats::SubjectDataImportBase
     {
       Image<float> temp (data); // For thread-safety
       temp.index(0) = index;
+      temp.index(1) = column;
       assert (!is_out_of_bounds (temp));
       return default_type(temp.value());
     }
@@ -191,11 +208,32 @@ class SubjectFixelImport : public Math::Stats::SubjectDataImportBase
   private:
     Header H;
     Image<float> data; // May be mapped input file, or scratch smoothed data
+    const size_t column;
 
 };
 
 
 
+// Import subject data either from a text file listing fixel data files,
+//   or from the columns of a packed fixel data file
+void import_subjects (Math::Stats::CohortDataImport& importer, const std::string& path, const std::string& fixel_directory = "")
+{
+  if (Path::has_suffix (path, Fixel::supported_sparse_formats)) {
+    std::string packed_path = path;
+    if (fixel_directory.size() && !Path::is_file (packed_path) && Path::is_file (Path::join (fixel_directory, path)))
+      packed_path = Path::join (fixel_directory, path);
+    Header packed_header (Header::open (packed_path));
+    const auto columns = Fixel::get_packed_columns (packed_header);
+    auto packed_data = packed_header.get_image<float>();
+    for (size_t i = 0; i != columns.size(); ++i)
+      importer.add (std::make_shared<SubjectFixelImport> (packed_header, packed_data, columns[i], i));
+    return;
+  }
+  importer.initialise<SubjectFixelImport> (path, fixel_directory);
+}
+
+
+
 
 void run()
 {
@@ -246,7 +284,7 @@ void run()
   // Read file names and check files exist
   // Preference for finding files relative to input template fixel directory
   Math::Stats::CohortDataImport importer;
-  importer.initialise<SubjectFixelImport> (argument[1], input_fixel_directory);
+  import_subjects (importer, argument[1], input_fixel_directory);
   for (size_t i = 0; i != importer.size(); ++i) {
     if (!Fixel::fixels_match (index_header, dynamic_cast<SubjectFixelImport*>(importer[i].get())->header()))
       throw Exception ("Fixel data file \"" + importer[i]->name() + "\" does not match template fixel image");
@@ -265,7 +303,7 @@ void run()
   opt = get_options ("column");
   for (size_t i = 0; i != opt.size(); ++i) {
     extra_columns.push_back (Math::Stats::CohortDataImport());
-    extra_columns[i].initialise<SubjectFixelImport> (opt[i][0]);
+    import_subjects (extra_columns[i], opt[i][0]);
     // Check for non-finite values in mask fixels only
     // Can't use generic allFinite() function; need to populate matrix data
     if (!nans_in_columns) {
@@ -344,13 +382,7 @@ void run()
   output_header.keyval()["cfe_legacy"] = str(cfe_legacy);
 
   matrix_type data = matrix_type::Zero (importer.size(), num_fixels);
-  {
-    ProgressBar progress (std::string ("Loading fixel data (no smoothing)"), importer.size());
-    for (size_t subject = 0; subject != importer.size(); subject++) {
-      (*importer[subject]) (data.row (subject));
-      progress++;
-    }
-  }
+  importer.load (data, "Loading fixel data (no smoothing)");
   // Detect non-finite values in mask fixels only; NaN-fill other fixels
   bool nans_in_data = false;
   for (auto l = Loop(0) (mask); l; ++l) {
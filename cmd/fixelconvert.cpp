@@ -14,6 +14,8 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+#include <fstream>
+
 #include "command.h"
 #include "image.h"
 #include "progressbar.h"
@@ -44,7 +46,21 @@ void usage ()
 
   AUTHOR = "David Raffelt (david.raffelt@florey.edu.au) and Robert E. Smith (robert.smith@florey.edu.au)";
 
-  SYNOPSIS = "Convert between the old format fixel image (.msf / .msh) and the new fixel directory format";
+  SYNOPSIS = "Convert between the old format fixel image (.msf / .msh) and the new fixel directory format, "
+             "or between fixel data files and a packed fixel data file";
+
+  DESCRIPTION
+  + "A packed fixel data file holds the contents of many fixel data files (e.g. the same "
+    "metric for every subject in a study) as the columns of a single fixel data file, "
+    "with the name of each column stored in the image header. If the input is a fixel "
+    "directory and the output is an image in MRtrix format, the fixel data files in the "
+    "directory (or those listed using the -columns option) are packed into the output "
+    "file; if the input is a packed fixel data file and the output is a directory, each "
+    "column is written to a separate fixel data file within that directory."
+
+  + "Data for each column are stored contiguously; if stored in uncompressed .mif format, "
+    "the packed file is memory-mapped on access, allowing commands such as fixelcfestats "
+    "to load the data for all subjects from a single file concurrently.";
 
   EXAMPLES
   + Example ("Convert from the old file format to the new directory format",
@@ -70,7 +86,20 @@ void usage ()
              "for all output fixels in both the \"size\" and \"value\" fields of the "
              "\"FixelMetric\" class, unless the -in_size and/or -value options are "
              "used respectively to indicate which fixel data files should be used as "
-             "the source(s) of this information.");
+             "the source(s) of this information.")
+
+  + Example ("Pack the data of all subjects into a single file",
+             "fixelconvert fd/ fd/packed.mif -columns subjects.txt",
+             "Here the fixel data files listed in subjects.txt (relative to the fixel "
+             "directory, one per line) are packed into a single file, in that order; "
+             "this file can then be provided to fixelcfestats in place of the list "
+             "of subjects.")
+
+  + Example ("Unpack a packed fixel data file",
+             "fixelconvert fd/packed.mif fd_unpacked/",
+             "This writes each column of the packed file as a separate fixel data file, "
+             "named according to the column name, into the output fixel directory, "
+             "alongside copies of the index and directions files.");
 
   ARGUMENTS
   + Argument ("fixel_in",  "the input fixel file / directory.").type_various()
@@ -89,7 +118,12 @@ void usage ()
     + Option ("value", "nominate the data file to import to the 'value' field in the old format")
       + Argument ("path").type_file_in()
     + Option ("in_size", "import data for the 'size' field in the old format")
-      + Argument ("path").type_file_in();
+      + Argument ("path").type_file_in()
+
+  + OptionGroup ("Options for packing fixel data files")
+    + Option ("columns", "a text file listing the fixel data files to be packed (one per line, relative to the input fixel directory), "
+                         "in the order in which they are to be stored (default: all single-column fixel data files in the directory)")
+      + Argument ("file").type_file_in();
 
 }
 
@@ -260,6 +294,88 @@ void convert_new2old ()
 
 
 
+void convert_directory2packed ()
+{
+  const std::string input_fixel_directory = argument[0];
+  Header H_index = Fixel::find_index_header (input_fixel_directory);
+
+  vector<Header> H_data;
+  vector<std::string> columns;
+  auto opt = get_options ("columns");
+  if (opt.size()) {
+    const std::string list_path = opt[0][0];
+    std::ifstream in (list_path.c_str());
+    if (!in)
+      throw Exception ("unable to open list of fixel data files \"" + list_path + "\"");
+    std::string line;
+    while (std::getline (in, line)) {
+      line = strip (line);
+      if (line.empty())
+        continue;
+      Header H = Header::open (Path::join (input_fixel_directory, line));
+      Fixel::check_fixel_size (H_index, H);
+      H_data.push_back (std::move (H));
+      columns.push_back (line);
+    }
+  } else {
+    for (auto& H : Fixel::find_data_headers (input_fixel_directory, H_index, false)) {
+      if (H.size(1) == 1 && !Fixel::is_packed_data_file (H)) {
+        columns.push_back (Path::basename (H.name()));
+        H_data.push_back (std::move (H));
+      }
+    }
+  }
+  if (H_data.empty())
+    throw Exception ("no fixel data files found to be packed");
+  for (const auto& H : H_data) {
+    if (H.size(1) != 1)
+      throw Exception ("fixel data file \"" + H.name() + "\" contains more than one parameter per fixel, and cannot be packed");
+  }
+
+  // Column names are stored in the header, so other formats cannot be used
+  if (!Path::is_mrtrix_image (argument[1]))
+    throw Exception ("packed fixel data files must be stored in MRtrix format (.mif / .mih / .mif.gz)");
+
+  auto output = Image<float>::create (argument[1], Fixel::packed_data_header_from_index (H_index, columns));
+  ProgressBar progress ("packing fixel data files", H_data.size());
+  for (size_t i = 0; i != H_data.size(); ++i) {
+    auto input = H_data[i].get_image<float>();
+    output.index(1) = i;
+    for (auto l = Loop (0) (input, output); l; ++l)
+      output.value() = input.value();
+    ++progress;
+  }
+}
+
+
+
+void convert_packed2directory ()
+{
+  Header H_in = Header::open (argument[0]);
+  const auto columns = Fixel::get_packed_columns (H_in);
+  const std::string input_fixel_directory = Fixel::get_fixel_directory (argument[0]);
+  Fixel::check_fixel_size (Fixel::find_index_header (input_fixel_directory), H_in);
+
+  const std::string output_fixel_directory = argument[1];
+  Fixel::copy_index_and_directions_file (input_fixel_directory, output_fixel_directory);
+
+  Header H_out (H_in);
+  H_out.size(1) = 1;
+  H_out.keyval().erase (Fixel::packed_columns_key);
+
+  auto input = H_in.get_image<float>();
+  ProgressBar progress ("unpacking fixel data files", columns.size());
+  for (size_t i = 0; i != columns.size(); ++i) {
+    auto output = Image<float>::create (Path::join (output_fixel_directory, columns[i]), H_out);
+    input.index(1) = i;
+    for (auto l = Loop (0) (input, output); l; ++l)
+      output.value() = input.value();
+    ++progress;
+  }
+}
+
+
+
 bool is_old_format (const std::string& path) {
   return (Path::has_suffix (path, ".msf") || Path::has_suffix (path, ".msh"));
 }
@@ -273,10 +389,15 @@ void run ()
     if (is_old_format (argument[1]))
       throw Exception ("fixelconvert can only be used to convert between old and new fixel formats; NOT to convert images within the old format");
     convert_old2new ();
-  } else {
-    if (!is_old_format (argument[1]))
-      throw Exception ("fixelconvert can only be used to convert between old and new fixel formats; NOT to convert within the new format");
+  } else if (is_old_format (argument[1])) {
     convert_new2old ();
+  } else if (Path::is_dir (argument[0])) {
+    convert_directory2packed ();
+  } else if (Fixel::is_packed_data_file (Header::open (argument[0]))) {
+    convert_packed2directory ();
+  } else {
+    throw Exception ("fixelconvert can only be used to convert between old and new fixel formats, "
+                     "or between fixel data files and packed fixel data files");
   }
 }
 
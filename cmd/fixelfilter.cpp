@@ -175,11 +175,19 @@ void run()
     Fixel::copy_index_and_directions_file (argument[0], argument[2]);
     ProgressBar progress (std::string ("Applying \"") + filters[argument[1]] + "\" operation to " + str(multiple_files.size()) + " fixel data files",
                           multiple_files.size());
-    for (auto& H : multiple_files) {
-      auto input_image = H.get_image<float>();
-      auto output_image = Image<float>::create (Path::join (argument[2], Path::basename (H.name())), H);
-      (*filter) (input_image, output_image);
-      ++progress;
+    // Files are passed to the filter in groups, such that filters able to
+    //   share work between multiple files can do so
+    const size_t group_size = 16;
+    for (size_t first = 0; first < multiple_files.size(); first += group_size) {
+      vector<Image<float>> input_images, output_images;
+      for (size_t i = first; i != std::min (first + group_size, multiple_files.size()); ++i) {
+        auto& H (multiple_files[i]);
+        input_images.push_back (H.get_image<float>());
+        output_images.push_back (Image<float>::create (Path::join (argument[2], Path::basename (H.name())), H));
+      }
+      (*filter) (input_images, output_images);
+      for (size_t i = 0; i != input_images.size(); ++i)
+        ++progress;
     }
   }
 
@@ -106,7 +106,15 @@ void run ()
   {
     std::mutex mutex;
     ProgressBar progress ("Generating meshes from labels", lower_corners.size() - 1);
-    auto loader = [&] (size_t& out) { static size_t i = 1; out = i++; return (out != lower_corners.size()); };
+    // Labels are meshed concurrently; dispatch those with the largest
+    //   bounding boxes first, so that they do not delay completion
+    vector<uint32_t> order;
+    for (uint32_t i = 1; i != lower_corners.size(); ++i)
+      order.push_back (i);
+    auto volume = [&] (const uint32_t i) { return (upper_corners[i] - lower_corners[i] + 1).max (0).prod(); };
+    std::stable_sort (order.begin(), order.end(), [&] (const uint32_t a, const uint32_t b) { return volume (a) > volume (b); });
+    size_t next = 0;
+    auto loader = [&] (size_t& out) { if (next == order.size()) return false; out = order[next++]; return true; };
 
     auto worker = [&] (const size_t& in)
     {
@@ -100,7 +100,15 @@ const OptionGroup SmoothOption = OptionGroup ("Options for smooth filter")
             "This can be specified either as a single value to be used for all axes, "
             "or as a comma-separated list of the extent for each axis. "
             "The default extent is 2 * ceil(2.5 * stdev / voxel_size) - 1.")
-  + Argument ("voxels").type_sequence_int();
+  + Argument ("voxels").type_sequence_int()
+
+  + Option ("recursive", "use a recursive approximation to the Gaussian along axes where the standard deviation "
+            "is at least 2 voxels, such that the computation time does not depend on the kernel width. "
+            "This approximates the full rather than truncated Gaussian kernel, and cannot be combined with -extent.")
+
+  + Option ("fft", "perform the convolution in the frequency domain along axes where the standard deviation "
+            "is at least 16 voxels. This produces the same result as the default spatial kernel (to within "
+            "round-off), but is faster for such large kernels.");
 
 const OptionGroup ZcleanOption = OptionGroup ("Options for zclean filter")
 + Option ("zupper", "define high intensity outliers: default: 2.5")
@@ -244,8 +252,15 @@ void run () {
         filter.set_stdev (stdevs);
       }
       opt = get_options ("extent");
-      if (opt.size())
+      if (opt.size()) {
+        if (get_options ("recursive").size())
+          throw Exception ("the extent and recursive options are mutually exclusive.");
         filter.set_extent (parse_ints<uint32_t> (opt[0][0]));
+      }
+      if (get_options ("recursive").size() && get_options ("fft").size())
+        throw Exception ("the recursive and fft options are mutually exclusive.");
+      filter.set_recursive (get_options ("recursive").size());
+      filter.set_fft (get_options ("fft").size());
       filter.set_message (std::string("applying ") + std::string(argument[1]) + " filter to image " + std::string(argument[0]));
       Stride::set_from_command_line (filter);
 
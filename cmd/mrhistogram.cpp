@@ -17,7 +17,9 @@
 #include "command.h"
 #include "header.h"
 #include "image.h"
+#include "adapter/replicate.h"
 #include "algo/histogram.h"
+#include "algo/threaded_reduce.h"
 
 using namespace MR;
 using namespace App;
@@ -81,15 +83,20 @@ class Volume_loop { MEMALIGN(Volume_loop)
 
 template <class Functor>
 void run_volume (Functor& functor, Image<float>& data, Image<bool>& mask)
+{
+  threaded_reduce (functor, data, mask, 0, 3);
+}
+
+
+
+template <class Functor>
+void run_all_volumes (Functor& functor, Image<float>& data, Image<bool>& mask)
 {
   if (mask.valid()) {
-    for (auto l = Loop(0,3) (data, mask); l; ++l) {
-      if (mask.value())
-        functor (float(data.value()));
-    }
+    Adapter::Replicate<Image<bool>> mask_replicate (mask, data);
+    threaded_reduce (functor, data, mask_replicate);
   } else {
-    for (auto l = Loop(0,3) (data); l; ++l)
-      functor (float(data.value()));
+    threaded_reduce (functor, data);
   }
 }
 
@@ -123,8 +130,7 @@ void run ()
   if (opt.size()) {
     calibrator.from_file (opt[0][0]);
   } else {
-    for (auto v = Volume_loop(data); v; ++v)
-      run_volume (calibrator, data, mask);
+    run_all_volumes (calibrator, data, mask);
     // If getting min/max using all volumes, but generating a single histogram per volume,
     //   then want the automatic calculation of bin width to be based on the number of
     //   voxels per volume, rather than the total number of values sent to the calibrator
@@ -145,8 +151,7 @@ void run ()
   if (allvolumes) {
 
     Algo::Histogram::Data histogram (calibrator);
-    for (auto v = Volume_loop(data); v; ++v)
-      run_volume (histogram, data, mask);
+    run_all_volumes (histogram, data, mask);
     for (size_t i = 0; i != nbins; ++i)
       output << histogram[i] << ",";
     output << "\n";
@@ -23,6 +23,7 @@
 #include "registration/multi_contrast.h"
 #include "registration/linear.h"
 #include "registration/nonlinear.h"
+#include "registration/pyramid.h"
 #include "registration/metric/demons.h"
 #include "registration/metric/mean_squared.h"
 #include "registration/metric/difference_robust.h"
@@ -107,6 +108,10 @@ void usage ()
 
   + Option("nan", "use NaN as out of bounds value. (Default: 0.0)")
 
+  + Option ("pyramid_cache", "a directory in which to store the smoothed multi-resolution images of image2, "
+    "such that these can be reused by subsequent registrations to the same image2 (e.g. a population template).")
+    + Argument ("directory").type_directory_in ()
+
   + Registration::rigid_options
 
   + Registration::affine_options
@@ -835,6 +840,14 @@ void run () {
   Registration::preload_data (input2, images2, mc_params);
   INFO ("preloading input images done");
 
+  // smoothed multi-resolution images are computed once and shared across registration stages
+  opt = get_options ("pyramid_cache");
+  auto pyramid1 = std::make_shared<Registration::Pyramid> (images1);
+  auto pyramid2 = std::make_shared<Registration::Pyramid> (images2, opt.size() ? std::string (opt[0][0]) : std::string());
+  if (do_rigid) rigid_registration.set_pyramids (pyramid1, pyramid2);
+  if (do_affine) affine_registration.set_pyramids (pyramid1, pyramid2);
+  if (do_nonlinear) nl_registration.set_pyramids (pyramid1, pyramid2);
+
   // ****** RUN RIGID REGISTRATION *******
   if (do_rigid) {
     CONSOLE ("running rigid registration");
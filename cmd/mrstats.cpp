@@ -24,8 +24,10 @@
 #include "stats.h"
 #include "types.h"
 
+#include "adapter/replicate.h"
 #include "algo/histogram.h"
 #include "algo/loop.h"
+#include "algo/threaded_reduce.h"
 #include "file/ofstream.h"
 
 
@@ -98,15 +100,7 @@ class Volume_loop
 
 void run_volume (Stats::Stats& stats, Image<complex_type>& data, Image<bool>& mask)
 {
-  if (mask.valid()) {
-    for (auto l = Loop(0,3) (data, mask); l; ++l) {
-      if (mask.value())
-        stats (data.value());
-    }
-  } else {
-    for (auto l = Loop(0,3) (data); l; ++l)
-      stats (data.value());
-  }
+  threaded_reduce (stats, data, mask, 0, 3);
 }
 
 
@@ -140,8 +134,12 @@ void run ()
   if (get_options ("allvolumes").size()) {
 
     Stats::Stats stats (is_complex, ignorezero);
-    for (auto i = Volume_loop (data); i; ++i)
-      run_volume (stats, data, mask);
+    if (mask.valid()) {
+      Adapter::Replicate<Image<bool>> mask_replicate (mask, data);
+      threaded_reduce (stats, data, mask_replicate);
+    } else {
+      threaded_reduce (stats, data);
+    }
     stats.print (data, fields);
 
   } else {
@@ -22,6 +22,7 @@
 #include "adapter/replicate.h"
 #include "adapter/subset.h"
 #include "algo/loop.h"
+#include "algo/threaded_reduce.h"
 #include "filter/optimal_threshold.h"
 
 
@@ -153,42 +154,50 @@ Image<bool> get_mask (const Image<value_type>& in)
 }
 
 
+// Gathers all valid values, so that exact order statistics can be computed
+class ValueCollector
+{ NOMEMALIGN
+  public:
+    ValueCollector (const bool ignore_zero) :
+        ignore_zero (ignore_zero) { }
+
+    void operator() (const value_type value) {
+      if (!std::isnan (value) && !(ignore_zero && value == 0.0f))
+        data.push_back (value);
+    }
+
+    // Storage of each slab is released as soon as it has been copied
+    void merge (ValueCollector&& other) {
+      data.insert (data.end(), other.data.begin(), other.data.end());
+      vector<value_type>().swap (other.data);
+    }
+
+    vector<value_type> data;
+
+  private:
+    const bool ignore_zero;
+};
+
+
+
 vector<value_type> get_data (Image<value_type>& in,
                              Image<bool>& mask,
                              const size_t max_axis,
                              const bool ignore_zero)
 {
-  vector<value_type> data;
-  data.reserve (voxel_count (in, 0, max_axis));
+  ValueCollector collector (ignore_zero);
+  // Capacity is not inherited by the per-slab copies, so is only committed to
+  //   memory as the slabs are merged into it
+  collector.data.reserve (voxel_count (in, 0, max_axis));
   if (mask.valid()) {
     Adapter::Replicate<Image<bool>> mask_replicate (mask, in);
-    if (ignore_zero) {
-      for (auto l = Loop(in, 0, max_axis) (in, mask_replicate); l; ++l) {
-        if (mask_replicate.value() && !std::isnan (static_cast<value_type>(in.value())) && in.value() != 0.0f)
-          data.push_back (in.value());
-      }
-    } else {
-      for (auto l = Loop(in, 0, max_axis) (in, mask_replicate); l; ++l) {
-        if (mask_replicate.value() && !std::isnan (static_cast<value_type>(in.value())))
-          data.push_back (in.value());
-      }
-    }
+    threaded_reduce (collector, in, mask_replicate, 0, max_axis);
   } else {
-    if (ignore_zero) {
-      for (auto l = Loop(in, 0, max_axis) (in); l; ++l) {
-        if (!std::isnan (static_cast<value_type>(in.value())) && in.value() != 0.0f)
-          data.push_back (in.value());
-      }
-    } else {
-      for (auto l = Loop(in, 0, max_axis) (in); l; ++l) {
-          if (!std::isnan (static_cast<value_type>(in.value())))
-        data.push_back (in.value());
-      }
-    }
+    threaded_reduce (collector, in, 0, max_axis);
   }
-  if (!data.size())
+  if (!collector.data.size())
     throw Exception ("No valid input data found; unable to determine threshold");
-  return data;
+  return std::move (collector.data);
 }
 
 
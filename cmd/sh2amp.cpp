@@ -18,6 +18,7 @@
 
 #include "command.h"
 #include "image.h"
+#include "algo/voxel_block.h"
 #include "dwi/gradient.h"
 #include "dwi/shells.h"
 #include "math/sphere.h"
@@ -87,68 +88,58 @@ using value_type = float;
 
 
 
+// Amplitudes are computed for a whole row of voxels at a time,
+//   as a single matrix-matrix product
 class SH2Amp { MEMALIGN(SH2Amp)
   public:
     SH2Amp (const Eigen::MatrixXd& transform, bool nonneg) :
       transform (transform),
       nonnegative (nonneg) { }
 
-    void operator() (Image<value_type>& in, Image<value_type>& out) {
-      sh = in.row (3);
-      amp = transform * sh;
+    void operator() (const size_t axis, Image<value_type>& in, Image<value_type>& out) {
+      sh.load (in, axis);
+      amp.data.noalias() = transform * sh.data;
       if (nonnegative)
-        amp = amp.cwiseMax(0.0);
-      out.row (3) = amp;
+        amp.data = amp.data.cwiseMax (0.0);
+      amp.store (out, axis);
     }
-
   private:
     const Eigen::MatrixXd& transform;
     const bool nonnegative;
-    Eigen::VectorXd sh, amp;
+    VoxelBlock<> sh, amp;
 };
 
 
-
-
-
-
 class SH2AmpMultiShell { MEMALIGN(SH2AmpMultiShell)
   public:
     SH2AmpMultiShell (const vector<Eigen::MatrixXd>& dirs, const DWI::Shells& shells, bool nonneg) :
       transforms (dirs),
-      shells (shells),
-      nonnegative (nonneg) { }
+      nonnegative (nonneg)
+    {
+      for (size_t n = 0; n < shells.count(); ++n)
+        amps.push_back (VoxelBlock<> (shells[n].get_volumes()));
+    }
 
-    void operator() (Image<value_type>& in, Image<value_type>& out) {
+    void operator() (const size_t axis, Image<value_type>& in, Image<value_type>& out) {
       for (size_t n = 0; n < transforms.size(); ++n) {
         if (in.ndim() > 4)
           in.index(4) = n;
-        sh = in.row (3);
-
-        amp = transforms[n] * sh;
-
+        sh.load (in, axis);
+        amps[n].data.noalias() = transforms[n] * sh.data;
         if (nonnegative)
-          amp = amp.cwiseMax(value_type(0.0));
-
-        for (ssize_t k = 0; k < amp.size(); ++k) {
-          out.index(3) = shells[n].get_volumes()[k];
-          out.value() = amp[k];
-        }
+          amps[n].data = amps[n].data.cwiseMax (0.0);
+        amps[n].store (out, axis);
       }
     }
-
   private:
     const vector<Eigen::MatrixXd>& transforms;
-    const DWI::Shells& shells;
     const bool nonnegative;
-    Eigen::VectorXd sh, amp;
+    VoxelBlock<> sh;
+    vector<VoxelBlock<>> amps;
 };
 
 
 
-
-
-
 void run ()
 {
   auto sh_data = Image<value_type>::open(argument[0]);
@@ -200,7 +191,7 @@ void run ()
     auto transform = Math::SH::init_transform (directions, lmax);
 
     SH2Amp sh2amp (transform, get_options("nonnegative").size());
-    ThreadedLoop("computing amplitudes", sh_data, 0, 3, 2).run (sh2amp, sh_data, amp_data);
+    ThreadedVoxelBlockLoop ("computing amplitudes", sh_data, sh2amp, sh_data, amp_data);
 
   }
   else { // full gradient scheme:
@@ -237,7 +228,7 @@ void run ()
     auto amp_data = Image<value_type>::create(argument[2], amp_header);
 
     SH2AmpMultiShell sh2amp (transforms, shells, get_options("nonnegative").size());
-    ThreadedLoop("computing amplitudes", sh_data, 0, 3).run (sh2amp, sh_data, amp_data);
+    ThreadedVoxelBlockLoop ("computing amplitudes", sh_data, sh2amp, sh_data, amp_data);
 
   }
 }
@@ -172,14 +172,13 @@ class Processor { MEMALIGN(Processor)
                Image<value_type> ipeaks_data,
                bool use_precomputer) :
       dirs_vox (dirs_data),
-      dirs (directions),
-      lmax (lmax),
       npeaks (npeaks),
       true_peaks (true_peaks),
       threshold (threshold),
       peaks_out (npeaks),
       ipeaks_vox (ipeaks_data),
-      precomputer (use_precomputer ? new Math::SH::PrecomputedAL<value_type> (lmax) :  nullptr) { }
+      precomputer (use_precomputer ? new Math::SH::PrecomputedAL<value_type> (lmax) :  nullptr),
+      peak_finder (directions, lmax, precomputer) { }
 
     bool operator() (const Item& item) {
 
@@ -193,11 +192,16 @@ class Processor { MEMALIGN(Processor)
         return true;
       }
 
+      // searches from seeds converging onto an already located peak
+      //   are abandoned early; these would be discarded below anyway
+      peak_finder (item.data, peak_dirs, peak_values, DOT_THRESHOLD);
+
       vector<Direction> all_peaks;
 
-      for (size_t i = 0; i < size_t(dirs.rows()); i++) {
-        Direction p (dirs (i,0), dirs (i,1));
-        p.a = Math::SH::get_peak (item.data, lmax, p.v, precomputer);
+      for (size_t i = 0; i < peak_finder.size(); i++) {
+        Direction p;
+        p.a = peak_values[i];
+        p.v = peak_dirs[i];
         if (std::isfinite (p.a)) {
           for (size_t j = 0; j < all_peaks.size(); j++) {
             if (abs (p.v.dot (all_peaks[j].v)) > DOT_THRESHOLD) {
@@ -265,13 +269,15 @@ class Processor { MEMALIGN(Processor)
 
   private:
     Image<value_type> dirs_vox;
-    Eigen::Matrix<value_type, Eigen::Dynamic, 2> dirs;
-    int lmax, npeaks;
+    int npeaks;
     vector<Direction> true_peaks;
     value_type threshold;
     vector<Direction> peaks_out;
     Image<value_type> ipeaks_vox;
     Math::SH::PrecomputedAL<value_type>* precomputer;
+    Math::SH::PeakFinder<value_type> peak_finder;
+    vector<Math::SH::PeakFinder<value_type>::dir_type> peak_dirs;
+    Math::SH::PeakFinder<value_type>::vector_type peak_values;
 
     bool check_input (const Item& item) {
       if (ipeaks_vox.valid()) {
@@ -17,8 +17,8 @@
 #include "command.h"
 #include "memory.h"
 #include "progressbar.h"
-#include "algo/threaded_loop.h"
 #include "image.h"
+#include "algo/voxel_block.h"
 #include "math/SH.h"
 #include "math/ZSH.h"
 
@@ -61,33 +61,45 @@ void usage ()
 using value_type = float;
 
 
+// Spherical convolution scales each SH coefficient according to the response
+//   for its harmonic degree; this is applied to a whole row of voxels at a time
 class SConvFunctor { MEMALIGN(SConvFunctor)
   public:
   SConvFunctor (const vector<Eigen::MatrixXd>& responses, vector<Image<value_type>>& inputs) :
-    responses (responses),
-    inputs (inputs) { }
+    inputs (inputs),
+    out (responses[0].rows())
+  {
+    for (size_t n = 0; n < inputs.size(); ++n) {
+      const Eigen::VectorXd ones (Eigen::VectorXd::Ones (inputs[n].size (3)));
+      Eigen::VectorXd C;
+      scales.push_back (Eigen::MatrixXd (Math::SH::NforL (2 * (responses[n].cols()-1)), responses[n].rows()));
+      for (ssize_t s = 0; s < responses[n].rows(); ++s)
+        scales.back().col (s) = Math::SH::sconv (C, responses[n].row(s), ones);
+    }
+  }
 
-    void operator() (Image<value_type>& output)
+    void operator() (const size_t axis, Image<value_type>& output)
     {
+      for (auto& o : out)
+        o.data.setZero (output.size (3), output.size (axis));
       for (size_t n = 0; n < inputs.size(); ++n) {
         assign_pos_of (output, 0, 3).to (inputs[n]);
-        in = inputs[n].row (3);
-        for (ssize_t s = 0; s < responses[n].rows(); ++s) {
-          Math::SH::sconv (out, responses[n].row(s), in);
-          if (output.ndim() > 4)
-            output.index(4) = s;
-          for (ssize_t k = 0; k < out.size(); ++k) {
-            output.index(3) = k;
-            output.value() += out[k];
-          }
-        }
+        in.load (inputs[n], axis);
+        for (size_t s = 0; s < out.size(); ++s)
+          out[s].data.topRows (scales[n].rows()).noalias() += scales[n].col (s).asDiagonal() * in.data.topRows (scales[n].rows());
+      }
+      for (size_t s = 0; s < out.size(); ++s) {
+        if (output.ndim() > 4)
+          output.index(4) = s;
+        out[s].store (output, axis);
       }
     }
 
   protected:
-    const vector<Eigen::MatrixXd>& responses;
     vector<Image<value_type>> inputs;
-    Eigen::VectorXd in, out;
+    vector<Eigen::MatrixXd> scales;
+    VoxelBlock<> in;
+    vector<VoxelBlock<>> out;
 
 };
 
@@ -140,5 +152,5 @@ void run()
   auto output = Image<value_type>::create (argument[argument.size()-1], header);
 
   SConvFunctor sconv (responses, inputs);
-  ThreadedLoop ("performing spherical convolution", inputs[0], 0, 3).run (sconv, output);
+  ThreadedVoxelBlockLoop ("performing spherical convolution", inputs[0], sconv, output);
 }
@@ -39,6 +39,9 @@ using namespace MR::DWI::Tractography;
 using namespace MR::DWI::Tractography::Connectome;
 
 
+const char* extra_metrics[] = { "count", "length", "invlength", "invnodevol", "file", nullptr };
+
+
 
 void usage ()
 {
@@ -81,7 +84,20 @@ void usage ()
              "seeded from the (effectively) same location, and as such, only the endpoint of each "
              "streamline (not their starting point) is assigned based on the provided parcellation "
              "image. Accordingly, the output file contains only a vector of connectivity values "
-             "rather than a matrix, since each streamline is assigned to only one node rather than two.");
+             "rather than a matrix, since each streamline is assigned to only one node rather than two.")
+
+  + Example ("Generate multiple connectome matrices from a single pass through the streamlines data",
+             "tck2connectome tracks.tck nodes_A.mif count_A.csv -tck_weights_in weights.csv "
+             "-extra_output nodes_A.mif length mean length_A.csv "
+             "-extra_output nodes_B.mif count sum count_B.csv "
+             "-extra_output nodes_B.mif invlength sum invlength_B.csv",
+             "Reading a large tractogram from disk can take longer than the actual construction "
+             "of the connectome. Each use of the -extra_output option requests that an additional "
+             "matrix be generated during the same pass through the streamlines data, using its own "
+             "parcellation image, metric and edge statistic. The streamline assignment mechanism, "
+             "streamline weights, and -scale_file values are shared between all outputs; "
+             "streamlines are assigned to nodes only once for each unique parcellation image, "
+             "regardless of how many outputs make use of that image.");
 
 
   ARGUMENTS
@@ -109,7 +125,17 @@ void usage ()
     + Argument ("path").type_file_out()
 
   + Option ("vector", "output a vector representing connectivities from a given seed point to target nodes, "
-                      "rather than a matrix of node-node connectivities");
+                      "rather than a matrix of node-node connectivities")
+
+  + Option ("extra_output", "generate an additional connectome from the same pass through the streamlines data, "
+                            "using the specified parcellation image, metric (options are: " + join(extra_metrics, ",") + ") "
+                            "and edge statistic (options are: " + join(statistics, ",") + "). "
+                            "The \"file\" metric requires the -scale_file option. "
+                            "This option can be specified multiple times.").allow_multiple()
+    + Argument ("nodes_in").type_image_in()
+    + Argument ("metric").type_choice (extra_metrics)
+    + Argument ("statistic").type_choice (statistics)
+    + Argument ("connectome_out").type_file_out();
 
   REFERENCES
   + "If using the default streamline-parcel assignment mechanism (or -assignment_radial_search option): " // Internal
@@ -181,16 +207,108 @@ void execute (Image<node_t>& node_image, const node_t max_node_index, const std:
 
 
 
-void run ()
+
+// Data relevant to each unique parcellation image when generating multiple outputs
+class Parcellation
+{ MEMALIGN(Parcellation)
+  public:
+    Parcellation (const std::string& path) : path (path), max_node_index (0) { }
+    std::string path;
+    Image<node_t> image;
+    node_t max_node_index;
+    std::set<node_t> missing_nodes;
+    std::unique_ptr<Tck2nodes_base> tck2nodes;
+};
+
+// Details of each output connectome when generating multiple outputs
+class Output
+{ MEMALIGN(Output)
+  public:
+    Output (const size_t parcellation, const stat_edge statistic, const std::string& path) :
+        parcellation (parcellation),
+        statistic (statistic),
+        path (path) { }
+    size_t parcellation;
+    stat_edge statistic;
+    std::string path;
+    Metric metric;
+};
+
+
+
+template <typename T>
+void execute_multi (vector<Parcellation>& parcellations, vector<Output>& outputs)
+{
+  const bool vector_output = get_options ("vector").size();
+  const bool track_assignments = get_options ("out_assignments").size();
+
+  // Only one streamline assignment calculation per unique parcellation image
+  vector<const Tck2nodes_base*> tck2nodes;
+  for (auto& p : parcellations) {
+    p.tck2nodes.reset (load_assignment_mode (p.image));
+    tck2nodes.push_back (p.tck2nodes.get());
+  }
+
+  vector<MultiMapper::output_type> mapper_outputs;
+  vector<std::unique_ptr<Tractography::Connectome::Matrix<T>>> connectomes;
+  for (size_t i = 0; i != outputs.size(); ++i) {
+    mapper_outputs.push_back (std::make_pair (outputs[i].parcellation, &outputs[i].metric));
+    // Streamline assignments are only written for the primary output
+    connectomes.emplace_back (new Tractography::Connectome::Matrix<T> (parcellations[outputs[i].parcellation].max_node_index,
+                                                                        outputs[i].statistic,
+                                                                        vector_output,
+                                                                        track_assignments && !i));
+  }
+
+  Tractography::Properties properties;
+  Tractography::Reader<float> reader (argument[0], properties);
+
+  Mapping::TrackLoader loader (reader, properties["count"].empty() ? 0 : to<size_t>(properties["count"]), "Constructing " + str(outputs.size()) + " connectomes");
+  MultiMapper mapper (tck2nodes, mapper_outputs);
+  MultiMatrix<T> sink (connectomes);
+
+  if (tck2nodes.front()->provides_pair()) {
+    Thread::run_queue (
+        loader,
+        Thread::batch (Tractography::Streamline<float>()),
+        Thread::multi (mapper),
+        Thread::batch (vector<Mapped_track_nodepair>()),
+        sink);
+  } else {
+    Thread::run_queue (
+        loader,
+        Thread::batch (Tractography::Streamline<float>()),
+        Thread::multi (mapper),
+        Thread::batch (vector<Mapped_track_nodelist>()),
+        sink);
+  }
+  sink.flush();
+
+  for (size_t i = 0; i != outputs.size(); ++i) {
+    connectomes[i]->finalize();
+    connectomes[i]->error_check (parcellations[outputs[i].parcellation].missing_nodes);
+    connectomes[i]->save (outputs[i].path, get_options ("keep_unassigned").size(), get_options ("symmetric").size(), get_options ("zero_diagonal").size());
+  }
+
+  auto opt = get_options ("out_assignments");
+  if (opt.size())
+    connectomes.front()->write_assignments (opt[0][0]);
+}
+
+
+
+
+
+// Find out how many segmented nodes there are, so the matrix can be pre-allocated
+//   Also check for node volume for all nodes
+Image<node_t> load_nodes (const std::string& path, node_t& max_node_index, std::set<node_t>& missing_nodes)
 {
-  auto node_header = Header::open (argument[1]);
+  auto node_header = Header::open (path);
   MR::Connectome::check (node_header);
   auto node_image = node_header.get_image<node_t>();
 
-  // First, find out how many segmented nodes there are, so the matrix can be pre-allocated
-  // Also check for node volume for all nodes
   vector<uint32_t> node_volumes (1, 0);
-  node_t max_node_index = 0;
+  max_node_index = 0;
   for (auto i = Loop (node_image, 0, 3) (node_image); i; ++i) {
     if (node_image.value() > max_node_index) {
       max_node_index = node_image.value();
@@ -199,13 +317,13 @@ void run ()
     ++node_volumes[node_image.value()];
   }
 
-  std::set<node_t> missing_nodes;
+  missing_nodes.clear();
   for (size_t i = 1; i != node_volumes.size(); ++i) {
     if (!node_volumes[i])
       missing_nodes.insert (i);
   }
   if (missing_nodes.size()) {
-    WARN ("The following nodes are missing from the parcellation image:");
+    WARN ("The following nodes are missing from the parcellation image" + (path == std::string(argument[1]) ? std::string() : " \"" + path + "\"") + ":");
     std::set<node_t>::iterator i = missing_nodes.begin();
     std::string list = str(*i);
     for (++i; i != missing_nodes.end(); ++i)
@@ -214,10 +332,73 @@ void run ()
     WARN ("(This may indicate poor parcellation image preparation, use of incorrect or incomplete LUT file(s) in labelconvert, or very poor registration)");
   }
 
-  if (max_node_index >= node_count_ram_limit) {
+  return node_image;
+}
+
+
+
+void run ()
+{
+  auto opt = get_options ("extra_output");
+
+  if (!opt.size()) {
+    node_t max_node_index = 0;
+    std::set<node_t> missing_nodes;
+    auto node_image = load_nodes (argument[1], max_node_index, missing_nodes);
+    if (max_node_index >= node_count_ram_limit) {
+      INFO ("Very large number of nodes detected; using single-precision floating-point storage");
+      execute<float> (node_image, max_node_index, missing_nodes);
+    } else {
+      execute<double> (node_image, max_node_index, missing_nodes);
+    }
+    return;
+  }
+
+  vector<Parcellation> parcellations;
+  vector<Output> outputs;
+  auto get_parcellation = [&] (const std::string& path) -> size_t
+  {
+    for (size_t i = 0; i != parcellations.size(); ++i) {
+      if (parcellations[i].path == path)
+        return i;
+    }
+    parcellations.emplace_back (path);
+    auto& p = parcellations.back();
+    p.image = load_nodes (path, p.max_node_index, p.missing_nodes);
+    return parcellations.size() - 1;
+  };
+
+  // Primary output: defined by the command-line arguments & standard options
+  auto stat_opt = get_options ("stat_edge");
+  outputs.emplace_back (get_parcellation (argument[1]),
+                        stat_opt.size() ? stat_edge(int(stat_opt[0][0])) : stat_edge::SUM,
+                        argument[2]);
+  Tractography::Connectome::setup_metric (outputs.back().metric, parcellations.front().image);
+
+  const auto scale_file_opt = get_options ("scale_file");
+  for (size_t i = 0; i != opt.size(); ++i) {
+    outputs.emplace_back (get_parcellation (opt[i][0]), stat_edge(int(opt[i][2])), opt[i][3]);
+    auto& output = outputs.back();
+    switch (int(opt[i][1])) {
+      case 0: break;
+      case 1: output.metric.set_scale_length(); break;
+      case 2: output.metric.set_scale_invlength(); break;
+      case 3: output.metric.set_scale_invnodevol (parcellations[output.parcellation].image); break;
+      case 4:
+        if (!scale_file_opt.size())
+          throw Exception ("Metric \"file\" for option -extra_output requires use of the -scale_file option");
+        output.metric.set_scale_file (scale_file_opt[0][0]);
+        break;
+    }
+  }
+
+  bool large = false;
+  for (const auto& p : parcellations)
+    large = large || (p.max_node_index >= node_count_ram_limit);
+  if (large) {
     INFO ("Very large number of nodes detected; using single-precision floating-point storage");
-    execute<float> (node_image, max_node_index, missing_nodes);
+    execute_multi<float> (parcellations, outputs);
   } else {
-    execute<double> (node_image, max_node_index, missing_nodes);
+    execute_multi<double> (parcellations, outputs);
   }
 }
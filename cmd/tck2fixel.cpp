@@ -16,17 +16,15 @@
 
 #include "command.h"
 #include "progressbar.h"
-#include "algo/loop.h"
 #include "image.h"
 
 #include "fixel/helpers.h"
 #include "fixel/keys.h"
-#include "fixel/loop.h"
 #include "fixel/types.h"
 
-#include "dwi/tractography/mapping/mapper.h"
+#include "dwi/tractography/mapping/fixel_mapper.h"
 #include "dwi/tractography/mapping/loader.h"
-#include "dwi/tractography/mapping/writer.h"
+#include "dwi/tractography/mapping/mapping.h"
 
 
 using namespace MR;
@@ -41,54 +39,39 @@ class TrackProcessor { MEMALIGN (TrackProcessor)
 
  public:
 
-   using SetVoxelDir = DWI::Tractography::Mapping::SetVoxelDir;
-
-   TrackProcessor (Image<index_type>& fixel_indexer,
-                   const vector<Eigen::Vector3>& fixel_directions,
-                   vector<uint16_t>& fixel_TDI,
-                   const float angular_threshold):
-     fixel_indexer (fixel_indexer) ,
-     fixel_directions (fixel_directions),
-     fixel_TDI (fixel_TDI),
-     angular_threshold_dp (std::cos (angular_threshold * (Math::pi/180.0))) { }
-
-
-   bool operator () (const SetVoxelDir& in)  {
-     // For each voxel tract tangent, assign to a fixel
-     vector<int32_t> tract_fixel_indices;
-     for (SetVoxelDir::const_iterator i = in.begin(); i != in.end(); ++i) {
-       assign_pos_of (*i).to (fixel_indexer);
-       fixel_indexer.index(3) = 0;
-       index_type num_fibres = fixel_indexer.value();
-       if (num_fibres > 0) {
-         fixel_indexer.index(3) = 1;
-         index_type first_index = fixel_indexer.value();
-         index_type last_index = first_index + num_fibres;
-         index_type closest_fixel_index = 0;
-         float largest_dp = 0.0;
-         const Eigen::Vector3 dir (i->get_dir().normalized());
-         for (index_type j = first_index; j < last_index; ++j) {
-           const float dp = abs (dir.dot (fixel_directions[j]));
-           if (dp > largest_dp) {
-             largest_dp = dp;
-             closest_fixel_index = j;
-           }
-         }
-         if (largest_dp > angular_threshold_dp) {
-           tract_fixel_indices.push_back (closest_fixel_index);
-           fixel_TDI[closest_fixel_index]++;
-         }
-       }
-     }
+   using FixelMapper = DWI::Tractography::Mapping::FixelMapper;
+
+   TrackProcessor (const FixelMapper& mapper,
+                   vector<uint32_t>& fixel_TDI):
+     mapper (mapper),
+     master (fixel_TDI),
+     fixel_TDI (fixel_TDI.size(), 0),
+     mutex (new std::mutex) { }
+
+   // Each thread accumulates into its own copy of the fixel TDI,
+   //   which is added to the master copy on destruction
+   ~TrackProcessor ()
+   {
+     std::lock_guard<std::mutex> lock (*mutex);
+     for (size_t i = 0; i != master.size(); ++i)
+       master[i] += fixel_TDI[i];
+   }
+
+
+   bool operator () (const DWI::Tractography::Streamline<>& tck)  {
+     mapper (tck, fixels);
+     for (auto f : fixels)
+       fixel_TDI[f]++;
      return true;
    }
 
 
  private:
-   Image<index_type> fixel_indexer;
-   const vector<Eigen::Vector3>& fixel_directions;
-   vector<uint16_t>& fixel_TDI;
-   const float angular_threshold_dp;
+   FixelMapper mapper;
+   vector<uint32_t>& master;
+   vector<uint32_t> fixel_TDI;
+   vector<index_type> fixels;
+   std::shared_ptr<std::mutex> mutex;
 };
 
 
@@ -135,29 +118,10 @@ void run ()
 
   const float angular_threshold = get_option_value ("angle", DEFAULT_ANGLE_THRESHOLD);
 
-  vector<Eigen::Vector3> positions (num_fixels);
-  vector<Eigen::Vector3> directions (num_fixels);
-
   const std::string output_fixel_folder = argument[2];
   Fixel::copy_index_and_directions_file (input_fixel_folder, output_fixel_folder);
 
-  {
-    auto directions_data = Fixel::find_directions_header (input_fixel_folder).get_image<default_type>().with_direct_io();
-    // Load template fixel directions
-    Transform image_transform (index_image);
-    for (auto i = Loop ("loading template fixel directions and positions", index_image, 0, 3)(index_image); i; ++i) {
-      const Eigen::Vector3 vox ((default_type)index_image.index(0), (default_type)index_image.index(1), (default_type)index_image.index(2));
-      index_image.index(3) = 1;
-      index_type offset = index_image.value();
-      index_type fixel_index = 0;
-      for (auto f = Fixel::Loop (index_image) (directions_data); f; ++f, ++fixel_index) {
-        directions[offset + fixel_index] = directions_data.row(1);
-        positions[offset + fixel_index] = image_transform.voxel2scanner * vox;
-      }
-    }
-  }
-
-  vector<uint16_t> fixel_TDI (num_fixels, 0.0);
+  vector<uint32_t> fixel_TDI (num_fixels, 0);
   const std::string track_filename = argument[0];
   DWI::Tractography::Properties properties;
   DWI::Tractography::Reader<float> track_file (track_filename, properties);
@@ -167,18 +131,15 @@ void run ()
     throw Exception ("no tracks found in input file");
 
   {
-    using SetVoxelDir = DWI::Tractography::Mapping::SetVoxelDir;
+    auto directions_image = Fixel::find_directions_header (input_fixel_folder).get_image<default_type>().with_direct_io();
     DWI::Tractography::Mapping::TrackLoader loader (track_file, num_tracks, "mapping tracks to fixels");
-    DWI::Tractography::Mapping::TrackMapperBase mapper (index_image);
+    DWI::Tractography::Mapping::FixelMapper mapper (index_image, directions_image, angular_threshold);
     mapper.set_upsample_ratio (DWI::Tractography::Mapping::determine_upsample_ratio (index_header, properties, 0.333f));
-    mapper.set_use_precise_mapping (true);
-    TrackProcessor tract_processor (index_image, directions, fixel_TDI, angular_threshold);
+    TrackProcessor tract_processor (mapper, fixel_TDI);
     Thread::run_queue (
         loader,
         Thread::batch (DWI::Tractography::Streamline<float>()),
-        mapper,
-        Thread::batch (SetVoxelDir()),
-        tract_processor);
+        Thread::multi (tract_processor));
   }
   track_file.close();
 
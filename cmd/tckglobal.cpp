@@ -311,12 +311,13 @@ void run ()
   Eint->setConnPot(cpot);
   EnergySumComputer* Esum = new EnergySumComputer(stats, Eint, properties.lam_int, Eext, properties.lam_ext / ( wmscale2 * properties.weight*properties.weight));
 
-  MHSampler mhs (dwi, properties, stats, pgrid, Esum, mask);   // All EnergyComputers are recursively destroyed upon destruction of mhs, except for the shared data.
+  const size_t nthreads = std::max<size_t> (1, Thread::threads_to_execute());
+  MHSampler mhs (dwi, properties, stats, pgrid, Esum, mask, nthreads);   // All EnergyComputers are recursively destroyed upon destruction of mhs, except for the shared data.
 
 
   INFO("Start MH sampler");
 
-  Thread::run (Thread::multi(mhs), "MH sampler");
+  Thread::run (Thread::multi(mhs, nthreads), "MH sampler");
 
   INFO("Final no. particles: " + std::to_string(pgrid.getTotalCount()));
   INFO("Final external energy: " + std::to_string(stats.getEextTotal()));
@@ -131,7 +131,7 @@ class SamplerNonPrecise
 { MEMALIGN (SamplerNonPrecise<Interp>)
   public:
     SamplerNonPrecise (Image<value_type>& image, const stat_tck statistic, const Image<value_type>& precalc_tdi) :
-        interp (image),
+        interp (image, value_type(0)),
         mapper (precalc_tdi.valid() ? new DWI::Tractography::Mapping::TrackMapperBase (image) : nullptr),
         tdi (precalc_tdi),
         statistic (statistic)
@@ -192,12 +192,8 @@ class SamplerNonPrecise
     {
       out.set_index (tck.get_index());
       out.resize (tck.size());
-      for (size_t i = 0; i != tck.size(); ++i) {
-        if (interp.scanner (tck[i]))
-          out[i] = interp.value();
-        else
-          out[i] = value_type(0);
-      }
+      if (tck.size())
+        interp.scanner_values (Eigen::Map<const Eigen::Matrix<value_type, 3, Eigen::Dynamic>> (tck[0].data(), 3, tck.size()), out);
       return true;
     }
 
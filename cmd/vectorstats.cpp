@@ -236,7 +236,7 @@ void run()
   // Don't use convenience function: No enhancer!
   // Manually construct default shuffling matrix
   // TODO Change to use convenience function; we make an empty enhancer later anyway
-  const matrix_type default_shuffle (matrix_type::Identity (num_inputs, num_inputs));
+  const Math::Stats::Shuffle default_shuffle (num_inputs);
   matrix_type default_statistic, default_zstat;
   (*glm_test) (default_shuffle, default_statistic, default_zstat);
   for (size_t i = 0; i != num_hypotheses; ++i) {
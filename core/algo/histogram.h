@@ -23,6 +23,7 @@
 #include "types.h"
 #include "adapter/replicate.h"
 #include "algo/loop.h"
+#include "algo/threaded_reduce.h"
 
 namespace MR
 {
@@ -62,6 +63,20 @@ namespace MR
             return (*this) (typename T::value_type (val));
           }
 
+          //! combine with a calibrator that has been fed a disjoint set of values
+          /*! The values stored in \a other are moved into this calibrator,
+           * leaving \a other empty. */
+          void merge (Calibrator&& other) {
+            min = std::min (min, other.min);
+            max = std::max (max, other.max);
+            if (data.empty()) {
+              std::swap (data, other.data);
+            } else {
+              data.insert (data.end(), other.data.begin(), other.data.end());
+              vector<default_type>().swap (other.data);
+            }
+          }
+
           void from_file (const std::string&);
 
           void finalize (const size_t num_volumes, const bool is_integer);
@@ -112,6 +127,12 @@ namespace MR
             return true;
           }
 
+          //! add the counts of a histogram generated over a disjoint set of values
+          void merge (const Data& other) {
+            assert (other.list.size() == list.size());
+            list += other.list;
+          }
+
           template <typename value_type>
           size_t bin (const value_type val) const {
             size_t pos = std::floor ((val - info.get_min()) / info.get_bin_width());
@@ -147,8 +168,7 @@ namespace MR
       template <class ImageType>
       void calibrate (Calibrator& result, ImageType& image)
       {
-        for (auto l = Loop(image) (image); l; ++l)
-          result (image.value());
+        threaded_reduce (result, image);
         result.finalize (image.ndim() > 3 ? image.size(3) : 1, std::is_integral<typename ImageType::value_type>::value);
       }
 
@@ -162,10 +182,7 @@ namespace MR
         if (!dimensions_match (image, mask, 0, 3))
           throw Exception ("Image and mask for histogram calibration do not match");
         Adapter::Replicate<MaskType> mask_replicate (mask, image);
-        for (auto l = Loop(image) (image, mask_replicate); l; ++l) {
-          if (mask_replicate.value())
-            result (image.value());
-        }
+        threaded_reduce (result, image, mask_replicate);
         result.finalize (image.ndim() > 3 ? image.size(3) : 1, std::is_integral<typename ImageType::value_type>::value);
       }
 
@@ -189,8 +206,7 @@ namespace MR
       Data generate (const Calibrator& calibrator, ImageType& image)
       {
         Data result (calibrator);
-        for (auto l = Loop(image) (image); l; ++l)
-          result (typename ImageType::value_type (image.value()));
+        threaded_reduce (result, image);
         return result;
       }
 
@@ -203,10 +219,7 @@ namespace MR
           throw Exception ("Image and mask for histogram generation do not match");
         Data result (calibrator);
         Adapter::Replicate<MaskType> mask_replicate (mask, image);
-        for (auto l = Loop(image) (image, mask_replicate); l; ++l) {
-          if (mask_replicate.value())
-            result (typename ImageType::value_type (image.value()));
-        }
+        threaded_reduce (result, image, mask_replicate);
         return result;
       }
 
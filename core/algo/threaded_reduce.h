@@ -0,0 +1,170 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __algo_threaded_reduce_h__
+#define __algo_threaded_reduce_h__
+
+#include "stride.h"
+#include "types.h"
+#include "algo/loop.h"
+#include "algo/threaded_loop.h"
+
+namespace MR
+{
+
+  /** \addtogroup thread_classes
+   * @{ */
+
+  //! \cond skip
+  namespace {
+
+    // The image is split into slabs along its slowest-varying axes, until
+    //   there are at least this many slabs to distribute across threads
+    constexpr size_t __reduce_minimum_slabs = 64;
+
+    struct __ReduceNoMask { NOMEMALIGN };
+
+    template <class AccumulatorType, class ImageType, class MaskType>
+      struct __ReduceSlab { MEMALIGN(__ReduceSlab<AccumulatorType,ImageType,MaskType>)
+        vector<AccumulatorType>& slabs;
+        const vector<size_t>& outer_axes;
+        const vector<size_t>& slab_strides;
+        const vector<size_t>& inner_axes;
+        ImageType image;
+        MaskType mask;
+
+        void operator() (const Iterator& pos) {
+          assign_pos_of (pos, outer_axes).to (image);
+          size_t index = 0;
+          for (size_t n = 0; n != outer_axes.size(); ++n)
+            index += pos.index (outer_axes[n]) * slab_strides[n];
+          accumulate (slabs[index], pos, mask);
+        }
+
+        void accumulate (AccumulatorType& accumulator, const Iterator&, __ReduceNoMask&) {
+          for (auto l = Loop (inner_axes) (image); l; ++l)
+            accumulator (typename ImageType::value_type (image.value()));
+        }
+
+        template <class M>
+          void accumulate (AccumulatorType& accumulator, const Iterator& pos, M& m) {
+            assign_pos_of (pos, outer_axes).to (m);
+            for (auto l = Loop (inner_axes) (image, m); l; ++l) {
+              if (m.value())
+                accumulator (typename ImageType::value_type (image.value()));
+            }
+          }
+      };
+
+
+    template <class AccumulatorType, class ImageType, class MaskType>
+      inline void __threaded_reduce (AccumulatorType& accumulator, ImageType& image, MaskType& mask, size_t from_axis, size_t to_axis)
+      {
+        const vector<size_t> axes = Stride::order (image, from_axis, to_axis);
+
+        // slabs are formed from the slowest axes in memory, and always leave at
+        //   least the fastest axis to be looped over within each slab
+        vector<size_t> outer_axes, inner_axes, slab_strides;
+        size_t num_slabs = 1;
+        for (size_t n = axes.size(); n-- > 1;) {
+          if (num_slabs < __reduce_minimum_slabs && image.size (axes[n]) > 1) {
+            outer_axes.push_back (axes[n]);
+            num_slabs *= image.size (axes[n]);
+          }
+        }
+        for (auto axis : axes) {
+          if (std::find (outer_axes.begin(), outer_axes.end(), axis) == outer_axes.end())
+            inner_axes.push_back (axis);
+        }
+        std::reverse (outer_axes.begin(), outer_axes.end());
+        size_t stride = 1;
+        for (auto axis : outer_axes) {
+          slab_strides.push_back (stride);
+          stride *= image.size (axis);
+        }
+
+        vector<AccumulatorType> slabs (num_slabs, accumulator);
+        __ReduceSlab<AccumulatorType, ImageType, MaskType> functor = { slabs, outer_axes, slab_strides, inner_axes, image, mask };
+        if (outer_axes.empty()) {
+          // nothing to split across threads
+          functor (Iterator (image));
+        } else {
+          ThreadedLoop (image, outer_axes, inner_axes).run_outer (functor);
+          check_app_exit_code();
+        }
+
+        // merge in a fixed order, so that the result does not depend on the
+        //   number of threads or on the order in which slabs were processed;
+        //   each slab is handed over as an rvalue, so that any storage it holds
+        //   can be moved or released as it is merged
+        for (auto& slab : slabs)
+          accumulator.merge (std::move (slab));
+      }
+
+  }
+  //! \endcond
+
+
+
+  //! Multi-threaded reduction of image values into a mergeable accumulator
+  /*! The image is split into slabs along its slowest-varying axes; each slab
+   * is processed by one thread into its own copy of \a accumulator, and the
+   * per-slab results are then merged into \a accumulator in a fixed order.
+   * The result is therefore independent of the number of threads used.
+   *
+   * The accumulator class must be copy-constructible, and provide the
+   * following methods:
+   * \code
+   * void operator() (value_type value);                 // add a single value
+   * void merge (AccumulatorType&& other);               // add the contents of another accumulator
+   * \endcode
+   *
+   * Since each slab starts from a copy of \a accumulator, it would normally be
+   * in its initial (empty) state when passed to this function. */
+  template <class AccumulatorType, class ImageType>
+    inline void threaded_reduce (
+        AccumulatorType& accumulator,
+        ImageType& image,
+        size_t from_axis = 0,
+        size_t to_axis = std::numeric_limits<size_t>::max())
+    {
+      __ReduceNoMask mask;
+      __threaded_reduce (accumulator, image, mask, from_axis, to_axis);
+    }
+
+  //! Multi-threaded reduction of image values within a mask into a mergeable accumulator
+  /*! As for threaded_reduce(), but only values for which \a mask is true are
+   * passed to the accumulator. The mask must span the same axes as the image
+   * over the range being reduced (use Adapter::Replicate if necessary). */
+  template <class AccumulatorType, class ImageType, class MaskType>
+    inline void threaded_reduce (
+        AccumulatorType& accumulator,
+        ImageType& image,
+        MaskType& mask,
+        size_t from_axis = 0,
+        size_t to_axis = std::numeric_limits<size_t>::max())
+    {
+      if (!mask.valid()) {
+        threaded_reduce (accumulator, image, from_axis, to_axis);
+        return;
+      }
+      __threaded_reduce (accumulator, image, mask, from_axis, to_axis);
+    }
+
+  //! @}
+}
+
+#endif
@@ -0,0 +1,233 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __algo_voxel_block_h__
+#define __algo_voxel_block_h__
+
+#include "apply.h"
+#include "image.h"
+#include "stride.h"
+#include "types.h"
+#include "algo/threaded_loop.h"
+
+namespace MR
+{
+
+  /** \addtogroup thread_classes
+   * @{ */
+
+  //! gather / scatter the volume data of a row of voxels as a matrix
+  /*! A VoxelBlock holds the values along the volume axis (axis 3) of all
+   * voxels along one spatial axis, starting from the current position of
+   * the image, as a matrix with one column per voxel. Per-voxel linear
+   * operations can then be applied to all voxels in the row as a single
+   * matrix-matrix product, rather than as one matrix-vector product per
+   * voxel:
+   * \code
+   * VoxelBlock<> in, out;
+   * in.load (sh_image, axis);
+   * out.data.noalias() = transform * in.data;
+   * out.store (amp_image, axis);
+   * \endcode
+   *
+   * The rows of the block can be restricted to (or scattered to) a subset
+   * of volumes, by providing the corresponding indices along axis 3. For
+   * 3D images, the block consists of a single row.
+   *
+   * Where the image data can be accessed directly in RAM (see
+   * Image::is_direct_io()), the values are copied directly using the
+   * image strides, bypassing the per-voxel Image::value() interface.
+   *
+   * This is typically used within ThreadedVoxelBlockLoop(). */
+  template <typename ValueType = default_type>
+    class VoxelBlock { MEMALIGN(VoxelBlock<ValueType>)
+      public:
+        using matrix_type = Eigen::Matrix<ValueType, Eigen::Dynamic, Eigen::Dynamic>;
+
+        VoxelBlock (const vector<size_t>& volumes = vector<size_t>()) :
+          volumes (volumes) { }
+
+        //! the data for the row of voxels, one column per voxel
+        matrix_type data;
+
+        //! load the row of voxels along \a axis from \a image
+        template <typename ImageValueType>
+          void load (Image<ImageValueType>& image, const size_t axis)
+          {
+            if (!direct_io (image)) {
+              load_voxelwise (image, axis);
+              return;
+            }
+            image.index (axis) = 0;
+            if (image.ndim() > 3)
+              image.index (3) = 0;
+            const ImageValueType* p = image.address();
+            const ssize_t voxel_stride = image.stride (axis);
+            const ssize_t volume_stride = image.ndim() > 3 ? image.stride (3) : 0;
+            data.resize (num_rows (image), image.size (axis));
+            for (ssize_t n = 0; n != data.cols(); ++n, p += voxel_stride) {
+              for (ssize_t r = 0; r != data.rows(); ++r)
+                data (r, n) = p[volume_stride * volume (r)];
+            }
+          }
+
+        template <class ImageType>
+          void load (ImageType& image, const size_t axis)
+          {
+            load_voxelwise (image, axis);
+          }
+
+        //! store the row of voxels along \a axis into \a image
+        template <typename ImageValueType>
+          void store (Image<ImageValueType>& image, const size_t axis) const
+          {
+            if (!direct_io (image)) {
+              store_voxelwise (image, axis);
+              return;
+            }
+            assert (data.rows() == num_rows (image) && data.cols() == image.size (axis));
+            image.index (axis) = 0;
+            if (image.ndim() > 3)
+              image.index (3) = 0;
+            ImageValueType* p = image.address();
+            const ssize_t voxel_stride = image.stride (axis);
+            const ssize_t volume_stride = image.ndim() > 3 ? image.stride (3) : 0;
+            for (ssize_t n = 0; n != data.cols(); ++n, p += voxel_stride) {
+              for (ssize_t r = 0; r != data.rows(); ++r)
+                p[volume_stride * volume (r)] = data (r, n);
+            }
+          }
+
+        template <class ImageType>
+          void store (ImageType& image, const size_t axis) const
+          {
+            store_voxelwise (image, axis);
+          }
+
+      protected:
+        const vector<size_t> volumes;
+
+        // bitwise data cannot be addressed per voxel
+        template <typename ImageValueType>
+          static bool direct_io (const Image<ImageValueType>& image) {
+            return image.is_direct_io() && !std::is_same<ImageValueType, bool>::value;
+          }
+
+        FORCE_INLINE ssize_t volume (const ssize_t row) const { return volumes.size() ? volumes[row] : row; }
+
+        template <class ImageType>
+          ssize_t num_rows (const ImageType& image) const {
+            return volumes.size() ? volumes.size() : (image.ndim() > 3 ? image.size (3) : 1);
+          }
+
+        template <class ImageType>
+          void load_voxelwise (ImageType& image, const size_t axis)
+          {
+            data.resize (num_rows (image), image.size (axis));
+            for (ssize_t n = 0; n != data.cols(); ++n) {
+              image.index (axis) = n;
+              if (image.ndim() > 3) {
+                for (ssize_t r = 0; r != data.rows(); ++r) {
+                  image.index (3) = volume (r);
+                  data (r, n) = image.value();
+                }
+              } else {
+                data (0, n) = image.value();
+              }
+            }
+          }
+
+        template <class ImageType>
+          void store_voxelwise (ImageType& image, const size_t axis) const
+          {
+            assert (data.rows() == num_rows (image) && data.cols() == image.size (axis));
+            for (ssize_t n = 0; n != data.cols(); ++n) {
+              image.index (axis) = n;
+              if (image.ndim() > 3) {
+                for (ssize_t r = 0; r != data.rows(); ++r) {
+                  image.index (3) = volume (r);
+                  image.value() = data (r, n);
+                }
+              } else {
+                image.value() = data (0, n);
+              }
+            }
+          }
+    };
+
+
+
+
+  //! \cond skip
+  namespace {
+
+    template <class Functor, class... ImageType>
+      struct __voxel_block_run { MEMALIGN(__voxel_block_run<Functor,ImageType...>)
+        const vector<size_t>& outer_axes;
+        const size_t axis;
+        typename std::remove_reference<Functor>::type func;
+        std::tuple<ImageType...> vox;
+
+        __voxel_block_run (const vector<size_t>& outer_axes, const size_t axis, const Functor& functor, ImageType&... voxels) :
+          outer_axes (outer_axes),
+          axis (axis),
+          func (functor),
+          vox (voxels...) { }
+
+        void operator() (const Iterator& pos) {
+          assign_pos_of (pos, outer_axes).to (vox);
+          unpack ([&] (ImageType&... v) { func (axis, v...); }, vox);
+        }
+      };
+
+  }
+  //! \endcond
+
+
+
+  //! Multi-threaded loop over rows of voxels
+  /*! This invokes \a functor once per row of voxels along the spatial axis
+   * of smallest stride in \a source, with each of the images positioned at
+   * the start of that row. The functor is expected to have the signature:
+   * \code
+   * void operator() (const size_t axis, ImageType&... images);
+   * \endcode
+   * where \a axis is the spatial axis along which the row lies; this would
+   * typically be used in conjunction with VoxelBlock to process all voxels
+   * in the row at once. As with ThreadedLoop(), the functor and images are
+   * copied into each thread. */
+  template <class HeaderType, class Functor, class... ImageType>
+    inline void ThreadedVoxelBlockLoop (
+        const std::string& progress_message,
+        const HeaderType& source,
+        Functor&& functor,
+        ImageType&&... images)
+    {
+      const vector<size_t> axes = Stride::order (source, 0, 3);
+      const vector<size_t> outer_axes (axes.begin()+1, axes.end());
+      __voxel_block_run<
+        typename std::remove_reference<Functor>::type,
+        typename std::remove_reference<ImageType>::type...
+          > loop_thread (outer_axes, axes[0], functor, images...);
+      ThreadedLoop (progress_message, source, outer_axes, { axes[0] })
+        .run_outer (loop_thread);
+      check_app_exit_code();
+    }
+
+  //! @}
+}
+
+#endif
@@ -0,0 +1,337 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "file/config.h"
+#include "file/path.h"
+#include "file/utils.h"
+#include "file/dicom/index.h"
+
+#define DICOM_INDEX_MAGIC "MRtrix DICOM index"
+#define DICOM_INDEX_VERSION 2
+
+namespace MR {
+  namespace File {
+    namespace Dicom {
+
+
+
+      namespace {
+
+        void write_uint (std::ostream& out, uint64_t value)
+        {
+          out.write (reinterpret_cast<const char*> (&value), sizeof (value));
+        }
+
+        void write_string (std::ostream& out, const std::string& value)
+        {
+          write_uint (out, value.size());
+          out.write (value.data(), value.size());
+        }
+
+        uint64_t read_uint (std::istream& in)
+        {
+          uint64_t value;
+          in.read (reinterpret_cast<char*> (&value), sizeof (value));
+          if (!in)
+            throw Exception ("unexpected end of file");
+          return value;
+        }
+
+        std::string read_string (std::istream& in)
+        {
+          const uint64_t size = read_uint (in);
+          if (size > (1U<<20))
+            throw Exception ("invalid string length");
+          std::string value (size, '\0');
+          in.read (&value[0], size);
+          if (!in)
+            throw Exception ("unexpected end of file");
+          return value;
+        }
+
+
+
+        std::string absolute (const std::string& folder)
+        {
+#ifdef MRTRIX_WINDOWS
+          if (folder.size() > 1 && folder[1] == ':')
+            return folder;
+#else
+          if (folder.size() && folder[0] == PATH_SEPARATORS[0])
+            return folder;
+#endif
+          vector<char> buf (4096);
+          if (!getcwd (buf.data(), buf.size()))
+            return folder;
+          return Path::join (buf.data(), folder);
+        }
+
+
+
+        // modification time in nanoseconds, where the filesystem provides it
+        int64_t mtime_ns (const struct stat& sbuf)
+        {
+#if defined(MRTRIX_MACOSX)
+          const int64_t nsec = sbuf.st_mtimespec.tv_nsec;
+#elif defined(MRTRIX_WINDOWS)
+          const int64_t nsec = 0;
+#else
+          const int64_t nsec = sbuf.st_mtim.tv_nsec;
+#endif
+          return int64_t (sbuf.st_mtime) * 1000000000 + nsec;
+        }
+
+      }
+
+
+
+
+      Index::Index (const std::string& folder) :
+        folder (folder),
+        modified (false)
+      {
+        //CONF option: DICOMIndexCache
+        //CONF default: 0 (false)
+        //CONF A boolean value to indicate whether the contents of DICOM
+        //CONF folders should be indexed on disk once scanned. Subsequent
+        //CONF reads of the same folder then only need to parse those files
+        //CONF that have been added or modified since (as determined from
+        //CONF their size and modification time).
+        if (!File::Config::get_bool ("DICOMIndexCache", false))
+          return;
+
+        //CONF option: DICOMIndexFolder
+        //CONF default: (none)
+        //CONF The folder in which to store the DICOM folder indices when
+        //CONF DICOMIndexCache is enabled. If not set, each index is stored
+        //CONF within the DICOM folder itself, as a hidden file named
+        //CONF .mrtrix_dicom_index.
+        const std::string index_folder = File::Config::get ("DICOMIndexFolder");
+        if (index_folder.empty()) {
+          path = Path::join (folder, ".mrtrix_dicom_index");
+        }
+        else {
+          std::string key = absolute (folder);
+          while (key.size() > 1 && strchr (PATH_SEPARATORS, key.back()))
+            key.pop_back();
+          char name[32];
+          snprintf (name, sizeof (name), "dicom_index_%016llx", (unsigned long long) std::hash<std::string>() (key));
+          path = Path::join (index_folder, name);
+        }
+
+        load();
+      }
+
+
+
+
+
+      std::string Index::relative (const std::string& name) const
+      {
+        size_t start = name.compare (0, folder.size(), folder) ? 0 : folder.size();
+        while (start < name.size() && strchr (PATH_SEPARATORS, name[start]))
+          ++start;
+        return name.substr (start);
+      }
+
+
+
+
+
+      bool Index::find (Entry& entry) const
+      {
+        struct stat sbuf;
+        if (stat (entry.name.c_str(), &sbuf)) {
+          entry.size = -1;
+          return false;
+        }
+        entry.size = sbuf.st_size;
+        entry.mtime = mtime_ns (sbuf);
+        entry.inode = sbuf.st_ino;
+
+        const auto cached = entries.find (relative (entry.name));
+        if (cached == entries.end() || !cached->second.matches (entry))
+          return false;
+
+        entry.reader = cached->second.reader;
+        entry.reader.filename = entry.name;
+        entry.is_dicom = cached->second.is_dicom;
+        return true;
+      }
+
+
+
+
+
+      void Index::update (const Entry& entry)
+      {
+        if (!enabled() || entry.size < 0)
+          return;
+        const auto cached = entries.find (relative (entry.name));
+        if (cached == entries.end() || !cached->second.matches (entry))
+          modified = true;
+        updated.push_back (entry);
+      }
+
+
+
+
+
+      void Index::load ()
+      {
+        if (!Path::exists (path))
+          return;
+
+        try {
+          std::ifstream in (path, std::ios::in | std::ios::binary);
+          if (!in)
+            throw Exception ("error opening file");
+          if (read_string (in) != DICOM_INDEX_MAGIC || read_uint (in) != DICOM_INDEX_VERSION)
+            throw Exception ("unrecognised format");
+
+          size_t num_entries = read_uint (in);
+          while (num_entries--) {
+            Entry entry;
+            const std::string name = read_string (in);
+            entry.size = read_uint (in);
+            entry.mtime = read_uint (in);
+            entry.inode = read_uint (in);
+            entry.is_dicom = read_uint (in);
+
+            if (entry.is_dicom) {
+              QuickScan& reader (entry.reader);
+              reader.modality = read_string (in);
+              reader.patient = read_string (in);
+              reader.patient_ID = read_string (in);
+              reader.patient_DOB = read_string (in);
+              reader.study = read_string (in);
+              reader.study_ID = read_string (in);
+              reader.study_date = read_string (in);
+              reader.study_time = read_string (in);
+              reader.series = read_string (in);
+              reader.series_date = read_string (in);
+              reader.series_time = read_string (in);
+              reader.sequence = read_string (in);
+              size_t num_types = read_uint (in);
+              while (num_types--) {
+                const std::string type = read_string (in);
+                reader.image_type[type] = read_uint (in);
+              }
+              reader.series_number = read_uint (in);
+              reader.bits_alloc = read_uint (in);
+              reader.dim[0] = read_uint (in);
+              reader.dim[1] = read_uint (in);
+              reader.data = read_uint (in);
+              reader.transfer_syntax_supported = read_uint (in);
+            }
+
+            entries[name] = entry;
+          }
+          DEBUG ("loaded DICOM index \"" + path + "\" (" + str(entries.size()) + " entries)");
+        }
+        catch (Exception& E) {
+          DEBUG ("error reading DICOM index \"" + path + "\": " + E[0] + " - ignored");
+          entries.clear();
+        }
+      }
+
+
+
+
+
+      void Index::save () const
+      {
+        if (!enabled() || (!modified && updated.size() == entries.size()))
+          return;
+
+        // write to a uniquely named temporary file first, so that concurrent
+        // invocations never encounter a partially written index:
+        std::string temp = path + "-tmp-" + str(getpid()) + "-XXXXXX";
+        for (size_t n = temp.size() - 6; n != temp.size(); ++n)
+          temp[n] = File::random_char();
+        {
+          std::ofstream out (temp, std::ios::out | std::ios::binary);
+          if (!out) {
+            DEBUG ("unable to write DICOM index \"" + path + "\" - skipped");
+            return;
+          }
+          write_string (out, DICOM_INDEX_MAGIC);
+          write_uint (out, DICOM_INDEX_VERSION);
+          write_uint (out, updated.size());
+          for (const auto& entry : updated) {
+            const QuickScan& reader (entry.reader);
+            write_string (out, relative (entry.name));
+            write_uint (out, entry.size);
+            write_uint (out, entry.mtime);
+            write_uint (out, entry.inode);
+            write_uint (out, entry.is_dicom);
+            if (!entry.is_dicom)
+              continue;
+            write_string (out, reader.modality);
+            write_string (out, reader.patient);
+            write_string (out, reader.patient_ID);
+            write_string (out, reader.patient_DOB);
+            write_string (out, reader.study);
+            write_string (out, reader.study_ID);
+            write_string (out, reader.study_date);
+            write_string (out, reader.study_time);
+            write_string (out, reader.series);
+            write_string (out, reader.series_date);
+            write_string (out, reader.series_time);
+            write_string (out, reader.sequence);
+            write_uint (out, reader.image_type.size());
+            for (const auto& type : reader.image_type) {
+              write_string (out, type.first);
+              write_uint (out, type.second);
+            }
+            write_uint (out, reader.series_number);
+            write_uint (out, reader.bits_alloc);
+            write_uint (out, reader.dim[0]);
+            write_uint (out, reader.dim[1]);
+            write_uint (out, reader.data);
+            write_uint (out, reader.transfer_syntax_supported);
+          }
+          if (!out) {
+            DEBUG ("error writing DICOM index \"" + path + "\" - skipped");
+            out.close();
+            std::remove (temp.c_str());
+            return;
+          }
+        }
+
+#ifdef MRTRIX_WINDOWS
+        std::remove (path.c_str());
+#endif
+        if (std::rename (temp.c_str(), path.c_str())) {
+          DEBUG ("unable to write DICOM index \"" + path + "\" - skipped");
+          std::remove (temp.c_str());
+          return;
+        }
+        DEBUG ("updated DICOM index \"" + path + "\" (" + str(updated.size()) + " entries)");
+      }
+
+
+    }
+  }
+}
+
@@ -0,0 +1,89 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __file_dicom_index_h__
+#define __file_dicom_index_h__
+
+#include <unordered_map>
+
+#include "types.h"
+#include "file/dicom/quick_scan.h"
+
+namespace MR {
+  namespace File {
+    namespace Dicom {
+
+      //! a persistent record of the QuickScan results for a DICOM folder
+      /*! If enabled in the configuration file (DICOMIndexCache), the outcome
+       * of scanning each file within a DICOM folder is stored on disk, along
+       * with the size, modification time and inode number of the file. Subsequent scans of
+       * the same folder can then reuse these results for all files that have
+       * not changed since, and only need to parse new or modified files.
+       *
+       * Files are identified by their path relative to the DICOM folder, so
+       * that an index stored within the folder remains valid if the folder
+       * is moved or accessed via a different path. */
+      class Index { NOMEMALIGN
+        public:
+          class Entry { NOMEMALIGN
+            public:
+              Entry () : size (-1), mtime (0), inode (0), is_dicom (false) { }
+              std::string name;
+              QuickScan reader;
+              int64_t size, mtime;
+              uint64_t inode;
+              bool is_dicom;
+
+              //! whether the file is unchanged, based on its size, modification time (in ns) & inode
+              bool matches (const Entry& other) const {
+                return size == other.size && mtime == other.mtime && inode == other.inode;
+              }
+          };
+
+          //! load the index for \a folder, if enabled and present
+          Index (const std::string& folder);
+
+          bool enabled () const { return path.size(); }
+          const std::string& name () const { return path; }
+
+          //! retrieve the cached scan for \a entry, based on its name, size, modification time & inode
+          /*! returns false if no valid cached entry is available; \a
+           * entry.size, \a entry.mtime and \a entry.inode are set from the
+           * file in either case. */
+          bool find (Entry& entry) const;
+
+          //! record the outcome of scanning a file, in listing order
+          void update (const Entry& entry);
+
+          //! write the index back to disk, if it has changed
+          void save () const;
+
+        protected:
+          std::string folder, path;
+          std::unordered_map<std::string, Entry> entries;
+          vector<Entry> updated;
+          bool modified;
+
+          std::string relative (const std::string& name) const;
+          void load ();
+      };
+
+    }
+  }
+}
+
+#endif
+
@@ -70,7 +70,14 @@ namespace MR {
               else if (item.is (0x0028U, 0x0010U)) dim[1] = item.get_uint (0);
               else if (item.is (0x0028U, 0x0011U)) dim[0] = item.get_uint (0);
               else if (item.is (0x0028U, 0x0100U)) bits_alloc = item.get_uint (0);
-              else if (item.is (0x7FE0U, 0x0010U)) data = item.offset (item.data);
+              else if (item.is (0x7FE0U, 0x0010U)) {
+                data = item.offset (item.data);
+                // all the information needed is held in the header: unless
+                // the contents are to be printed, there is no need to walk
+                // through the pixel data (or anything that follows it)
+                if (item.parents.empty() && !print_DICOM_fields && !print_CSA_fields && !print_Phoenix)
+                  break;
+              }
               else if (item.is (0xFFFEU, 0xE000U)) {
                 if (item.parents.size() &&
                     item.parents.back().group ==  0x5200U &&
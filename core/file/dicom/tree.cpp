@@ -14,10 +14,12 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+#include "ordered_thread_queue.h"
 #include "file/path.h"
 #include "file/dicom/element.h"
 #include "file/dicom/quick_scan.h"
 #include "file/dicom/image.h"
+#include "file/dicom/index.h"
 #include "file/dicom/series.h"
 #include "file/dicom/study.h"
 #include "file/dicom/patient.h"
@@ -54,7 +56,7 @@ namespace MR {
 
 
 
-      void Tree::read_dir (const std::string& filename, ProgressBar& progress)
+      void Tree::read_dir (const std::string& filename, vector<std::string>& files, ProgressBar& progress)
       {
         try {
           Path::Dir folder (filename);
@@ -62,15 +64,9 @@ namespace MR {
           while ((entry = folder.read_name()).size()) {
             std::string name (Path::join (filename, entry));
             if (Path::is_dir (name))
-              read_dir (name, progress);
-            else {
-              try {
-                read_file (name);
-              }
-              catch (Exception& E) {
-                E.display (3);
-              }
-            }
+              read_dir (name, files, progress);
+            else
+              files.push_back (name);
             ++progress;
           }
         }
@@ -90,9 +86,17 @@ namespace MR {
           INFO ("error reading file \"" + filename + "\" - ignored");
           return;
         }
+        add (reader);
+      }
+
+
 
+
+
+      void Tree::add (const QuickScan& reader)
+      {
         if (! (reader.dim[0] && reader.dim[1] && reader.bits_alloc && reader.data)) {
-          INFO ("DICOM file \"" + filename + "\" does not seem to contain image data - ignored");
+          INFO ("DICOM file \"" + reader.filename + "\" does not seem to contain image data - ignored");
           return;
         }
 
@@ -102,7 +106,7 @@ namespace MR {
           std::shared_ptr<Series> series = study->find (reader.series, reader.series_number, image_type.first, reader.modality, reader.series_date, reader.series_time);
 
           std::shared_ptr<Image> image (new Image);
-          image->filename = filename;
+          image->filename = reader.filename;
           image->series = series.get();
           image->sequence_name = reader.sequence;
           image->image_type = image_type.first;
@@ -118,9 +122,57 @@ namespace MR {
       void Tree::read (const std::string& filename)
       {
         description = filename;
-        ProgressBar progress ("scanning DICOM folder \"" + shorten (filename) + "\"", 0);
-        if (Path::is_dir (filename))
-          read_dir (filename, progress);
+        if (Path::is_dir (filename)) {
+          vector<std::string> files;
+          {
+            ProgressBar progress ("listing DICOM folder \"" + shorten (filename) + "\"", 0);
+            read_dir (filename, files, progress);
+          }
+
+          Index index (filename);
+          // exclude the index itself, and any temporary files being written
+          // to it by concurrent invocations:
+          if (index.enabled())
+            files.erase (std::remove_if (files.begin(), files.end(), [&index](const std::string& name) {
+                  return !name.compare (0, index.name().size(), index.name()); }), files.end());
+
+          // files are scanned concurrently, but added to the tree in the order
+          // in which they were listed, so that the outcome does not depend on
+          // the number of threads:
+          ProgressBar progress ("scanning DICOM folder \"" + shorten (filename) + "\"", files.size());
+          size_t next = 0;
+          auto source = [&](Index::Entry& entry) {
+            if (next >= files.size())
+              return false;
+            entry.name = files[next++];
+            return true;
+          };
+          auto scan = [&index](const Index::Entry& in, Index::Entry& out) {
+            out = Index::Entry();
+            out.name = in.name;
+            if (index.enabled() && index.find (out))
+              return true;
+            try {
+              out.is_dicom = !out.reader.read (out.name);
+              if (!out.is_dicom)
+                INFO ("error reading file \"" + out.name + "\" - ignored");
+            }
+            catch (Exception& E) {
+              E.display (3);
+              out.is_dicom = false;
+            }
+            return true;
+          };
+          auto sink = [&](const Index::Entry& entry) {
+            if (entry.is_dicom)
+              add (entry.reader);
+            index.update (entry);
+            ++progress;
+            return true;
+          };
+          Thread::run_ordered_queue (source, Thread::batch (Index::Entry()), Thread::multi (scan), Thread::batch (Index::Entry()), sink);
+          index.save();
+        }
         else {
           try {
             read_file (filename);
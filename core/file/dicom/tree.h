@@ -19,6 +19,7 @@
 
 #include "memory.h"
 #include "file/dicom/patient.h"
+#include "file/dicom/quick_scan.h"
 
 namespace MR {
   namespace File {
@@ -43,8 +44,9 @@ namespace MR {
           }
 
         protected:
-          void read_dir (const std::string& filename, ProgressBar& progress);
+          void read_dir (const std::string& filename, vector<std::string>& files, ProgressBar& progress);
           void read_file (const std::string& filename);
+          void add (const QuickScan& reader);
       }; 
 
       std::ostream& operator<< (std::ostream& stream, const Tree& item);
@@ -21,8 +21,10 @@
 #include "image.h"
 #include "algo/copy.h"
 #include "algo/threaded_copy.h"
-#include "adapter/gaussian1D.h"
+#include "stride.h"
+#include "algo/threaded_loop.h"
 #include "filter/base.h"
+#include "math/math.h"
 
 namespace MR
 {
@@ -42,6 +44,15 @@ namespace MR
      * smooth_filter (input, output);
      *
      * \endcode
+     *
+     * The image is smoothed with three separable 1D passes. For each pass,
+     * lines along the axis being smoothed are processed in blocks of
+     * neighbouring lines (adjacent in memory), which are gathered into a
+     * buffer such that the convolution operates on all lines of the block at
+     * once, irrespective of the strides of the image. Where possible, the
+     * passes along the first two axes are applied one after the other to
+     * each slab of the image, so that the data are read from and written to
+     * memory once for both passes.
      */
 
     class Smooth : public Base
@@ -53,8 +64,9 @@ namespace MR
             Base (in),
             extent (3, 0),
             stdev (3, 0.0),
-            stride_order (Stride::order (in)),
-            zero_boundary (false)
+            zero_boundary (false),
+            recursive (false),
+            fft (false)
         {
           for (int i = 0; i < 3; i++)
             stdev[i] = in.spacing(i);
@@ -66,7 +78,9 @@ namespace MR
             Base (in),
             extent (3, 0),
             stdev (3, 0.0),
-            stride_order (Stride::order (in))
+            zero_boundary (false),
+            recursive (false),
+            fft (false)
         {
           set_stdev (stdev_in);
           datatype() = DataType::Float32;
@@ -99,6 +113,33 @@ namespace MR
           zero_boundary = do_zero_boundary;
         }
 
+        //! use a recursive approximation to the Gaussian for large kernels
+        /*! Along any axis where the standard deviation is at least
+         * recursive_min_stdev voxels and no kernel extent has been set, the
+         * Gaussian is approximated using the recursive (IIR) filter of Young
+         * & van Vliet (1995), such that the computational cost no longer
+         * depends on the width of the kernel. Note that this approximates the
+         * full (untruncated) Gaussian, with the image extended beyond its
+         * boundaries by replicating the edge values (Triggs & Sdika, 2006). */
+        void set_recursive (bool use_recursive) {
+          recursive = use_recursive;
+        }
+
+        //! perform the convolution in the frequency domain for large kernels
+        /*! Along any axis where the standard deviation is at least
+         * fft_min_stdev voxels, each line is convolved with the (truncated)
+         * kernel via the FFT, applied to all lines of a block at once using
+         * a transfer function computed once per pass, such that the
+         * computational cost depends only weakly on the width of the kernel.
+         * Unlike the recursive filter, this
+         * produces the same result as the spatial kernel (to within
+         * round-off), including the renormalisation of the kernel at the
+         * image boundaries. Where both are enabled, the recursive filter
+         * takes precedence. */
+        void set_fft (bool use_fft) {
+          fft = use_fft;
+        }
+
         //! Set the standard deviation of the Gaussian defined in mm.
         //! This must be set as a single value to be used for the first 3 dimensions
         //! or separate values, one for each dimension. (Default: 1 voxel)
@@ -122,31 +163,10 @@ namespace MR
         template <class InputImageType, class OutputImageType, typename ValueType = float>
         void operator() (InputImageType& input, OutputImageType& output)
         {
-          std::shared_ptr <Image<ValueType> > in (make_shared<Image<ValueType> > (Image<ValueType>::scratch (input)));
-          threaded_copy (input, *in);
-          std::shared_ptr <Image<ValueType> > out;
-
-          std::unique_ptr<ProgressBar> progress;
-          if (message.size()) {
-            size_t axes_to_smooth = 0;
-            for (vector<default_type>::const_iterator i = stdev.begin(); i != stdev.end(); ++i)
-              if (*i)
-                ++axes_to_smooth;
-            progress.reset (new ProgressBar (message, axes_to_smooth + 1));
-          }
-
-          for (size_t dim = 0; dim < 3; dim++) {
-            if (stdev[dim] > 0) {
-              DEBUG ("creating scratch image for smoothing image along dimension " + str(dim));
-              out = make_shared<Image<ValueType> > (Image<ValueType>::scratch (input));
-              Adapter::Gaussian1D<Image<ValueType> > gaussian (*in, stdev[dim], dim, extent[dim], zero_boundary);
-              threaded_copy (gaussian, *out, 0, input.ndim(), 2);
-              in = out;
-              if (progress)
-                ++(*progress);
-            }
-          }
-          threaded_copy (*in, output);
+          auto in = Image<ValueType>::scratch (input);
+          threaded_copy (input, in);
+          (*this) (in);
+          threaded_copy (in, output);
         }
 
         //! Smooth the image in place
@@ -162,44 +182,106 @@ namespace MR
             progress.reset (new ProgressBar (message, axes_to_smooth + 1));
           }
 
+          const vector<size_t> stride_order = Stride::order (in_and_output);
+          SmoothPasses<ImageType> passes;
+          vector<size_t> outer_axes;
           for (size_t dim = 0; dim < 3; dim++) {
             if (stdev[dim] > 0) {
-              vector<size_t> axes (in_and_output.ndim(), dim);
-              size_t axdim = 1;
-              for (size_t i = 0; i < in_and_output.ndim(); ++i) {
-                if (stride_order[i] == dim)
-                  continue;
-                axes[axdim++] = stride_order[i];
+              // lines are gathered along the axis of smallest stride other than
+              // dim, or along the two smallest if the first is too short to
+              // fill a block of lines
+              vector<size_t> axes;
+              for (auto axis : stride_order)
+                if (axis != dim)
+                  axes.push_back (axis);
+              size_t num_line_axes = axes.size() > 2 && in_and_output.size (axes[0]) < block_size ? 2 : 1;
+
+              // passes that share the same outer axes operate on the same
+              // sub-images, and are applied in turn to each sub-image while it
+              // remains in cache, rather than each over the whole image
+              if (passes.size() && std::find (outer_axes.begin(), outer_axes.end(), dim) == outer_axes.end()
+                  && axes.size() - outer_axes.size() <= 2) {
+                std::stable_partition (axes.begin(), axes.end(), [&] (size_t axis) {
+                    return std::find (outer_axes.begin(), outer_axes.end(), axis) == outer_axes.end(); });
+                num_line_axes = axes.size() - outer_axes.size();
               }
-              DEBUG ("smoothing dimension " + str(dim) + " in place with stride order: " + str(axes));
-              SmoothFunctor1D<ImageType> smooth (in_and_output, stdev[dim], dim, extent[dim], zero_boundary);
-              ThreadedLoop (in_and_output, axes, 1).run (smooth, in_and_output);
-              if (progress)
-                ++(*progress);
+              const vector<size_t> line_axes (axes.begin(), axes.begin() + num_line_axes);
+              const vector<size_t> dim_outer_axes (axes.begin() + num_line_axes, axes.end());
+              if (passes.size() && dim_outer_axes != outer_axes)
+                run_passes (in_and_output, passes, outer_axes, progress);
+              outer_axes = dim_outer_axes;
+              DEBUG ("smoothing dimension " + str(dim) + " in place in blocks along axes " + str(line_axes));
+              passes.push_back (SmoothFunctor1D<ImageType> (in_and_output, stdev[dim], dim, line_axes, outer_axes, extent[dim], zero_boundary, recursive, fft));
             }
           }
+          if (passes.size())
+            run_passes (in_and_output, passes, outer_axes, progress);
         }
 
+        //! the minimum standard deviation (in voxels) for which the recursive filter is used
+        static constexpr default_type recursive_min_stdev = 2.0;
+
+        //! the minimum standard deviation (in voxels) for which the convolution is performed via the FFT
+        static constexpr default_type fft_min_stdev = 16.0;
+
       protected:
         vector<uint32_t> extent;
         vector<default_type> stdev;
-        const vector<size_t> stride_order;
         bool zero_boundary;
+        bool recursive;
+        bool fft;
+
+        // number of lines smoothed together; blocks at the edge of the image
+        // are padded with zeros
+        static constexpr ssize_t block_size = 16;
+
+        template <class ImageType> class SmoothFunctor1D;
+
+        // consecutive 1D passes, applied in turn at each outer position
+        template <class ImageType>
+          class SmoothPasses : public vector<SmoothFunctor1D<ImageType>> { MEMALIGN (SmoothPasses<ImageType>)
+            public:
+              void operator() (const Iterator& pos) {
+                for (auto& pass : *this)
+                  pass (pos);
+              }
+          };
+
+        template <class ImageType>
+          void run_passes (ImageType& image, SmoothPasses<ImageType>& passes, const vector<size_t>& outer_axes, std::unique_ptr<ProgressBar>& progress)
+          {
+            vector<size_t> inner_axes;
+            for (size_t axis = 0; axis < image.ndim(); ++axis)
+              if (std::find (outer_axes.begin(), outer_axes.end(), axis) == outer_axes.end())
+                inner_axes.push_back (axis);
+            ThreadedLoop (image, outer_axes, inner_axes).run_outer (passes);
+            if (progress)
+              for (size_t n = 0; n < passes.size(); ++n)
+                ++(*progress);
+            passes.clear();
+          }
 
         template <class ImageType>
           class SmoothFunctor1D { MEMALIGN (SmoothFunctor1D)
           public:
             SmoothFunctor1D (ImageType& image,
-                           default_type stdev_in = 1.0,
-                           size_t axis_in = 0,
+                           default_type stdev_in,
+                           size_t axis_in,
+                           const vector<size_t>& line_axes,
+                           const vector<size_t>& outer_axes,
                            size_t extent = 0,
-                           bool zero_boundary_in = false):
+                           bool zero_boundary_in = false,
+                           bool recursive_in = false,
+                           bool fft_in = false):
+                image (image),
+                outer_axes (outer_axes),
                 stdev (stdev_in),
                 axis (axis_in),
+                line_axes (line_axes),
                 zero_boundary (zero_boundary_in),
                 spacing (image.spacing(axis_in)),
-                buffer_size (image.size(axis_in)) {
-                  buffer.resize(buffer_size);
+                recursive (recursive_in && !extent && stdev_in / spacing >= recursive_min_stdev),
+                fft (fft_in && !recursive && stdev_in / spacing >= fft_min_stdev) {
                   if (!extent)
                     radius = std::ceil(2 * stdev / spacing);
                   else if (extent == 1)
@@ -207,6 +289,10 @@ namespace MR
                   else
                     radius = (extent - 1) / 2;
                   compute_kernel();
+                  if (recursive)
+                    compute_recursive_coefficients();
+                  if (fft && kernel.size())
+                    compute_transfer_function();
               }
 
             using value_type = typename ImageType::value_type;
@@ -225,64 +311,317 @@ namespace MR
               }
             }
 
-            // SmoothFunctor1D operator():
-            // the inner loop axis has to be the dimension the smoothing is applied to and
-            // the loop has to start with image.index (smooth_axis) == 0
-            void operator () (ImageType& image) {
-              if (!kernel.size())
-                return;
+            // Young & van Vliet (1995) coefficients, with the
+            // boundary matrix of Triggs & Sdika (2006) obtained by running
+            // the filter over the (decaying) response to each initial state
+            void compute_recursive_coefficients() {
+              const default_type sigma = stdev / spacing;
+              const default_type q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * std::sqrt (1.0 - 0.26891 * sigma);
+              const default_type b0 = 1.57825 + 2.44413*q + 1.4281*q*q + 0.422205*q*q*q;
+              a[0] = (2.44413*q + 2.85619*q*q + 1.26661*q*q*q) / b0;
+              a[1] = -(1.4281*q*q + 1.26661*q*q*q) / b0;
+              a[2] = 0.422205*q*q*q / b0;
+              gain = 1.0 - (a[0] + a[1] + a[2]);
 
-              const ssize_t pos = image.index (axis);
-
-              // fill buffer for current image line if necessary
-              if (pos == 0) {
-                for (ssize_t k = 0; k < buffer_size; ++k) {
-                  image.index(axis) = k;
-                  buffer(k) = image.value();
+              const size_t tail = std::ceil (30.0 * sigma) + 100;
+              vector<default_type> w (tail), y (tail);
+              for (size_t j = 0; j < 3; ++j) {
+                default_type p[3] = { 0.0, 0.0, 0.0 };
+                p[j] = 1.0;
+                for (size_t k = 0; k < tail; ++k) {
+                  w[k] = a[0]*p[0] + a[1]*p[1] + a[2]*p[2];
+                  p[2] = p[1]; p[1] = p[0]; p[0] = w[k];
                 }
-                image.index (axis) = pos;
-              }
-
-              if (zero_boundary)
-                if (pos == 0 || pos == image.size(axis) - 1) {
-                  image.value() = 0.0;
-                  return;
+                p[0] = p[1] = p[2] = 0.0;
+                for (size_t k = tail; k-- > 0;) {
+                  y[k] = gain*w[k] + a[0]*p[0] + a[1]*p[1] + a[2]*p[2];
+                  p[2] = p[1]; p[1] = p[0]; p[0] = y[k];
                 }
+                for (size_t i = 0; i < 3; ++i)
+                  boundary(i,j) = y[i];
+              }
+            }
 
-              const ssize_t from = (pos < radius) ? 0 : pos - radius;
-              const ssize_t to = (pos + radius) >= image.size(axis) ? image.size(axis) - 1 : pos + radius;
-
-              ssize_t c = (pos < radius) ? radius - pos : 0;
-              ssize_t kernel_size = to - from + 1;
+            // twiddle factors for the batched FFT, and the transfer function
+            // of the kernel centred on the origin, in the bit-reversed order
+            // in which the forward transform produces its output. The line
+            // is zero-padded to a power of two at least radius beyond its
+            // end, such that the circular convolution matches the linear one
+            // over the image. The 1/N scaling of the inverse transform is
+            // folded into the transfer function.
+            void compute_transfer_function() {
+              const ssize_t size = image.size (axis);
+              ssize_t fft_size = 2;
+              while (fft_size < size + radius)
+                fft_size *= 2;
+              twiddle_re.resize (fft_size/2);
+              twiddle_im.resize (fft_size/2);
+              for (ssize_t n = 0; n < fft_size/2; ++n) {
+                twiddle_re[n] = std::cos (2.0 * Math::pi * n / fft_size);
+                twiddle_im[n] = -std::sin (2.0 * Math::pi * n / fft_size);
+              }
+              transfer.resize (fft_size);
+              for (ssize_t n = 0; n < fft_size; ++n) {
+                ssize_t m = 0;
+                for (ssize_t bit = 1, rev = fft_size/2; bit < fft_size; bit *= 2, rev /= 2)
+                  if (n & bit)
+                    m |= rev;
+                default_type value = kernel[radius];
+                for (ssize_t c = 1; c <= radius; ++c)
+                  value += 2.0 * kernel[radius + c] * std::cos (2.0 * Math::pi * ((m * c) % fft_size) / fft_size);
+                transfer[n] = value / fft_size;
+              }
 
-              value_type result = kernel.segment(c, kernel_size).dot(buffer.segment(from, kernel_size));
+              edge_weights.resize (size);
+              for (ssize_t pos = 0; pos < size; ++pos) {
+                const ssize_t from = (pos < radius) ? 0 : pos - radius;
+                const ssize_t to = (pos + radius) >= size ? size - 1 : pos + radius;
+                const ssize_t c = (pos < radius) ? radius - pos : 0;
+                const ssize_t kernel_size = to - from + 1;
+                edge_weights[pos] = kernel_size != kernel.size() ? kernel.segment (c, kernel_size).sum() : 1.0;
+              }
+            }
 
-              if (!std::isfinite(result)) {
-                result = 0.0;
-                value_type av_weights = 0.0;
-                for (ssize_t k = from; k <= to; ++k, ++c) {
-                  value_type neighbour_value = buffer(k);
-                  if (std::isfinite (neighbour_value)) {
-                    av_weights += kernel[c];
-                    result += neighbour_value * kernel[c];
-                  }
+            // smooth all lines along the smoothing axis within the plane
+            // spanned by the smoothing axis and the line axis at this position
+            void operator() (const Iterator& pos) {
+              if (!kernel.size())
+                return;
+              assign_pos_of (pos, outer_axes).to (image);
+              const ssize_t num_lines = line_axes.size() > 1 ? image.size (line_axes[0]) * image.size (line_axes[1]) : image.size (line_axes[0]);
+              for (ssize_t first = 0; first < num_lines; first += block_size) {
+                const ssize_t lines = num_lines - first < block_size ? num_lines - first : block_size;
+                load (first, lines);
+                if (recursive && buffer.allFinite())
+                  filter_recursive();
+                else if (fft && buffer.allFinite())
+                  filter_fft();
+                else
+                  filter_kernel();
+                if (zero_boundary) {
+                  result.col(0).setZero();
+                  result.col(result.cols()-1).setZero();
                 }
-                result /= av_weights;
-              } else if (kernel_size != kernel.size()) {
-                result /= kernel.segment(c, kernel_size).sum();
+                store (first, lines);
               }
-              image.value() = result;
             }
 
           private:
+            using block_type = Eigen::Array<default_type, block_size, Eigen::Dynamic>;
+            using line_type = Eigen::Array<default_type, block_size, 1>;
+            using half_block_type = Eigen::Array<default_type, block_size/2, Eigen::Dynamic>;
+            using half_line_type = Eigen::Array<default_type, block_size/2, 1>;
+
+            ImageType image;
+            const vector<size_t> outer_axes;
             const default_type stdev;
             ssize_t radius;
             size_t axis;
+            const vector<size_t> line_axes;
             Eigen::VectorXd kernel;
             const bool zero_boundary;
             const default_type spacing;
-            ssize_t buffer_size;
-            Eigen::VectorXd buffer;
+            const bool recursive;
+            const bool fft;
+            default_type a[3], gain;
+            Eigen::VectorXd twiddle_re, twiddle_im, transfer, edge_weights;
+            half_block_type fft_re, fft_im;
+            Eigen::Matrix3d boundary;
+            // one row per line, one column per position along the smoothing axis
+            block_type buffer, result;
+            line_type p0, p1, p2, p3;
+            ssize_t offsets[block_size];
+
+            // direct access to the image data where possible
+            template <typename ValueType>
+              static ValueType* address (Image<ValueType>& image) {
+                return image.is_direct_io() && !std::is_same<ValueType, bool>::value ? image.address() : nullptr;
+              }
+            template <class OtherImageType>
+              static value_type* address (OtherImageType&) { return nullptr; }
+
+            // move to the start of line number n within the block
+            void set_line (const ssize_t n) {
+              image.index (line_axes[0]) = n % image.size (line_axes[0]);
+              if (line_axes.size() > 1)
+                image.index (line_axes[1]) = n / image.size (line_axes[0]);
+            }
+
+            // offsets to the start of each line of the block, relative to the first
+            void line_offsets (const ssize_t first, const ssize_t lines) {
+              const ssize_t base = (first % image.size (line_axes[0])) * image.stride (line_axes[0])
+                + (line_axes.size() > 1 ? (first / image.size (line_axes[0])) * image.stride (line_axes[1]) : 0);
+              for (ssize_t l = 0; l < lines; ++l) {
+                const ssize_t n = first + l;
+                offsets[l] = (n % image.size (line_axes[0])) * image.stride (line_axes[0])
+                  + (line_axes.size() > 1 ? (n / image.size (line_axes[0])) * image.stride (line_axes[1]) : 0) - base;
+              }
+            }
+
+            void load (const ssize_t first, const ssize_t lines) {
+              buffer.resize (block_size, image.size (axis));
+              if (lines < block_size)
+                buffer.setZero();
+              image.index (axis) = 0;
+              set_line (first);
+              const value_type* p = address (image);
+              if (p) {
+                line_offsets (first, lines);
+                const ssize_t axis_stride = image.stride (axis);
+                for (ssize_t k = 0; k < buffer.cols(); ++k, p += axis_stride)
+                  for (ssize_t l = 0; l < lines; ++l)
+                    buffer(l,k) = p[offsets[l]];
+                return;
+              }
+              for (ssize_t k = 0; k < buffer.cols(); ++k) {
+                image.index (axis) = k;
+                for (ssize_t l = 0; l < lines; ++l) {
+                  set_line (first + l);
+                  buffer(l,k) = image.value();
+                }
+              }
+            }
+
+            void store (const ssize_t first, const ssize_t lines) {
+              image.index (axis) = 0;
+              set_line (first);
+              value_type* p = address (image);
+              if (p) {
+                line_offsets (first, lines);
+                const ssize_t axis_stride = image.stride (axis);
+                for (ssize_t k = 0; k < result.cols(); ++k, p += axis_stride)
+                  for (ssize_t l = 0; l < lines; ++l)
+                    p[offsets[l]] = value_type (result(l,k));
+                return;
+              }
+              for (ssize_t k = 0; k < result.cols(); ++k) {
+                image.index (axis) = k;
+                for (ssize_t l = 0; l < lines; ++l) {
+                  set_line (first + l);
+                  image.value() = value_type (result(l,k));
+                }
+              }
+            }
+
+            void filter_kernel () {
+              const ssize_t size = buffer.cols();
+              result.resize (block_size, size);
+              for (ssize_t pos = 0; pos < size; ++pos) {
+                const ssize_t from = (pos < radius) ? 0 : pos - radius;
+                const ssize_t to = (pos + radius) >= size ? size - 1 : pos + radius;
+                const ssize_t c = (pos < radius) ? radius - pos : 0;
+                const ssize_t kernel_size = to - from + 1;
+
+                auto out = result.col (pos);
+                out = kernel[c] * buffer.col (from);
+                for (ssize_t k = 1; k < kernel_size; ++k)
+                  out += kernel[c+k] * buffer.col (from+k);
+                if (kernel_size != kernel.size())
+                  out /= kernel.segment (c, kernel_size).sum();
+
+                // exclude non-finite neighbours from the weighted average
+                for (ssize_t l = 0; l < out.size(); ++l) {
+                  if (std::isfinite (out[l]))
+                    continue;
+                  default_type sum = 0.0, av_weights = 0.0;
+                  for (ssize_t k = 0; k < kernel_size; ++k) {
+                    const default_type neighbour_value = buffer(l, from+k);
+                    if (std::isfinite (neighbour_value)) {
+                      av_weights += kernel[c+k];
+                      sum += neighbour_value * kernel[c+k];
+                    }
+                  }
+                  out[l] = sum / av_weights;
+                }
+              }
+            }
+
+            // the lines of the block are transformed together, with the
+            // first and second halves of the block as the real and imaginary
+            // parts of the data: since the transfer function is real (the
+            // kernel being symmetric), the two remain separate. The forward
+            // transform (decimation in frequency) leaves its output in
+            // bit-reversed order, which the inverse transform (decimation in
+            // time) takes as input, so no reordering is needed.
+            void filter_fft () {
+              const ssize_t size = buffer.cols();
+              const ssize_t fft_size = transfer.size();
+              result.resize (block_size, size);
+              fft_re.resize (block_size/2, fft_size);
+              fft_im.resize (block_size/2, fft_size);
+              fft_re.leftCols (size) = buffer.topRows (block_size/2);
+              fft_im.leftCols (size) = buffer.bottomRows (block_size/2);
+              fft_re.rightCols (fft_size - size).setZero();
+              fft_im.rightCols (fft_size - size).setZero();
+
+              half_line_type u_re, u_im, v_re, v_im;
+              for (ssize_t half = fft_size/2, step = 1; half >= 1; half /= 2, step *= 2) {
+                for (ssize_t start = 0; start < fft_size; start += 2*half) {
+                  for (ssize_t j = 0; j < half; ++j) {
+                    const default_type w_re = twiddle_re[j*step], w_im = twiddle_im[j*step];
+                    u_re = fft_re.col (start+j);
+                    u_im = fft_im.col (start+j);
+                    v_re = fft_re.col (start+j+half);
+                    v_im = fft_im.col (start+j+half);
+                    fft_re.col (start+j) = u_re + v_re;
+                    fft_im.col (start+j) = u_im + v_im;
+                    u_re -= v_re;
+                    u_im -= v_im;
+                    fft_re.col (start+j+half) = w_re * u_re - w_im * u_im;
+                    fft_im.col (start+j+half) = w_re * u_im + w_im * u_re;
+                  }
+                }
+              }
+
+              for (ssize_t n = 0; n < fft_size; ++n) {
+                fft_re.col (n) *= transfer[n];
+                fft_im.col (n) *= transfer[n];
+              }
+
+              for (ssize_t half = 1, step = fft_size/2; half < fft_size; half *= 2, step /= 2) {
+                for (ssize_t start = 0; start < fft_size; start += 2*half) {
+                  for (ssize_t j = 0; j < half; ++j) {
+                    const default_type w_re = twiddle_re[j*step], w_im = -twiddle_im[j*step];
+                    u_re = fft_re.col (start+j);
+                    u_im = fft_im.col (start+j);
+                    v_re = w_re * fft_re.col (start+j+half) - w_im * fft_im.col (start+j+half);
+                    v_im = w_re * fft_im.col (start+j+half) + w_im * fft_re.col (start+j+half);
+                    fft_re.col (start+j) = u_re + v_re;
+                    fft_im.col (start+j) = u_im + v_im;
+                    fft_re.col (start+j+half) = u_re - v_re;
+                    fft_im.col (start+j+half) = u_im - v_im;
+                  }
+                }
+              }
+
+              for (ssize_t k = 0; k < size; ++k) {
+                result.col (k).head (block_size/2) = fft_re.col (k) / edge_weights[k];
+                result.col (k).tail (block_size/2) = fft_im.col (k) / edge_weights[k];
+              }
+            }
+
+            void filter_recursive () {
+              const ssize_t size = buffer.cols();
+              result.resize (block_size, size);
+              // causal pass, initialised with the steady state for the first value
+              p1 = p2 = p3 = buffer.col (0);
+              for (ssize_t k = 0; k < size; ++k) {
+                p0 = gain * buffer.col (k) + a[0] * p1 + a[1] * p2 + a[2] * p3;
+                result.col (k) = p0;
+                p3.swap (p2); p2.swap (p1); p1.swap (p0);
+              }
+              // anti-causal pass, initialised from the causal state at the end
+              const line_type last = buffer.col (size-1);
+              const line_type d1 = p1 - last, d2 = p2 - last, d3 = p3 - last;
+              p1 = boundary(0,0) * d1 + boundary(0,1) * d2 + boundary(0,2) * d3 + last;
+              p2 = boundary(1,0) * d1 + boundary(1,1) * d2 + boundary(1,2) * d3 + last;
+              p3 = boundary(2,0) * d1 + boundary(2,1) * d2 + boundary(2,2) * d3 + last;
+              for (ssize_t k = size; k-- > 0;) {
+                p0 = gain * result.col (k) + a[0] * p1 + a[1] * p2 + a[2] * p3;
+                result.col (k) = p0;
+                p3.swap (p2); p2.swap (p1); p1.swap (p0);
+              }
+            }
           };
     };
     //! @}
@@ -317,6 +317,39 @@ namespace MR
       return header;
     }
 
+    //! Generate a header for a packed fixel data file (NxMx1) using an index image as a template
+    /*! A packed fixel data file holds M fixel data files (e.g. the same
+     * metric for many subjects) as the columns of a single file, with the
+     * name of each column stored in the header. Since the fixel axis has
+     * the smallest stride, the data of each column are contiguous on disk,
+     * and can be read from a memory-mapped file independently. */
+    template <class IndexHeaderType>
+    FORCE_INLINE Header packed_data_header_from_index (IndexHeaderType& index, const vector<std::string>& columns) {
+      Header header = data_header_from_index (index);
+      header.size(1) = columns.size();
+      header.keyval()[packed_columns_key] = join (columns, "\n");
+      return header;
+    }
+
+    template <class HeaderType>
+    FORCE_INLINE bool is_packed_data_file (const HeaderType& in)
+    {
+      return is_data_file (in) && in.keyval().count (packed_columns_key);
+    }
+
+    //! Get the names of the columns of a packed fixel data file
+    template <class HeaderType>
+    FORCE_INLINE vector<std::string> get_packed_columns (const HeaderType& in)
+    {
+      if (!is_packed_data_file (in))
+        throw InvalidImageException (in.name() + " is not a valid packed fixel data file");
+      const auto columns = split_lines (in.keyval().at (packed_columns_key));
+      if (columns.size() != size_t (in.size(1)))
+        throw InvalidImageException ("Number of column names in packed fixel data file " + in.name() + " (" + str(columns.size())
+                                     + ") does not match number of columns (" + str(in.size(1)) + ")");
+      return columns;
+    }
+
     //! Generate a header for a fixel directions data file (Nx3x1) using an index image as a template
     template <class IndexHeaderType>
     FORCE_INLINE Header directions_header_from_index (IndexHeaderType& index) {
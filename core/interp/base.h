@@ -218,6 +218,139 @@ namespace MR
 
 
 
+    //! \cond skip
+
+    // Helper for the batched interpolation methods: reads the intensity of
+    //   voxel [ x y z ] (or the row of intensities along axis 3 for that
+    //   voxel) at the current position along the remaining axes
+    template <class ImageType, typename Enable = void>
+      class VoxelAccess { NOMEMALIGN
+        public:
+          using value_type = typename ImageType::value_type;
+
+          VoxelAccess (ImageType& image) : image (image) { }
+
+          FORCE_INLINE value_type value (const ssize_t x, const ssize_t y, const ssize_t z) {
+            image.index(0) = x;
+            image.index(1) = y;
+            image.index(2) = z;
+            return image.value();
+          }
+
+          template <class RowType>
+          FORCE_INLINE void row (const ssize_t x, const ssize_t y, const ssize_t z, RowType&& row) {
+            image.index(0) = x;
+            image.index(1) = y;
+            image.index(2) = z;
+            row = image.row (3);
+          }
+
+          // intensities of the NxNxN neighbourhood spanned by voxel indices
+          //   x, y & z, written to dest in x-fastest order
+          template <size_t N, class DestType>
+          FORCE_INLINE void neighbourhood (const ssize_t (&x)[N], const ssize_t (&y)[N], const ssize_t (&z)[N], DestType&& dest) {
+            size_t i = 0;
+            for (size_t c = 0; c < N; ++c) {
+              image.index(2) = z[c];
+              for (size_t b = 0; b < N; ++b) {
+                image.index(1) = y[b];
+                for (size_t a = 0; a < N; ++a) {
+                  image.index(0) = x[a];
+                  dest[i++] = image.value();
+                }
+              }
+            }
+          }
+
+        private:
+          ImageType& image;
+      };
+
+    // For Image<ValueType> with direct IO, intensities are read straight from
+    //   memory using the image strides, without updating the image position
+    template <class ImageType>
+      class VoxelAccess<ImageType, typename std::enable_if<is_pure_image<ImageType>::value &&
+                                                           !std::is_same<typename ImageType::value_type, bool>::value>::type> { NOMEMALIGN
+        public:
+          using value_type = typename ImageType::value_type;
+
+          VoxelAccess (ImageType& image) :
+              image (image),
+              origin (nullptr),
+              stride { image.stride(0), image.stride(1), image.stride(2) }
+          {
+            if (image.is_direct_io()) {
+              image.index(0) = image.index(1) = image.index(2) = 0;
+              origin = image.address();
+            }
+          }
+
+          FORCE_INLINE value_type value (const ssize_t x, const ssize_t y, const ssize_t z) {
+            if (origin)
+              return origin[x*stride[0] + y*stride[1] + z*stride[2]];
+            image.index(0) = x;
+            image.index(1) = y;
+            image.index(2) = z;
+            return image.value();
+          }
+
+          template <class RowType>
+          FORCE_INLINE void row (const ssize_t x, const ssize_t y, const ssize_t z, RowType&& row) {
+            if (origin) {
+              const ssize_t stride3 = image.stride(3);
+              const value_type* p = origin + x*stride[0] + y*stride[1] + z*stride[2] - image.index(3)*stride3;
+              for (ssize_t n = 0; n < image.size(3); ++n)
+                row[n] = p[n*stride3];
+              return;
+            }
+            image.index(0) = x;
+            image.index(1) = y;
+            image.index(2) = z;
+            row = image.row (3);
+          }
+
+          template <size_t N, class DestType>
+          FORCE_INLINE void neighbourhood (const ssize_t (&x)[N], const ssize_t (&y)[N], const ssize_t (&z)[N], DestType&& dest) {
+            if (!origin) {
+              size_t i = 0;
+              for (size_t c = 0; c < N; ++c) {
+                image.index(2) = z[c];
+                for (size_t b = 0; b < N; ++b) {
+                  image.index(1) = y[b];
+                  for (size_t a = 0; a < N; ++a) {
+                    image.index(0) = x[a];
+                    dest[i++] = image.value();
+                  }
+                }
+              }
+              return;
+            }
+            ssize_t offset[3][N];
+            for (size_t a = 0; a < N; ++a) {
+              offset[0][a] = x[a] * stride[0];
+              offset[1][a] = y[a] * stride[1];
+              offset[2][a] = z[a] * stride[2];
+            }
+            size_t i = 0;
+            for (size_t c = 0; c < N; ++c) {
+              for (size_t b = 0; b < N; ++b) {
+                const value_type* p = origin + offset[2][c] + offset[1][b];
+                for (size_t a = 0; a < N; ++a)
+                  dest[i++] = p[offset[0][a]];
+              }
+            }
+          }
+
+        private:
+          ImageType& image;
+          const value_type* origin;
+          const ssize_t stride[3];
+      };
+
+    //! \endcond
+
+
+
     //! @}
 
   }
@@ -208,8 +208,136 @@ namespace MR
           return coeff_matrix * weights_vec;
         }
 
+        //! Read interpolated values at a block of <b>voxel space</b> positions
+        /*! \a positions should be a 3xN matrix holding one position per
+         * column; on return, \a values holds the N interpolated values (with
+         * the out-of-bounds value for positions outside of the image), taken
+         * at the current position along the remaining axes.
+         *
+         * Points are processed in blocks: the 64 interpolation weights are
+         * formed for all points of the block at once from the per-axis
+         * spline weights, the image intensities are then gathered (directly
+         * from memory where the image allows it), and the weighted sums
+         * evaluated across the whole block. On return, the interpolator is
+         * left in the out-of-bounds state. */
+        template <class PositionsType, class ValuesType>
+        FORCE_INLINE void voxel_values (const PositionsType& positions, ValuesType& values) {
+          block_values (positions, values, transform_type::Identity());
+        }
+
+        //! Read interpolated values at a block of <b>scanner space</b> positions
+        /*! See voxel_values() for details. */
+        template <class PositionsType, class ValuesType>
+        FORCE_INLINE void scanner_values (const PositionsType& positions, ValuesType& values) {
+          block_values (positions, values, Transform::scanner2voxel);
+        }
+
+        //! Read interpolated rows along axis 3 at a block of <b>voxel space</b> positions
+        /*! \a positions should be a 3xN matrix holding one position per
+         * column; on return, column j of \a rows holds the interpolated
+         * values of all volumes at position j. The coefficient matrix is
+         * allocated once for the whole block rather than for every point.
+         * See voxel_values() for details. */
+        template <class PositionsType, class RowsType>
+        FORCE_INLINE void voxel_rows (const PositionsType& positions, RowsType& rows) {
+          block_rows (positions, rows, transform_type::Identity());
+        }
+
+        //! Read interpolated rows along axis 3 at a block of <b>scanner space</b> positions
+        /*! See voxel_rows() for details. */
+        template <class PositionsType, class RowsType>
+        FORCE_INLINE void scanner_rows (const PositionsType& positions, RowsType& rows) {
+          block_rows (positions, rows, Transform::scanner2voxel);
+        }
+
       protected:
         Eigen::Matrix<value_type, 64, 1> weights_vec;
+
+        template <class PositionsType, class ValuesType>
+        void block_values (const PositionsType& positions, ValuesType& values, const transform_type& to_voxel) {
+          const ssize_t num = positions.cols();
+          values.resize (num);
+          const ssize_t block = std::min (num, ssize_t(256));
+          VoxelAccess<ImageType> access (*this);
+          const ssize_t dim[] = { ImageType::size (0), ImageType::size (1), ImageType::size (2) };
+          Eigen::Matrix<default_type, 3, Eigen::Dynamic> pos (3, block);
+          Eigen::Array<default_type, 3, Eigen::Dynamic> corner (3, block);
+          Eigen::Array<value_type, 12, Eigen::Dynamic> axis_weights (12, block);
+          Eigen::Array<value_type, 64, Eigen::Dynamic> weights (64, block);
+          Eigen::Array<value_type, 64, Eigen::Dynamic> coeffs (64, block);
+          Eigen::Array<value_type, 1, Eigen::Dynamic> partial_weight (block), sums (block);
+
+          for (ssize_t start = 0; start < num; start += block) {
+            const ssize_t n = std::min (block, num - start);
+            pos.leftCols (n) = to_voxel * positions.middleCols (start, n).template cast<default_type>();
+            corner.leftCols (n) = pos.leftCols (n).array().floor();
+
+            for (ssize_t j = 0; j < n; ++j) {
+              if (Base<ImageType>::set_out_of_bounds (pos.col (j))) {
+                // yields exactly the out-of-bounds value in the weighted sum
+                coeffs.col (j).setZero();
+                axis_weights.col (j).setZero();
+                coeffs (0, j) = Base<ImageType>::out_of_bounds_value;
+                axis_weights (0, j) = axis_weights (4, j) = axis_weights (8, j) = value_type (1);
+                continue;
+              }
+              for (size_t axis = 0; axis != 3; ++axis) {
+                H[axis].set (pos (axis, j) - corner (axis, j));
+                axis_weights.col (j).segment (4*axis, 4) = H[axis].weights.transpose().array();
+              }
+              ssize_t ix[4], iy[4], iz[4];
+              for (ssize_t a = 0; a < 4; ++a) {
+                ix[a] = clamp (ssize_t (corner (0, j)) - 1 + a, dim[0]);
+                iy[a] = clamp (ssize_t (corner (1, j)) - 1 + a, dim[1]);
+                iz[a] = clamp (ssize_t (corner (2, j)) - 1 + a, dim[2]);
+              }
+              access.neighbourhood (ix, iy, iz, coeffs.col (j));
+            }
+
+            // Weights for the whole block, as computed in voxel()
+            size_t i (0);
+            for (ssize_t z = 0; z < 4; ++z) {
+              for (ssize_t y = 0; y < 4; ++y) {
+                partial_weight.head (n) = axis_weights.row (4+y).head (n) * axis_weights.row (8+z).head (n);
+                for (ssize_t x = 0; x < 4; ++x)
+                  weights.row (i++).head (n) = axis_weights.row (x).head (n) * partial_weight.head (n);
+              }
+            }
+
+            sums.head (n) = (coeffs.leftCols (n) * weights.leftCols (n)).colwise().sum();
+            for (ssize_t j = 0; j < n; ++j)
+              values[start + j] = sums[j];
+          }
+          Base<ImageType>::set_out_of_bounds (true);
+        }
+
+        template <class PositionsType, class RowsType>
+        void block_rows (const PositionsType& positions, RowsType& rows, const transform_type& to_voxel) {
+          assert (ImageType::ndim() == 4);
+          const ssize_t num = positions.cols();
+          rows.resize (ImageType::size(3), num);
+          VoxelAccess<ImageType> access (*this);
+          Eigen::Matrix<value_type, Eigen::Dynamic, 64> coeff_matrix (ImageType::size(3), 64);
+
+          for (ssize_t j = 0; j < num; ++j) {
+            if (!voxel (Eigen::Vector3 (to_voxel * positions.col (j).template cast<default_type>()))) {
+              rows.col (j).fill (Base<ImageType>::out_of_bounds_value);
+              continue;
+            }
+            ssize_t c[] = { ssize_t (std::floor (P[0])-1), ssize_t (std::floor (P[1])-1), ssize_t (std::floor (P[2])-1) };
+            size_t i (0);
+            for (ssize_t z = 0; z < 4; ++z) {
+              const ssize_t iz = clamp (c[2] + z, ImageType::size (2));
+              for (ssize_t y = 0; y < 4; ++y) {
+                const ssize_t iy = clamp (c[1] + y, ImageType::size (1));
+                for (ssize_t x = 0; x < 4; ++x)
+                  access.row (clamp (c[0] + x, ImageType::size (0)), iy, iz, coeff_matrix.col (i++));
+              }
+            }
+            rows.col (j) = coeff_matrix * weights_vec;
+          }
+          Base<ImageType>::set_out_of_bounds (true);
+        }
     };
 
 
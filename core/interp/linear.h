@@ -245,8 +245,136 @@ namespace MR
           return coeff_matrix * factors;
         }
 
+        //! Read interpolated values at a block of <b>voxel space</b> positions
+        /*! \a positions should be a 3xN matrix holding one position per
+         * column; on return, \a values holds the N interpolated values (with
+         * the out-of-bounds value for positions outside of the image), taken
+         * at the current position along the remaining axes.
+         *
+         * Points are processed in blocks: the interpolation weights are
+         * computed for all points of the block at once, the image
+         * intensities are then gathered (directly from memory where the image
+         * allows it), and the weighted sums evaluated across the whole block.
+         * On return, the interpolator is left in the out-of-bounds state. */
+        template <class PositionsType, class ValuesType>
+        FORCE_INLINE void voxel_values (const PositionsType& positions, ValuesType& values) {
+          block_values (positions, values, transform_type::Identity());
+        }
+
+        //! Read interpolated values at a block of <b>scanner space</b> positions
+        /*! See voxel_values() for details. */
+        template <class PositionsType, class ValuesType>
+        FORCE_INLINE void scanner_values (const PositionsType& positions, ValuesType& values) {
+          block_values (positions, values, Transform::scanner2voxel);
+        }
+
+        //! Read interpolated rows along axis 3 at a block of <b>voxel space</b> positions
+        /*! \a positions should be a 3xN matrix holding one position per
+         * column; on return, column j of \a rows holds the interpolated
+         * values of all volumes at position j. See voxel_values() for
+         * details. */
+        template <class PositionsType, class RowsType>
+        FORCE_INLINE void voxel_rows (const PositionsType& positions, RowsType& rows) {
+          block_rows (positions, rows, transform_type::Identity());
+        }
+
+        //! Read interpolated rows along axis 3 at a block of <b>scanner space</b> positions
+        /*! See voxel_rows() for details. */
+        template <class PositionsType, class RowsType>
+        FORCE_INLINE void scanner_rows (const PositionsType& positions, RowsType& rows) {
+          block_rows (positions, rows, Transform::scanner2voxel);
+        }
+
       protected:
         Eigen::Matrix<coef_type, 8, 1> factors;
+
+        template <class PositionsType, class ValuesType>
+        void block_values (const PositionsType& positions, ValuesType& values, const transform_type& to_voxel) {
+          const ssize_t num = positions.cols();
+          values.resize (num);
+          const ssize_t block = std::min (num, ssize_t(256));
+          VoxelAccess<ImageType> access (*this);
+          const ssize_t dim[] = { ImageType::size (0), ImageType::size (1), ImageType::size (2) };
+          Eigen::Matrix<default_type, 3, Eigen::Dynamic> pos (3, block);
+          Eigen::Array<default_type, 3, Eigen::Dynamic> corner (3, block), frac (3, block);
+          Eigen::Array<coef_type, 6, Eigen::Dynamic> axis_weights (6, block);
+          Eigen::Array<coef_type, 8, Eigen::Dynamic> weights (8, block);
+          Eigen::Array<value_type, 8, Eigen::Dynamic> coeffs (8, block);
+          Eigen::Array<value_type, 1, Eigen::Dynamic> sums (block);
+
+          for (ssize_t start = 0; start < num; start += block) {
+            const ssize_t n = std::min (block, num - start);
+            pos.leftCols (n) = to_voxel * positions.middleCols (start, n).template cast<default_type>();
+
+            // Weights for the whole block, as computed in voxel()
+            corner.leftCols (n) = pos.leftCols (n).array().floor();
+            frac.leftCols (n) = pos.leftCols (n).array() - corner.leftCols (n);
+            for (size_t axis = 0; axis != 3; ++axis) {
+              frac.row (axis).head (n) = (pos.row (axis).head (n).array() < 0.0 || pos.row (axis).head (n).array() > bounds[axis]-0.5).select (0.0, frac.row (axis).head (n));
+              axis_weights.row (2*axis).head (n) = (1.0 - frac.row (axis).head (n)).template cast<coef_type>();
+              axis_weights.row (2*axis+1).head (n) = frac.row (axis).head (n).template cast<coef_type>();
+            }
+            size_t i (0);
+            for (ssize_t z = 0; z < 2; ++z) {
+              for (ssize_t y = 0; y < 2; ++y) {
+                for (ssize_t x = 0; x < 2; ++x)
+                  weights.row (i++).head (n) = axis_weights.row (x).head (n) * (axis_weights.row (2+y).head (n) * axis_weights.row (4+z).head (n));
+              }
+            }
+            weights.leftCols (n) = (weights.leftCols (n) < eps).select (coef_type (0), weights.leftCols (n));
+
+            for (ssize_t j = 0; j < n; ++j) {
+              if (Base<ImageType>::set_out_of_bounds (pos.col (j))) {
+                // yields exactly the out-of-bounds value in the weighted sum
+                coeffs.col (j).setZero();
+                weights.col (j).setZero();
+                coeffs (0, j) = Base<ImageType>::out_of_bounds_value;
+                weights (0, j) = coef_type (1);
+                continue;
+              }
+              ssize_t ix[2], iy[2], iz[2];
+              for (ssize_t a = 0; a < 2; ++a) {
+                ix[a] = clamp (ssize_t (corner (0, j)) + a, dim[0]);
+                iy[a] = clamp (ssize_t (corner (1, j)) + a, dim[1]);
+                iz[a] = clamp (ssize_t (corner (2, j)) + a, dim[2]);
+              }
+              access.neighbourhood (ix, iy, iz, coeffs.col (j));
+            }
+
+            sums.head (n) = (coeffs.leftCols (n) * weights.leftCols (n)).colwise().sum();
+            for (ssize_t j = 0; j < n; ++j)
+              values[start + j] = sums[j];
+          }
+          Base<ImageType>::set_out_of_bounds (true);
+        }
+
+        template <class PositionsType, class RowsType>
+        void block_rows (const PositionsType& positions, RowsType& rows, const transform_type& to_voxel) {
+          assert (ImageType::ndim() == 4);
+          const ssize_t num = positions.cols();
+          rows.resize (ImageType::size(3), num);
+          VoxelAccess<ImageType> access (*this);
+          Eigen::Matrix<value_type, Eigen::Dynamic, 8> coeff_matrix (ImageType::size(3), 8);
+
+          for (ssize_t j = 0; j < num; ++j) {
+            if (!voxel (Eigen::Vector3 (to_voxel * positions.col (j).template cast<default_type>()))) {
+              rows.col (j).fill (Base<ImageType>::out_of_bounds_value);
+              continue;
+            }
+            ssize_t c[] = { ssize_t (std::floor (P[0])), ssize_t (std::floor (P[1])), ssize_t (std::floor (P[2])) };
+            size_t i (0);
+            for (ssize_t z = 0; z < 2; ++z) {
+              const ssize_t iz = clamp (c[2] + z, ImageType::size (2));
+              for (ssize_t y = 0; y < 2; ++y) {
+                const ssize_t iy = clamp (c[1] + y, ImageType::size (1));
+                for (ssize_t x = 0; x < 2; ++x)
+                  access.row (clamp (c[0] + x, ImageType::size (0)), iy, iz, coeff_matrix.col (i++));
+              }
+            }
+            rows.col (j) = coeff_matrix * factors;
+          }
+          Base<ImageType>::set_out_of_bounds (true);
+        }
     };
 
 
@@ -125,6 +125,46 @@ namespace MR
           return ImageType::row(axis);
         }
 
+        //! Read image values at a block of <b>voxel space</b> positions
+        /*! \a positions should be a 3xN matrix holding one position per
+         * column; on return, \a values holds the N corresponding image values
+         * (with the out-of-bounds value for positions outside of the image),
+         * taken at the current position along the remaining axes. Values are
+         * read directly from memory where the image allows it. On return,
+         * the interpolator is left in the out-of-bounds state. */
+        template <class PositionsType, class ValuesType>
+        FORCE_INLINE void voxel_values (const PositionsType& positions, ValuesType& values) {
+          block_values (positions, values, transform_type::Identity());
+        }
+
+        //! Read image values at a block of <b>scanner space</b> positions
+        /*! See voxel_values() for details. */
+        template <class PositionsType, class ValuesType>
+        FORCE_INLINE void scanner_values (const PositionsType& positions, ValuesType& values) {
+          block_values (positions, values, Transform::scanner2voxel);
+        }
+
+      protected:
+        template <class PositionsType, class ValuesType>
+        void block_values (const PositionsType& positions, ValuesType& values, const transform_type& to_voxel) {
+          const ssize_t num = positions.cols();
+          values.resize (num);
+          const ssize_t block = std::min (num, ssize_t(256));
+          VoxelAccess<ImageType> access (*this);
+          Eigen::Matrix<default_type, 3, Eigen::Dynamic> pos (3, block);
+          for (ssize_t start = 0; start < num; start += block) {
+            const ssize_t n = std::min (block, num - start);
+            pos.leftCols (n) = to_voxel * positions.middleCols (start, n).template cast<default_type>();
+            for (ssize_t j = 0; j < n; ++j) {
+              if (Base<ImageType>::set_out_of_bounds (pos.col (j)))
+                values[start + j] = out_of_bounds_value;
+              else
+                values[start + j] = access.value (std::round (pos (0, j)), std::round (pos (1, j)), std::round (pos (2, j)));
+            }
+          }
+          out_of_bounds = true;
+        }
+
     };
 
 
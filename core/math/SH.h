@@ -505,6 +505,49 @@ namespace MR
 
 
 
+      //! \cond skip
+      // Single Gauss-Newton update of \a unit_dir, given the derivatives of
+      //   the SH series at that direction; returns the size of the step taken
+      template <class UnitVectorType, typename ValueType>
+        inline ValueType __peak_step (
+            UnitVectorType& unit_dir,
+            const ValueType el,
+            const ValueType az,
+            const ValueType dSH_del,
+            const ValueType dSH_daz,
+            const ValueType d2SH_del2,
+            const ValueType d2SH_deldaz,
+            const ValueType d2SH_daz2)
+        {
+          ValueType del = sqrt (dSH_del*dSH_del + dSH_daz*dSH_daz);
+          ValueType daz = 0.0;
+          if (del != 0.0) {
+            daz = dSH_daz/del;
+            del = dSH_del/del;
+          }
+
+
+          ValueType dSH_dt = daz*dSH_daz + del*dSH_del;
+          ValueType d2SH_dt2 = daz*daz*d2SH_daz2 + 2.0*daz*del*d2SH_deldaz + del*del*d2SH_del2;
+          ValueType dt = d2SH_dt2 ? (-dSH_dt / d2SH_dt2) : 0.0;
+
+          if (dt < 0.0) dt = -dt;
+          if (dt > MAX_DIR_CHANGE) dt = MAX_DIR_CHANGE;
+
+          del *= dt;
+          daz *= dt;
+
+          unit_dir[0] += del*std::cos (az) *std::cos (el) - daz*std::sin (az);
+          unit_dir[1] += del*std::sin (az) *std::cos (el) + daz*std::cos (az);
+          unit_dir[2] -= del*std::sin (el);
+          unit_dir.normalize();
+
+          return dt;
+        }
+      //! \endcond
+
+
+
       //! estimate direction & amplitude of SH peak
       /*! find a peak of an SH series using Gauss-Newton optimisation, modified
        * to operate directly in spherical coordinates. The initial search
@@ -526,30 +569,7 @@ namespace MR
             value_type amplitude, dSH_del, dSH_daz, d2SH_del2, d2SH_deldaz, d2SH_daz2;
             derivatives (sh, lmax, el, az, amplitude, dSH_del, dSH_daz, d2SH_del2, d2SH_deldaz, d2SH_daz2, precomputer);
 
-            value_type del = sqrt (dSH_del*dSH_del + dSH_daz*dSH_daz);
-            value_type daz = 0.0;
-            if (del != 0.0) {
-              daz = dSH_daz/del;
-              del = dSH_del/del;
-            }
-
-
-            value_type dSH_dt = daz*dSH_daz + del*dSH_del;
-            value_type d2SH_dt2 = daz*daz*d2SH_daz2 + 2.0*daz*del*d2SH_deldaz + del*del*d2SH_del2;
-            value_type dt = d2SH_dt2 ? (-dSH_dt / d2SH_dt2) : 0.0;
-
-            if (dt < 0.0) dt = -dt;
-            if (dt > MAX_DIR_CHANGE) dt = MAX_DIR_CHANGE;
-
-            del *= dt;
-            daz *= dt;
-
-            unit_init_dir[0] += del*std::cos (az) *std::cos (el) - daz*std::sin (az);
-            unit_init_dir[1] += del*std::sin (az) *std::cos (el) + daz*std::cos (az);
-            unit_init_dir[2] -= del*std::sin (el);
-            unit_init_dir.normalize();
-
-            if (dt < ANGLE_TOLERANCE)
+            if (__peak_step (unit_init_dir, el, az, dSH_del, dSH_daz, d2SH_del2, d2SH_deldaz, d2SH_daz2) < ANGLE_TOLERANCE)
               return amplitude;
           }
 
@@ -648,6 +668,161 @@ namespace MR
 
 
 
+      //! find the peaks of SH series from a fixed set of seed directions
+      /*! The amplitude of the SH basis, and its first and second derivatives
+       * in spherical coordinates, are precomputed for each seed direction.
+       * The first Gauss-Newton iteration from every seed is therefore obtained
+       * as a single matrix-vector product with the SH coefficients, and
+       * subsequent iterations proceed as in get_peak().
+       *
+       * When searching from all seeds at once (operator()), the seeds are
+       * processed in order, and the search from any seed that comes within
+       * \a dot_threshold of a peak already located from an earlier seed is
+       * abandoned, since it would converge onto the same peak.
+       *
+       * The precomputed amplitudes along the seed directions are also
+       * available via SH2A(), for use where the SH series needs to be sampled
+       * over the same set of directions. */
+      template <typename ValueType> class PeakFinder
+      { MEMALIGN(PeakFinder<ValueType>)
+        public:
+          using value_type = ValueType;
+          using matrix_type = Eigen::Matrix<value_type,Eigen::Dynamic,Eigen::Dynamic>;
+          using vector_type = Eigen::Matrix<value_type,Eigen::Dynamic,1>;
+          using dir_type = Eigen::Matrix<value_type,3,1>;
+
+          //! \a dirs holds the seed directions, with columns [ azimuth elevation ]
+          template <class MatrixType>
+            PeakFinder (const MatrixType& dirs, const int lmax, PrecomputedAL<value_type>* precomputer = nullptr) :
+                lmax (lmax),
+                seeds (dirs.rows()),
+                seed_el (dirs.rows()),
+                seed_az (dirs.rows()),
+                amplitudes (init_transform (dirs, lmax).template cast<value_type>()),
+                basis (6*dirs.rows(), NforL (lmax)),
+                precomputer (precomputer)
+            {
+              vector_type unit_coef = vector_type::Zero (NforL (lmax));
+              for (ssize_t i = 0; i != dirs.rows(); ++i) {
+                const value_type az = dirs (i,0), el = dirs (i,1);
+                seeds[i] = dir_type (std::cos (az) * std::sin (el), std::sin (az) * std::sin (el), std::cos (el));
+                // (elevation, azimuth) as evaluated within the Gauss-Newton search
+                seed_el[i] = std::acos (seeds[i][2]);
+                seed_az[i] = std::atan2 (seeds[i][1], seeds[i][0]);
+                for (ssize_t n = 0; n != unit_coef.size(); ++n) {
+                  unit_coef[n] = 1.0;
+                  derivatives (unit_coef, lmax, seed_el[i], seed_az[i],
+                      basis (6*i, n), basis (6*i+1, n), basis (6*i+2, n),
+                      basis (6*i+3, n), basis (6*i+4, n), basis (6*i+5, n),
+                      (PrecomputedAL<value_type>*) nullptr);
+                  unit_coef[n] = 0.0;
+                }
+              }
+            }
+
+          size_t size () const { return seeds.size(); }
+          const dir_type& seed (const size_t index) const { assert (index < size()); return seeds[index]; }
+
+          //! sample the SH series \a sh along all seed directions
+          template <class VectorType1, class VectorType2>
+            void SH2A (VectorType1& result, const VectorType2& sh) const {
+              result.noalias() = amplitudes * sh;
+            }
+
+          //! find the peak of \a sh nearest to seed direction \a index
+          /*! On return, \a unit_dir holds the direction of the peak, and its
+           * amplitude is returned; both are NaN if the search failed. */
+          template <class VectorType>
+            value_type get_peak (const VectorType& sh, const size_t index, dir_type& unit_dir) const
+            {
+              assert (index < size());
+              unit_dir = seeds[index];
+              const Eigen::Matrix<value_type,6,1> d = basis.template middleRows<6> (6*index) * sh;
+              if (__peak_step (unit_dir, seed_el[index], seed_az[index], d[1], d[2], d[3], d[4], d[5]) < ANGLE_TOLERANCE)
+                return d[0];
+              for (int i = 1; i < 50; ++i) {
+                value_type amplitude;
+                if (step (sh, unit_dir, amplitude))
+                  return amplitude;
+              }
+              unit_dir = { NaN, NaN, NaN };
+              DEBUG ("failed to find SH peak!");
+              return NaN;
+            }
+
+          //! find the peaks of \a sh from all seed directions
+          /*! On return, \a peak_dirs and \a peak_values hold the direction
+           * and amplitude of the peak found from each seed direction, or NaN
+           * if the search from that seed failed or was abandoned. The search
+           * from a seed is abandoned if its current direction lies within \a
+           * dot_threshold (absolute dot product) of a peak already found from
+           * a seed of lower index; the default value disables this. */
+          template <class VectorType>
+            void operator() (const VectorType& sh,
+                             vector<dir_type>& peak_dirs,
+                             vector_type& peak_values,
+                             const value_type dot_threshold = 1.0) const
+            {
+              peak_dirs = seeds;
+              peak_values = vector_type::Constant (size(), NaN);
+              const vector_type d = basis * sh;
+
+              for (size_t i = 0; i != size(); ++i) {
+                if (__peak_step (peak_dirs[i], seed_el[i], seed_az[i], d[6*i+1], d[6*i+2], d[6*i+3], d[6*i+4], d[6*i+5]) < ANGLE_TOLERANCE) {
+                  peak_values[i] = d[6*i];
+                  continue;
+                }
+                for (int iter = 1; iter < 50; ++iter) {
+                  if (is_redundant (i, peak_dirs, peak_values, dot_threshold))
+                    break;
+                  value_type amplitude;
+                  if (step (sh, peak_dirs[i], amplitude)) {
+                    peak_values[i] = amplitude;
+                    break;
+                  }
+                }
+                if (!std::isfinite (peak_values[i]))
+                  peak_dirs[i] = { NaN, NaN, NaN };
+              }
+            }
+
+        protected:
+          const int lmax;
+          vector<dir_type> seeds;
+          vector_type seed_el, seed_az;
+          // amplitude of the SH basis along each seed direction
+          matrix_type amplitudes;
+          // for each seed direction, 6 consecutive rows holding the SH basis for
+          //   the amplitude and its derivatives, as computed by derivatives()
+          matrix_type basis;
+          PrecomputedAL<value_type>* precomputer;
+
+          // one Gauss-Newton iteration from an arbitrary direction;
+          //   returns true if converged
+          template <class VectorType>
+            bool step (const VectorType& sh, dir_type& unit_dir, value_type& amplitude) const
+            {
+              const value_type az = std::atan2 (unit_dir[1], unit_dir[0]);
+              const value_type el = std::acos (unit_dir[2]);
+              value_type dSH_del, dSH_daz, d2SH_del2, d2SH_deldaz, d2SH_daz2;
+              derivatives (sh, lmax, el, az, amplitude, dSH_del, dSH_daz, d2SH_del2, d2SH_deldaz, d2SH_daz2, precomputer);
+              return __peak_step (unit_dir, el, az, dSH_del, dSH_daz, d2SH_del2, d2SH_deldaz, d2SH_daz2) < ANGLE_TOLERANCE;
+            }
+
+          bool is_redundant (const size_t index, const vector<dir_type>& peak_dirs, const vector_type& peak_values, const value_type dot_threshold) const
+          {
+            if (dot_threshold >= 1.0)
+              return false;
+            for (size_t i = 0; i != index; ++i) {
+              if (std::isfinite (peak_values[i]) && abs (peak_dirs[index].dot (peak_dirs[i])) > dot_threshold)
+                return true;
+            }
+            return false;
+          }
+      };
+
+
+
       //! a class to hold the coefficients for an apodised point-spread function.
       template <typename ValueType> class aPSF
       { MEMALIGN(aPSF<ValueType>)
@@ -214,6 +214,16 @@ namespace MR
 
 
 
+      //! solver for the constrained least-squares problem
+      /*! This uses an active-set approach, updating the Cholesky factor of
+       * the active constraints as constraints enter or leave the active set.
+       * The final solution is computed from a full factorisation of the
+       * final active set, and so does not depend on the path taken.
+       *
+       * The search can optionally be initialised from a previously
+       * determined active set (e.g. that of a neighbouring voxel, as
+       * returned by active_set()); this requires fewer iterations, but in
+       * rare cases can arrive at a different final active set. */
       template <typename ValueType>
         class Solver { MEMALIGN(Solver<ValueType>)
           public:
@@ -224,18 +234,51 @@ namespace MR
 
             Solver (const Problem<value_type>& problem) :
               P (problem),
+              L (matrix_type::Zero (P.B.rows(), P.B.rows())),
               BtB (P.chol_HtH.rows(), P.chol_HtH.cols()),
               B (P.B.rows(), P.B.cols()),
-              y_u (BtB.rows()),
+              y_u (P.chol_HtH.rows()),
               c (P.B.rows()),
               c_u (P.B.rows()),
               lambda (c.size()),
               lambda_prev (c.size()),
               l (lambda.size()),
-              active (lambda.size(), false) { }
+              active (lambda.size(), false),
+              rejected (lambda.size(), false),
+              num_active (0),
+              active_list (lambda.size()) { }
 
+            //! solve for vector \a b, starting from an empty active set
             size_t operator() (vector_type& x, const vector_type& b)
             {
+              std::fill (active.begin(), active.end(), false);
+              return solve (x, b);
+            }
+
+            //! solve for vector \a b, starting from the active set provided
+            size_t operator() (vector_type& x, const vector_type& b, const vector<bool>& initial_active_set)
+            {
+              assert (initial_active_set.size() == active.size());
+              active = initial_active_set;
+              return solve (x, b);
+            }
+
+            //! the active set at the solution obtained in the most recent call
+            const vector<bool>& active_set () const { return active; }
+
+            const Problem<value_type>& problem () const { return P; }
+
+          protected:
+            const Problem<value_type>& P;
+            matrix_type L, BtB, B;
+            vector_type y_u, c, c_u, lambda, lambda_prev, l;
+            vector<bool> active, rejected;
+            size_t num_active;
+            vector<size_t> active_list;
+
+
+            size_t solve (vector_type& x, const vector_type& b)
+            {
 #ifdef MRTRIX_ICLS_DEBUG
               std::ofstream l_stream ("l.txt");
               std::ofstream n_stream ("n.txt");
@@ -253,87 +296,67 @@ namespace MR
               // set all Lagrangian multipliers to zero:
               lambda.setZero();
               lambda_prev.setZero();
-              // set active set empty:
-              std::fill (active.begin(), active.end(), false);
+              // equality constraints are always active:
               if (num_eq > 0)
                 std::fill (active.begin() + num_ineq, active.end(), true);
 
+              // factorise initial active set (equality constraints first):
+              num_active = 0;
+              bool initial_inequalities = false;
+              for (size_t n = num_ineq; n < active.size(); ++n)
+                add_constraint (n);
+              for (size_t n = 0; n < num_ineq; ++n) {
+                if (active[n]) {
+                  active[n] = false;
+                  if (add_constraint (n))
+                    initial_inequalities = true;
+                }
+              }
+
               // initial estimate of constraint values:
               c = c_u;
 
               // initial estimate of solution:
               x = y_u;
 
+              // if initialised with a non-empty set of inequality constraints,
+              // obtain the corresponding dual feasible solution:
+              if (initial_inequalities) {
+                solve_active (x, num_ineq);
+                lambda_prev = lambda;
+                c = P.B * x;
+                if (P.t.size())
+                  c -= P.t;
+              }
+
               size_t min_c_index;
               size_t niter = 0;
-
-              while (c.head(num_ineq).minCoeff (&min_c_index) < -P.tol) {
-                bool active_set_changed = !active[min_c_index];
-                active[min_c_index] = true;
-
-                while (1) {
-                  // form submatrix of active constraints:
-                  size_t num_active = 0;
-                  for (size_t n = 0; n < active.size(); ++n) {
-                    if (active[n]) {
-                      B.row (num_active) = P.B.row (n);
-                      l[num_active] = -c_u[n];
-                      ++num_active;
-                    }
-                  }
-                  auto B_active = B.topRows (num_active);
-                  auto l_active = l.head (num_active);
-
-                  BtB.resize (num_active, num_active);
-                  // solve for l in B*B'l = -c_u by Cholesky decomposition:
-                  BtB.template triangularView<Eigen::Lower>() = B_active * B_active.transpose();
-                  BtB.diagonal().array() += P.lambda_min_norm;
-                  BtB.template selfadjointView<Eigen::Lower>().llt().solveInPlace (l_active);
-
-                  // update lambda values in full vector
-                  // and identify worst offender if any lambda < 0
-                  // by projection from previous onto feasible
-                  // subset (i.e. l>=0):
-                  value_type s_min = std::numeric_limits<value_type>::infinity();
-                  size_t s_min_index = 0;
-                  size_t a = 0;
-                  for (size_t n = 0; n < num_ineq; ++n) {
-                    if (active[n]) {
-                      if (l_active[a] < 0.0) {
-                        value_type s = lambda_prev[n] / (lambda_prev[n] - l_active[a]);
-                        if (s < s_min) {
-                          s_min = s;
-                          s_min_index = n;
-                        }
-                      }
-                      lambda[n] = l_active[a];
-                      ++a;
+              std::fill (rejected.begin(), rejected.end(), false);
+
+              while (most_violated (num_ineq, min_c_index)) {
+                bool active_set_changed = false;
+                if (!active[min_c_index]) {
+                  // a constraint linearly dependent on the active set can only
+                  // be added in place of one of the active constraints;
+                  // failing that, exclude it and try the next most violated
+                  if (!add_constraint (min_c_index)) {
+                    if (!remove_blocking_constraint (min_c_index, num_ineq)) {
+                      rejected[min_c_index] = true;
+                      continue;
                     }
-                    else
-                      lambda[n] = 0.0;
-                  }
-
-                  // if no lambda < 0, proceed:
-                  if (!std::isfinite (s_min)) {
-                    // update solution vector:
-                    x = y_u + B_active.transpose() * l_active;
-                    break;
+                    add_constraint (min_c_index);
                   }
-#ifdef MRTRIX_ICLS_DEBUG
-                  l_stream << lambda << "\n";
-#endif
-
-                  // remove worst offending lambda from active set,
-                  // and re-estimate remaining lambdas:
-                  if (active[s_min_index])
-                    active_set_changed = true;
-                  active[s_min_index] = false;
+                  active_set_changed = true;
                 }
 
+                if (solve_active (x, num_ineq))
+                  active_set_changed = true;
+                if (active_set_changed)
+                  std::fill (rejected.begin(), rejected.end(), false);
+
                 // store feasible subset of lambdas:
                 lambda_prev = lambda;
 
-
 #ifdef MRTRIX_ICLS_DEBUG
                 l_stream << lambda << "\n";
                 for (const auto& a : active)
@@ -351,18 +374,189 @@ namespace MR
                   c -= P.t;
               }
 
+              if (niter || initial_inequalities)
+                solve_final (x);
+
               // project back to unconditioned domain:
               P.chol_HtH.template triangularView<Eigen::Lower>().transpose().solveInPlace (x);
               return niter;
             }
 
-            const Problem<value_type>& problem () const { return P; }
 
-          protected:
-            const Problem<value_type>& P;
-            matrix_type BtB, B;
-            vector_type y_u, c, c_u, lambda, lambda_prev, l;
-            vector<bool> active;
+            // find the most violated constraint not previously rejected;
+            // returns false if no constraint is violated beyond tolerance
+            bool most_violated (const size_t num_ineq, size_t& index) const
+            {
+              value_type min_c = -P.tol;
+              bool found = false;
+              for (size_t n = 0; n < num_ineq; ++n) {
+                if (c[n] < min_c && !rejected[n]) {
+                  min_c = c[n];
+                  index = n;
+                  found = true;
+                }
+              }
+              return found;
+            }
+
+
+            // compute the solution for the final active set from a full
+            // Cholesky decomposition of its constraints in index order:
+            void solve_final (vector_type& x)
+            {
+              size_t num_final = 0;
+              for (size_t n = 0; n < active.size(); ++n) {
+                if (active[n]) {
+                  B.row (num_final) = P.B.row (n);
+                  l[num_final] = -c_u[n];
+                  ++num_final;
+                }
+              }
+              auto B_active = B.topRows (num_final);
+              auto l_active = l.head (num_final);
+
+              BtB.resize (num_final, num_final);
+              BtB.template triangularView<Eigen::Lower>() = B_active * B_active.transpose();
+              BtB.diagonal().array() += P.lambda_min_norm;
+              BtB.template selfadjointView<Eigen::Lower>().llt().solveInPlace (l_active);
+              x = y_u + B_active.transpose() * l_active;
+            }
+
+
+            // solve for the Lagrangian multipliers of the active set,
+            // removing constraints from the active set as required to keep
+            // all multipliers non-negative; returns true if any constraint
+            // was removed
+            bool solve_active (vector_type& x, const size_t num_ineq)
+            {
+              bool removed = false;
+              while (1) {
+                // solve for l in B*B'l = -c_u using current Cholesky factor:
+                auto l_active = l.head (num_active);
+                for (size_t a = 0; a < num_active; ++a)
+                  l_active[a] = -c_u[active_list[a]];
+                auto L_active = L.topLeftCorner (num_active, num_active);
+                L_active.template triangularView<Eigen::Lower>().solveInPlace (l_active);
+                L_active.template triangularView<Eigen::Lower>().transpose().solveInPlace (l_active);
+
+                // update lambda values in full vector
+                // and identify worst offender if any lambda < 0
+                // by projection from previous onto feasible
+                // subset (i.e. l>=0):
+                value_type s_min = std::numeric_limits<value_type>::infinity();
+                size_t s_min_index = 0;
+                lambda.head (num_ineq).setZero();
+                for (size_t a = 0; a < num_active; ++a) {
+                  const size_t n = active_list[a];
+                  if (n >= num_ineq)
+                    continue;
+                  if (l_active[a] < 0.0) {
+                    value_type s = lambda_prev[n] / (lambda_prev[n] - l_active[a]);
+                    if (s < s_min || (s == s_min && n < s_min_index)) {
+                      s_min = s;
+                      s_min_index = n;
+                    }
+                  }
+                  lambda[n] = l_active[a];
+                }
+
+                // if no lambda < 0, proceed:
+                if (!std::isfinite (s_min)) {
+                  // update solution vector:
+                  x = y_u + B.topRows (num_active).transpose() * l_active;
+                  return removed;
+                }
+
+                // remove worst offending lambda from active set,
+                // and re-estimate remaining lambdas:
+                remove_constraint (s_min_index);
+                removed = true;
+              }
+            }
+
+
+            // append constraint to active set, and extend Cholesky factor
+            // of B*B' (plus regularisation) accordingly; the constraint is
+            // not added if it is linearly dependent on those already active
+            bool add_constraint (const size_t n)
+            {
+              const size_t k = num_active;
+              B.row (k) = P.B.row (n);
+              auto new_row = L.row (k).head (k);
+              new_row.noalias() = (B.topRows (k) * B.row (k).transpose()).transpose();
+              L.topLeftCorner (k, k).template triangularView<Eigen::Lower>().solveInPlace (new_row.transpose());
+              const value_type diag = B.row (k).squaredNorm() + P.lambda_min_norm;
+              const value_type d2 = diag - new_row.squaredNorm();
+              if (!(d2 > 1.0e3 * std::numeric_limits<value_type>::epsilon() * diag))
+                return false;
+              L(k,k) = std::sqrt (d2);
+              active[n] = true;
+              active_list[k] = n;
+              ++num_active;
+              return true;
+            }
+
+
+            // for a constraint linearly dependent on the active set, remove
+            // the active inequality constraint whose multiplier would first
+            // reach zero as the new constraint is introduced (Goldfarb &
+            // Idnani, 1983); returns false if there is no such constraint
+            bool remove_blocking_constraint (const size_t n, const size_t num_ineq)
+            {
+              auto r = l.head (num_active);
+              r.noalias() = B.topRows (num_active) * P.B.row (n).transpose();
+              auto L_active = L.topLeftCorner (num_active, num_active);
+              L_active.template triangularView<Eigen::Lower>().solveInPlace (r);
+              L_active.template triangularView<Eigen::Lower>().transpose().solveInPlace (r);
+
+              value_type s_min = std::numeric_limits<value_type>::infinity();
+              size_t s_min_index = 0;
+              for (size_t a = 0; a < num_active; ++a) {
+                const size_t m = active_list[a];
+                if (m < num_ineq && r[a] > 0.0) {
+                  const value_type s = lambda[m] / r[a];
+                  if (s < s_min) {
+                    s_min = s;
+                    s_min_index = m;
+                  }
+                }
+              }
+              if (!std::isfinite (s_min))
+                return false;
+              remove_constraint (s_min_index);
+              return true;
+            }
+
+
+            // remove constraint from active set, and downdate Cholesky
+            // factor using Givens rotations:
+            void remove_constraint (const size_t n)
+            {
+              size_t k = 0;
+              while (active_list[k] != n)
+                ++k;
+              for (size_t i = k; i+1 < num_active; ++i) {
+                L.row (i).head (i+2) = L.row (i+1).head (i+2);
+                B.row (i) = B.row (i+1);
+                active_list[i] = active_list[i+1];
+              }
+              --num_active;
+              // rows k onwards now have one non-zero entry above the diagonal:
+              for (size_t j = k; j < num_active; ++j) {
+                const value_type a = L(j,j), b = L(j,j+1);
+                const value_type r = std::sqrt (a*a + b*b);
+                if (r > 0.0) {
+                  const value_type cs = a / r, sn = b / r;
+                  for (size_t i = j; i < num_active; ++i) {
+                    const value_type u = L(i,j), v = L(i,j+1);
+                    L(i,j) = cs*u + sn*v;
+                    L(i,j+1) = cs*v - sn*u;
+                  }
+                }
+                L(j,j+1) = 0.0;
+              }
+              active[n] = false;
+            }
         };
 
 
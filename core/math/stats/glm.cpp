@@ -542,10 +542,10 @@ namespace MR
 
 
 
-        void TestBase::operator() (const matrix_type& shuffling_matrix, matrix_type& output) const
+        void TestBase::operator() (const Shuffle& shuffle, matrix_type& output) const
         {
           matrix_type temp;
-          (*this) (shuffling_matrix, temp, output);
+          (*this) (shuffle, temp, output);
         }
 
 
@@ -577,15 +577,15 @@ namespace MR
 
 
 
-        void TestFixedHomoscedastic::operator() (const matrix_type& shuffling_matrix,
+        void TestFixedHomoscedastic::operator() (const Shuffle& shuffle,
                                                 matrix_type& stats,
                                                 matrix_type& zstats) const
         {
-          assert (size_t(shuffling_matrix.rows()) == num_inputs());
+          assert (shuffle.rows() == num_inputs());
           stats .resize (num_elements(), num_hypotheses());
           zstats.resize (num_elements(), num_hypotheses());
 
-          matrix_type Sy, lambdas, residuals, beta;
+          matrix_type Rzy, Sy, lambdas, residuals, beta;
           vector_type sse;
 
           // Freedman-Lane for fixed design matrix case
@@ -596,14 +596,14 @@ namespace MR
             // In Freedman-Lane, the initial 'effective' regression against the nuisance
             //   variables, and permutation of the data, are done in a single step
 #ifdef GLM_TEST_DEBUG
-            VAR (shuffling_matrix.rows());
-            VAR (shuffling_matrix.cols());
+            VAR (shuffle.rows());
             VAR (partitions[ih].Rz.rows());
             VAR (partitions[ih].Rz.cols());
             VAR (y.rows());
             VAR (y.cols());
 #endif
-            Sy.noalias() = shuffling_matrix * partitions[ih].Rz * y;
+            Rzy.noalias() = partitions[ih].Rz * y;
+            shuffle.apply (Rzy, Sy);
 #ifdef GLM_TEST_DEBUG
             VAR (Sy.rows());
             VAR (Sy.cols());
@@ -702,22 +702,23 @@ namespace MR
 
 
 
-        void TestFixedHeteroscedastic::operator() (const matrix_type& shuffling_matrix, matrix_type& stats, matrix_type& zstats) const
+        void TestFixedHeteroscedastic::operator() (const Shuffle& shuffle, matrix_type& stats, matrix_type& zstats) const
         {
-          assert (size_t(shuffling_matrix.rows()) == num_inputs());
+          assert (shuffle.rows() == num_inputs());
           stats.resize (num_elements(), num_hypotheses());
           zstats.resize (num_elements(), num_hypotheses());
 
-          matrix_type Sy, lambdas;
+          matrix_type Rzy, Sy, lambdas;
           Eigen::Array<default_type, Eigen::Dynamic, Eigen::Dynamic> sq_residuals, sse, Wterms;
           Eigen::Matrix<default_type, Eigen::Dynamic, 1> W (num_inputs());
 #ifdef GLM_TEST_DEBUG
-          VAR (shuffling_matrix);
+          VAR (shuffle.matrix());
 #endif
 
           for (size_t ih = 0; ih != c.size(); ++ih) {
             // First two steps are identical to the homoscedastic case
-            Sy.noalias() = shuffling_matrix * partitions[ih].Rz * y;
+            Rzy.noalias() = partitions[ih].Rz * y;
+            shuffle.apply (Rzy, Sy);
 #ifdef GLM_TEST_DEBUG
             VAR (Sy);
 #endif
@@ -843,7 +844,7 @@ namespace MR
 
 
 
-        void TestVariableHomoscedastic::operator() (const matrix_type& shuffling_matrix,
+        void TestVariableHomoscedastic::operator() (const Shuffle& shuffle,
                                                     matrix_type& stats,
                                                     matrix_type& zstats) const
         {
@@ -853,8 +854,9 @@ namespace MR
           matrix_type dof (num_elements(), num_hypotheses());
           matrix_type extra_column_data (num_inputs(), importers.size());
           BitSet element_mask (num_inputs());
-          matrix_type shuffling_matrix_masked, Mfull_masked, pinvMfull_masked, Rm;
-          vector_type y_masked, Sy, lambda;
+          Shuffle shuffle_masked;
+          matrix_type Mfull_masked, pinvMfull_masked, Rm;
+          vector_type y_masked, Rzy, Sy, lambda;
           matrix_type XtX, beta;
 
           // Let's loop over elements first, then hypotheses in the inner loop
@@ -898,10 +900,10 @@ namespace MR
             } else {
               apply_mask (element_mask,
                           y.col (ie),
-                          shuffling_matrix,
+                          shuffle,
                           extra_column_data,
                           Mfull_masked,
-                          shuffling_matrix_masked,
+                          shuffle_masked,
                           y_masked);
               assert (Mfull_masked.allFinite());
 
@@ -935,7 +937,8 @@ namespace MR
                     // Now that we have the individual hypothesis model partition for these data,
                     //   the rest of this function should proceed similarly to the fixed
                     //   design matrix case
-                    Sy = shuffling_matrix_masked * partition.Rz * y_masked.matrix();
+                    Rzy = partition.Rz * y_masked.matrix();
+                    shuffle_masked.apply (Rzy, Sy);
                     lambda = pinvMfull_masked * Sy.matrix();
                     beta.noalias() = c[ih].matrix() * lambda.matrix();
                     const default_type sse = (Rm*Sy.matrix()).squaredNorm();
@@ -1002,10 +1005,10 @@ namespace MR
 
         void TestVariableHomoscedastic::apply_mask (const BitSet& mask,
                                                     matrix_type::ConstColXpr data,
-                                                    const matrix_type& shuffling_matrix,
+                                                    const Shuffle& shuffle,
                                                     const matrix_type& extra_column_data,
                                                     matrix_type& Mfull_masked,
-                                                    matrix_type& shuffling_matrix_masked,
+                                                    Shuffle& shuffle_masked,
                                                     vector_type& data_masked) const
         {
           const size_t finite_count = mask.count();
@@ -1016,48 +1019,38 @@ namespace MR
             Mfull_masked.resize (num_inputs(), num_factors());
             Mfull_masked.block (0, 0, num_inputs(), M.cols()) = M;
             Mfull_masked.block (0, M.cols(), num_inputs(), extra_column_data.cols()) = extra_column_data;
-            shuffling_matrix_masked = shuffling_matrix;
+            shuffle_masked = shuffle;
             data_masked = data;
 
           } else {
 
             Mfull_masked.resize (finite_count, num_factors());
             data_masked.resize (finite_count);
-            BitSet perm_matrix_mask (num_inputs(), true);
+            // Index of each retained input within the masked data
+            index_array_type masked_index (num_inputs());
             size_t out_index = 0;
             for (size_t in_index = 0; in_index != num_inputs(); ++in_index) {
               if (mask[in_index]) {
                 Mfull_masked.block (out_index, 0, 1, M.cols()) = M.row (in_index);
                 Mfull_masked.block (out_index, M.cols(), 1, extra_column_data.cols()) = extra_column_data.row (in_index);
+                masked_index[in_index] = out_index;
                 data_masked[out_index++] = data[in_index];
-              } else {
-                // Any row in the permutation matrix that contains a non-zero entry
-                //   in the column corresponding to in_row needs to be removed
-                //   from the permutation matrix
-                for (ssize_t perm_row = 0; perm_row != shuffling_matrix.rows(); ++perm_row) {
-                  if (shuffling_matrix (perm_row, in_index))
-                    perm_matrix_mask[perm_row] = false;
-                }
               }
             }
             assert (out_index == finite_count);
-            assert (perm_matrix_mask.count() == finite_count);
             assert (data_masked.allFinite());
-            // Only after we've reduced the design matrix do we now reduce the shuffling matrix
-            // Step 1: Remove rows that contain non-zero entries in columns to be removed
-            matrix_type temp (finite_count, num_inputs());
+            // Any row of the shuffle that draws from an input to be removed
+            //   is itself removed; the remaining rows draw from the
+            //   corresponding inputs within the masked data
+            shuffle_masked.index = shuffle.index;
+            shuffle_masked.permutation.resize (finite_count);
+            shuffle_masked.signs.resize (finite_count);
             out_index = 0;
             for (size_t in_index = 0; in_index != num_inputs(); ++in_index) {
-              if (perm_matrix_mask[in_index])
-                temp.row (out_index++) = shuffling_matrix.row (in_index);
-            }
-            assert (out_index == finite_count);
-            // Step 2: Remove columns
-            shuffling_matrix_masked.resize (finite_count, finite_count);
-            out_index = 0;
-            for (size_t in_index = 0; in_index != num_inputs(); ++in_index) {
-              if (mask[in_index])
-                shuffling_matrix_masked.col (out_index++) = temp.col (in_index);
+              if (mask[shuffle.permutation[in_index]]) {
+                shuffle_masked.permutation[out_index] = masked_index[shuffle.permutation[in_index]];
+                shuffle_masked.signs[out_index++] = shuffle.signs[in_index];
+              }
             }
             assert (out_index == finite_count);
           }
@@ -1096,17 +1089,18 @@ namespace MR
 
 
 
-        void TestVariableHeteroscedastic::operator() (const matrix_type& shuffling_matrix, matrix_type& stats, matrix_type& zstats) const
+        void TestVariableHeteroscedastic::operator() (const Shuffle& shuffle, matrix_type& stats, matrix_type& zstats) const
         {
           stats.resize (num_elements(), num_hypotheses());
           zstats.resize (num_elements(), num_hypotheses());
 
           matrix_type extra_column_data (num_inputs(), importers.size());
           BitSet element_mask (num_inputs());
-          matrix_type Mfull_masked, shuffling_matrix_masked, pinvMfull_masked, Rm;
+          Shuffle shuffle_masked;
+          matrix_type Mfull_masked, pinvMfull_masked, Rm;
           Eigen::Matrix<default_type, Eigen::Dynamic, 1> W;
           index_array_type VG_masked, VG_counts;
-          vector_type y_masked, Sy, lambda, sq_residuals, sse, Rnn_sums, Wterms;
+          vector_type y_masked, Rzy, Sy, lambda, sq_residuals, sse, Rnn_sums, Wterms;
 
           for (ssize_t ie = 0; ie != y.cols(); ++ie) {
             // Common ground to the TestVariableHomoscedastic case
@@ -1120,10 +1114,10 @@ namespace MR
             } else {
               apply_mask (element_mask,
                           y.col (ie),
-                          shuffling_matrix,
+                          shuffle,
                           extra_column_data,
                           Mfull_masked,
-                          shuffling_matrix_masked,
+                          shuffle_masked,
                           y_masked);
               const default_type condition_number = Math::condition_number (Mfull_masked);
               if (!std::isfinite (condition_number) || condition_number > 1e5) {
@@ -1142,7 +1136,8 @@ namespace MR
 
                     // At this point the implementation diverges from the TestVariableHomoscedastic case,
                     //   more closely mimicing the TestFixedHeteroscedastic case
-                    Sy = shuffling_matrix_masked * partition.Rz * y_masked.matrix();
+                    Rzy = partition.Rz * y_masked.matrix();
+                    shuffle_masked.apply (Rzy, Sy);
                     lambda = pinvMfull_masked * Sy.matrix();
                     sq_residuals = (Rm*Sy.matrix()).array().square();
                     sse = vector_type::Zero (num_variance_groups());
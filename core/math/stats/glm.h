@@ -24,6 +24,7 @@
 #include "math/least_squares.h"
 #include "math/zstatistic.h"
 #include "math/stats/import.h"
+#include "math/stats/shuffle.h"
 #include "math/stats/typedefs.h"
 
 #include "misc/bitset.h"
@@ -227,20 +228,20 @@ namespace MR
             virtual ~TestBase() { }
 
             /*! Compute Z-statistics
-             * @param shuffling_matrix a matrix to permute / sign flip the residuals (for permutation testing)
+             * @param shuffle the permutation / sign flip to apply to the residuals (for permutation testing)
              * @param output the matrix containing the output statistics (one column per hypothesis)
              *
              * This version ignores the statistics values themselves, and only exports Z-statistics
              *   (as these are what is used for statistical enhancement)
              */
-            virtual void operator() (const matrix_type& shuffling_matrix, matrix_type& output) const;
+            virtual void operator() (const Shuffle& shuffle, matrix_type& output) const;
 
             /*! Compute the statistics, including conversion to Z-score
-             * @param shuffling_matrix a matrix to permute / sign flip the residuals (for permutation testing)
+             * @param shuffle the permutation / sign flip to apply to the residuals (for permutation testing)
              * @param stat the matrix containing the output statistics (one column per hypothesis)
              * @param zstat the matrix containing the Z-transformed statistics (one column per hypothesis)
              */
-            virtual void operator() (const matrix_type& shuffling_matrix, matrix_type& stat, matrix_type& zstat) const = 0;
+            virtual void operator() (const Shuffle& shuffle, matrix_type& stat, matrix_type& zstat) const = 0;
 
 
             size_t num_inputs () const { return M.rows(); }
@@ -283,11 +284,11 @@ namespace MR
                                     const vector<Hypothesis>& hypotheses);
 
             /*! Compute the statistics
-             * @param shuffling_matrix a matrix to permute / sign flip the residuals (for permutation testing)
+             * @param shuffle the permutation / sign flip to apply to the residuals (for permutation testing)
              * @param stats the vector containing the output statistics (one column per hypothesis)
              * @param zstats the vector containing the Z-transformed output statistics (one column per hypothesis)
              */
-            void operator() (const matrix_type& shuffling_matrix, matrix_type& stats, matrix_type& zstats) const override;
+            void operator() (const Shuffle& shuffle, matrix_type& stats, matrix_type& zstats) const override;
 
           protected:
             // New classes to store information relevant to Freedman-Lane implementation
@@ -329,11 +330,11 @@ namespace MR
             size_t num_variance_groups() const { return num_vgs; }
 
             /*! Compute the statistics
-             * @param shuffling_matrix a matrix to permute / sign flip the residuals (for permutation testing)
+             * @param shuffle the permutation / sign flip to apply to the residuals (for permutation testing)
              * @param stats the vector containing the output statistics (one column per hypothesis)
              * @param zstats the vector containing the Z-transformed output statistics (one column per hypothesis)
              */
-            void operator() (const matrix_type& shuffling_matrix, matrix_type& stats, matrix_type& zstats) const override;
+            void operator() (const Shuffle& shuffle, matrix_type& stats, matrix_type& zstats) const override;
 
           protected:
             // Variance group assignments
@@ -381,14 +382,14 @@ namespace MR
                                        const bool nans_in_columns);
 
             /*! Compute the statistics
-             * @param shuffling_matrix a matrix to permute / sign flip the residuals (for permutation testing)
+             * @param shuffle the permutation / sign flip to apply to the residuals (for permutation testing)
              * @param stat the vector containing the native output statistics (one column per hypothesis)
              * @param zstat the vector containing the Z-transformed output statistics (one column per hypothesis)
              *
              * In TestVariable* classes, this function additionally needs to import the
              * extra external data individually for each element tested.
              */
-            void operator() (const matrix_type& shuffling_matrix, matrix_type& stat, matrix_type& zstat) const override;
+            void operator() (const Shuffle& shuffle, matrix_type& stat, matrix_type& zstat) const override;
 
             size_t num_factors() const override { return M.cols() + importers.size(); }
 
@@ -399,10 +400,10 @@ namespace MR
             void get_mask (const size_t ie, BitSet&, const matrix_type& extra_columns) const;
             void apply_mask (const BitSet& mask,
                              matrix_type::ConstColXpr data,
-                             const matrix_type& shuffling_matrix,
+                             const Shuffle& shuffle,
                              const matrix_type& extra_column_data,
                              matrix_type& Mfull_masked,
-                             matrix_type& shuffling_matrix_masked,
+                             Shuffle& shuffle_masked,
                              vector_type& y_masked) const;
 
         };
@@ -436,14 +437,14 @@ namespace MR
                                          const bool nans_in_columns);
 
             /*! Compute the statistics
-             * @param shuffling_matrix a matrix to permute / sign flip the residuals (for permutation testing)
+             * @param shuffle the permutation / sign flip to apply to the residuals (for permutation testing)
              * @param stat the vector containing the native output statistics (one column per hypothesis)
              * @param zstat the vector containing the Z-transformed output statistics (one column per hypothesis)
              *
              * In TestVariable* classes, this function additionally needs to import the
              * extra external data individually for each element tested.
              */
-            void operator() (const matrix_type& shuffling_matrix, matrix_type& stat, matrix_type& zstat) const override;
+            void operator() (const Shuffle& shuffle, matrix_type& stat, matrix_type& zstat) const override;
 
             size_t num_factors() const override { return M.cols() + importers.size(); }
             size_t num_variance_groups() const { return num_vgs; }
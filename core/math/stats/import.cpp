@@ -16,6 +16,11 @@
 
 #include "math/stats/import.h"
 
+#include <atomic>
+#include <mutex>
+
+#include "thread.h"
+
 namespace MR
 {
   namespace Math
@@ -38,6 +43,57 @@ namespace MR
 
 
 
+      namespace
+      {
+        class Loader
+        { NOMEMALIGN
+          public:
+            Loader (const vector<std::shared_ptr<SubjectDataImportBase>>& files,
+                    matrix_type& data,
+                    std::atomic<size_t>& counter,
+                    ProgressBar& progress,
+                    std::mutex& mutex) :
+                files (files),
+                data (data),
+                counter (counter),
+                progress (progress),
+                mutex (mutex) { }
+            void execute() {
+              size_t index;
+              while ((index = counter++) < files.size()) {
+                (*files[index]) (data.row (index));
+                std::lock_guard<std::mutex> lock (mutex);
+                ++progress;
+              }
+            }
+          private:
+            const vector<std::shared_ptr<SubjectDataImportBase>>& files;
+            matrix_type& data;
+            std::atomic<size_t>& counter;
+            ProgressBar& progress;
+            std::mutex& mutex;
+        };
+      }
+
+
+
+      void CohortDataImport::load (matrix_type& data, const std::string& message) const
+      {
+        assert (data.rows() == ssize_t (size()));
+        if (!size())
+          return;
+        std::atomic<size_t> counter (0);
+        std::mutex mutex;
+        ProgressBar progress (message, size());
+        Loader loader (files, data, counter, progress, mutex);
+        const size_t num_threads = std::max (size_t(1), std::min (size(), Thread::threads_to_execute()));
+        auto threads = Thread::run (Thread::multi (loader, num_threads), "subject data import");
+        threads.wait();
+      }
+
+
+
+
       bool CohortDataImport::allFinite() const
       {
         // TESTME Should be possible to do this faster by populating matrix data
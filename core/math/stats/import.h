@@ -94,6 +94,16 @@ namespace MR
           template <class SubjectDataImport>
           void initialise (const std::string& listpath, const std::string& explicit_from_directory = "");
 
+          //! add the data for a single subject
+          void add (std::shared_ptr<SubjectDataImportBase> subject) { files.push_back (subject); }
+
+          /*!
+           * @param data the matrix into which the data from all subjects should be
+           * loaded, one row per subject; the data for different subjects are
+           * loaded concurrently using multiple threads
+           */
+          void load (matrix_type& data, const std::string& message) const;
+
           /*!
            * @param index for a particular element being tested (data will be acquired for
            * all subjects for that element)
@@ -19,9 +19,11 @@
 
 #include <algorithm>
 #include <random>
+#include <unordered_set>
 
 #include "math/factorial.h"
 #include "math/math.h"
+#include "math/rng.h"
 
 namespace MR
 {
@@ -90,8 +92,31 @@ namespace MR
 
 
 
+      Shuffle::Shuffle (const size_t rows) :
+          index (0),
+          permutation (rows),
+          signs (vector_type::Ones (rows))
+      {
+        for (size_t i = 0; i != rows; ++i)
+          permutation[i] = i;
+      }
+
+
+
+      matrix_type Shuffle::matrix() const
+      {
+        matrix_type result (matrix_type::Zero (rows(), rows()));
+        for (size_t i = 0; i != rows(); ++i)
+          result (i, permutation[i]) = signs[i];
+        return result;
+      }
+
+
+
+
       Shuffler::Shuffler (const size_t num_rows, const bool is_nonstationarity, const std::string msg) :
           rows (num_rows),
+          random_include_default (false),
           nshuffles (is_nonstationarity ? DEFAULT_NUMBER_SHUFFLES_NONSTATIONARITY : DEFAULT_NUMBER_SHUFFLES),
           counter (0)
       {
@@ -177,7 +202,9 @@ namespace MR
                           const index_array_type& eb_whole,
                           const std::string msg) :
           rows (num_rows),
-          nshuffles (num_shuffles)
+          random_include_default (false),
+          nshuffles (num_shuffles),
+          counter (0)
       {
         initialise (error_types, true, is_nonstationarity, eb_within, eb_whole);
         if (msg.size())
@@ -194,25 +221,29 @@ namespace MR
         if (counter >= nshuffles) {
           if (progress)
             progress.reset (nullptr);
-          output.data.resize (0, 0);
+          output.permutation.resize (0);
+          output.signs.resize (0);
           return false;
         }
-        // TESTME Think I need to adjust the signflips application based on the permutations
+        const bool is_default = random_include_default && !counter;
+        output.permutation.resize (rows);
         if (permutations.size()) {
-          output.data = matrix_type::Zero (rows, rows);
           for (size_t i = 0; i != rows; ++i)
-            output.data (i, permutations[counter][i]) = 1.0;
+            output.permutation[i] = permutations[counter][i];
+        } else if (permutation_seeds.size() && !is_default) {
+          const PermuteLabels labels = random_permutation (permutation_seeds[counter]);
+          for (size_t i = 0; i != rows; ++i)
+            output.permutation[i] = labels[i];
         } else {
-          output.data = matrix_type::Identity (rows, rows);
+          for (size_t i = 0; i != rows; ++i)
+            output.permutation[i] = i;
         }
-        if (signflips.size()) {
+        output.signs = vector_type::Ones (rows);
+        if (signflips.size() || (signflip_seeds.size() && !is_default)) {
+          const BitSet flips = signflips.size() ? signflips[counter] : random_signflip (signflip_seeds[counter]);
           for (size_t r = 0; r != rows; ++r) {
-            if (signflips[counter][r]) {
-              for (size_t c = 0; c != rows; ++c) {
-                if (output.data (r, c))
-                  output.data (r, c) *= -1.0;
-              }
-            }
+            if (flips[r])
+              output.signs[r] = -1.0;
           }
         }
         ++counter;
@@ -252,6 +283,12 @@ namespace MR
           assert (!eb_whole.minCoeff());
         }
 
+        if (eb_within.size())
+          blocks_within = indices2blocks (eb_within);
+        if (eb_whole.size())
+          blocks_whole = indices2blocks (eb_whole);
+        random_include_default = !is_nonstationarity;
+
         const bool ee = (error_types == error_t::EE || error_types == error_t::BOTH);
         const bool ise = (error_types == error_t::ISE || error_types == error_t::BOTH);
 
@@ -339,10 +376,10 @@ namespace MR
               // - Only include the default shuffling if this is the actual permutation testing;
               //   if we're doing nonstationarity correction, don't include the default
               // - Permit duplicates (specifically of permutations only) if an adequate number cannot be generated
-              generate_random_permutations (nshuffles, rows, eb_within, eb_whole, !is_nonstationarity, nshuffles > max_num_permutations);
+              generate_random_permutations (nshuffles, !is_nonstationarity, nshuffles > max_num_permutations);
             }
           } else if (nshuffles < max_shuffles) {
-            generate_random_permutations (nshuffles, rows, eb_within, eb_whole, !is_nonstationarity, false);
+            generate_random_permutations (nshuffles, !is_nonstationarity, false);
           } else {
             generate_all_permutations (rows, eb_within, eb_whole);
             assert (permutations.size() == max_shuffles);
@@ -364,10 +401,10 @@ namespace MR
               generate_all_signflips (rows, eb_whole);
               assert (signflips.size() == max_num_signflips);
             } else {
-              generate_random_signflips (nshuffles, rows, eb_whole, !is_nonstationarity, nshuffles > max_num_signflips);
+              generate_random_signflips (nshuffles, !is_nonstationarity, nshuffles > max_num_signflips);
             }
           } else if (nshuffles < max_shuffles) {
-            generate_random_signflips (nshuffles, rows, eb_whole, !is_nonstationarity, false);
+            generate_random_signflips (nshuffles, !is_nonstationarity, false);
           } else {
             generate_all_signflips (rows, eb_whole);
             assert (signflips.size() == max_shuffles);
@@ -414,106 +451,104 @@ namespace MR
 
 
 
-      bool Shuffler::is_duplicate (const PermuteLabels& v1, const PermuteLabels& v2) const
+      namespace
       {
-        assert (v1.size() == v2.size());
-        for (size_t i = 0; i < v1.size(); i++) {
-          if (v1[i] != v2[i])
-            return false;
+        // Hashes of generated shuffles are used to detect duplicates,
+        //   without having to retain or compare the full set of shuffles
+        size_t hash (const vector<size_t>& labels)
+        {
+          size_t result = 14695981039346656037ULL;
+          for (const auto i : labels)
+            result = (result ^ i) * 1099511628211ULL;
+          return result;
         }
-        return true;
-      }
-
-
 
-      bool Shuffler::is_duplicate (const PermuteLabels& perm) const
-      {
-        for (const auto& p : permutations) {
-          if (is_duplicate (perm, p))
-            return true;
+        size_t hash (const BitSet& flips)
+        {
+          size_t result = 14695981039346656037ULL;
+          for (size_t i = 0; i != flips.size(); ++i)
+            result = (result ^ size_t(flips[i])) * 1099511628211ULL;
+          return result;
         }
-        return false;
       }
 
 
 
       void Shuffler::generate_random_permutations (const size_t num_perms,
-                                                   const size_t num_rows,
-                                                   const index_array_type& eb_within,
-                                                   const index_array_type& eb_whole,
                                                    const bool include_default,
                                                    const bool permit_duplicates)
       {
         permutations.clear();
-        permutations.reserve (num_perms);
-
-        PermuteLabels default_labelling (num_rows);
-        for (size_t i = 0; i < num_rows; ++i)
-          default_labelling[i] = i;
+        permutation_seeds.clear();
+        permutation_seeds.reserve (num_perms);
 
+        std::unordered_set<size_t> hashes;
         size_t p = 0;
         if (include_default) {
-          permutations.push_back (default_labelling);
+          PermuteLabels default_labelling (rows);
+          for (size_t i = 0; i != rows; ++i)
+            default_labelling[i] = i;
+          hashes.insert (hash (default_labelling));
+          permutation_seeds.push_back (0);
           ++p;
         }
 
-        // Unrestricted exchangeability
-        if (!eb_within.size() && !eb_whole.size()) {
-          for (; p != num_perms; ++p) {
-            PermuteLabels permuted_labelling (default_labelling);
-            do {
-              std::random_shuffle (permuted_labelling.begin(), permuted_labelling.end());
-            } while (!permit_duplicates && is_duplicate (permuted_labelling));
-            permutations.push_back (permuted_labelling);
+        // Each permutation is generated from its own seed, such that it can be
+        //   regenerated on demand; the sequence of seeds is itself determined by
+        //   a seed that can be set using the MRTRIX_RNG_SEED environment variable
+        Math::RNG seeds;
+        for (; p != num_perms; ++p) {
+          seed_type seed = seeds();
+          if (!permit_duplicates) {
+            while (!hashes.insert (hash (random_permutation (seed))).second)
+              seed = seeds();
           }
-          return;
+          permutation_seeds.push_back (seed);
         }
+      }
+
+
+
+      Shuffler::PermuteLabels Shuffler::random_permutation (const seed_type seed) const
+      {
+        Math::RNG rng (seed);
+        PermuteLabels permuted_labelling (rows);
+        for (size_t i = 0; i != rows; ++i)
+          permuted_labelling[i] = i;
 
-        vector<vector<size_t>> blocks;
+        // Unrestricted exchangeability
+        if (!blocks_within.size() && !blocks_whole.size()) {
+          std::shuffle (permuted_labelling.begin(), permuted_labelling.end(), rng);
+          return permuted_labelling;
+        }
 
         // Within-block exchangeability
-        if (eb_within.size()) {
-          blocks = indices2blocks (eb_within);
-          PermuteLabels permuted_labelling (default_labelling);
-          for (; p != num_perms; ++p) {
-            do {
-              permuted_labelling = default_labelling;
-              // Random permutation within each block independently
-              for (size_t ib = 0; ib != blocks.size(); ++ib) {
-                vector<size_t> permuted_block (blocks[ib]);
-                std::random_shuffle (permuted_block.begin(), permuted_block.end());
-                for (size_t i = 0; i != permuted_block.size(); ++i)
-                  permuted_labelling[blocks[ib][i]] = permuted_block[i];
-              }
-            } while (!permit_duplicates && is_duplicate (permuted_labelling));
-            permutations.push_back (permuted_labelling);
+        if (blocks_within.size()) {
+          // Random permutation within each block independently
+          for (const auto& block : blocks_within) {
+            vector<size_t> permuted_block (block);
+            std::shuffle (permuted_block.begin(), permuted_block.end(), rng);
+            for (size_t i = 0; i != permuted_block.size(); ++i)
+              permuted_labelling[block[i]] = permuted_block[i];
           }
-          return;
+          return permuted_labelling;
         }
 
         // Whole-block exchangeability
-        blocks = indices2blocks (eb_whole);
-        const size_t num_blocks = blocks.size();
-        assert (!(num_rows % num_blocks));
-        const size_t block_size = num_rows / num_blocks;
-        PermuteLabels default_blocks (num_blocks);
+        // Randomly order a list corresponding to the block indices, and then
+        //   generate the full permutation label listing accordingly
+        const size_t num_blocks = blocks_whole.size();
+        assert (!(rows % num_blocks));
+        const size_t block_size = rows / num_blocks;
+        PermuteLabels permuted_blocks (num_blocks);
         for (size_t i = 0; i != num_blocks; ++i)
-          default_blocks[i] = i;
-        PermuteLabels permuted_labelling (default_labelling);
-        for (; p != num_perms; ++p) {
-          do {
-            // Randomly order a list corresponding to the block indices, and then
-            //   generate the full permutation label listing accordingly
-            PermuteLabels permuted_blocks (default_blocks);
-            std::random_shuffle (permuted_blocks.begin(), permuted_blocks.end());
-            for (size_t ib = 0; ib != num_blocks; ++ib) {
-              for (size_t i = 0; i != block_size; ++i)
-                permuted_labelling[blocks[ib][i]] = blocks[permuted_blocks[ib]][i];
-            }
-          } while (!permit_duplicates && is_duplicate (permuted_labelling));
-          permutations.push_back (permuted_labelling);
+          permuted_blocks[i] = i;
+        std::shuffle (permuted_blocks.begin(), permuted_blocks.end(), rng);
+        for (size_t ib = 0; ib != num_blocks; ++ib) {
+          for (size_t i = 0; i != block_size; ++i)
+            permuted_labelling[blocks_whole[ib][i]] = blocks_whole[permuted_blocks[ib]][i];
         }
-
+        return permuted_labelling;
       }
 
 
@@ -619,62 +654,55 @@ namespace MR
 
 
 
-      bool Shuffler::is_duplicate (const BitSet& sign) const
-      {
-        for (const auto& s : signflips) {
-          if (sign == s)
-            return true;
-        }
-        return false;
-      }
-
-
-
       void Shuffler::generate_random_signflips (const size_t num_signflips,
-                                                const size_t num_rows,
-                                                const index_array_type& block_indices,
                                                 const bool include_default,
                                                 const bool permit_duplicates)
       {
         signflips.clear();
-        signflips.reserve (num_signflips);
+        signflip_seeds.clear();
+        signflip_seeds.reserve (num_signflips);
+
+        std::unordered_set<size_t> hashes;
         size_t s = 0;
         if (include_default) {
-          BitSet default_labelling (num_rows, false);
-          signflips.push_back (default_labelling);
+          hashes.insert (hash (BitSet (rows, false)));
+          signflip_seeds.push_back (0);
           ++s;
         }
-        std::random_device rd;
-        std::mt19937 generator (rd());
-        std::uniform_int_distribution<> distribution (0, 1);
 
-        BitSet rows_to_flip (num_rows);
+        Math::RNG seeds;
+        for (; s != num_signflips; ++s) {
+          seed_type seed = seeds();
+          if (!permit_duplicates) {
+            while (!hashes.insert (hash (random_signflip (seed))).second)
+              seed = seeds();
+          }
+          signflip_seeds.push_back (seed);
+        }
+      }
+
+
+
+      BitSet Shuffler::random_signflip (const seed_type seed) const
+      {
+        Math::RNG rng (seed);
+        std::uniform_int_distribution<> distribution (0, 1);
+        BitSet rows_to_flip (rows);
 
         // Whole-block sign-flipping
-        if (block_indices.size()) {
-          const auto blocks = indices2blocks (block_indices);
-          for (; s != num_signflips; ++s) {
-            do {
-              for (size_t ib = 0; ib != blocks.size(); ++ib) {
-                const bool value = distribution (generator);
-                for (const auto i : blocks[ib])
-                  rows_to_flip[i] = value;
-              }
-            } while (!permit_duplicates && is_duplicate (rows_to_flip));
-            signflips.push_back (rows_to_flip);
+        if (blocks_whole.size()) {
+          for (const auto& block : blocks_whole) {
+            const bool value = distribution (rng);
+            for (const auto i : block)
+              rows_to_flip[i] = value;
           }
-          return;
+          return rows_to_flip;
         }
 
         // Unrestricted sign-flipping
-        for (; s != num_signflips; ++s) {
-          do {
-            // TODO Should be a faster mechanism for generating / storing random bits
-            for (size_t ir = 0; ir != num_rows; ++ir)
-              rows_to_flip[ir] = distribution (generator);
-          } while (!permit_duplicates && is_duplicate (rows_to_flip));
-          signflips.push_back (rows_to_flip);
-        }
+        for (size_t ir = 0; ir != rows; ++ir)
+          rows_to_flip[ir] = distribution (rng);
+        return rows_to_flip;
       }
 
 
@@ -18,6 +18,8 @@
 #ifndef __math_stats_shuffle_h__
 #define __math_stats_shuffle_h__
 
+#include <random>
+
 #include "app.h"
 #include "progressbar.h"
 #include "types.h"
@@ -51,11 +53,37 @@ namespace MR
 
 
 
+      // A single shuffle of the input data, stored in compact form:
+      //   row i of the shuffled data is row permutation[i] of the original
+      //   data, multiplied by signs[i]. This is equivalent to pre-multiplication
+      //   by a signed permutation matrix, but without having to construct or
+      //   multiply by a dense N x N matrix.
       class Shuffle
       { NOMEMALIGN
         public:
+          Shuffle () : index (0) { }
+          // Construct the identity (default) shuffle
+          Shuffle (const size_t rows);
+
           size_t index;
-          matrix_type data;
+          index_array_type permutation;
+          vector_type signs;
+
+          size_t rows() const { return permutation.size(); }
+
+          // Apply the shuffle to the rows of a matrix / vector;
+          //   input must be an evaluated matrix / array, not a product expression
+          template <class InputType, class OutputType>
+          void apply (const Eigen::DenseBase<InputType>& input, OutputType& output) const
+          {
+            assert (size_t(input.rows()) == rows());
+            output.resize (input.rows(), input.cols());
+            for (ssize_t i = 0; i != input.rows(); ++i)
+              output.row (i) = signs[i] * input.row (permutation[i]);
+          }
+
+          // Generate the equivalent dense shuffling matrix
+          matrix_type matrix() const;
       };
 
 
@@ -97,9 +125,17 @@ namespace MR
 
 
         private:
+          using seed_type = std::mt19937::result_type;
+
           const size_t rows;
+          // Shuffles that are either exhaustively generated or loaded from file are
+          //   stored explicitly; randomly generated shuffles are instead stored only as
+          //   the seed from which each can be deterministically regenerated as required
           vector<PermuteLabels> permutations;
           vector<BitSet> signflips;
+          vector<seed_type> permutation_seeds, signflip_seeds;
+          bool random_include_default;
+          vector<vector<size_t>> blocks_within, blocks_whole;
           size_t nshuffles, counter;
           std::unique_ptr<ProgressBar> progress;
 
@@ -116,17 +152,10 @@ namespace MR
           index_array_type load_blocks (const std::string& filename, const bool equal_sizes);
 
 
-          // For generating unique permutations
-          bool is_duplicate (const PermuteLabels&, const PermuteLabels&) const;
-          bool is_duplicate (const PermuteLabels&) const;
-
           // Note that this function does not take into account identical rows and therefore generated
           // permutations are not guaranteed to be unique wrt the computed test statistic.
           // Providing the number of rows is large then the likelihood of generating duplicates is low.
           void generate_random_permutations (const size_t num_perms,
-                                             const size_t num_rows,
-                                             const index_array_type& eb_within,
-                                             const index_array_type& eb_whole,
                                              const bool include_default,
                                              const bool permit_duplicates);
 
@@ -137,17 +166,16 @@ namespace MR
           void load_permutations (const std::string& filename);
 
           // Similar functions required for sign-flipping
-          bool is_duplicate (const BitSet&) const;
-
           void generate_random_signflips (const size_t num_signflips,
-                                          const size_t num_rows,
-                                          const index_array_type& blocks,
                                           const bool include_default,
                                           const bool permit_duplicates);
 
           void generate_all_signflips (const size_t num_rows,
                                        const index_array_type& blocks);
 
+          // Regenerate a random shuffle from its seed
+          PermuteLabels random_permutation (const seed_type seed) const;
+          BitSet random_signflip (const seed_type seed) const;
 
           vector<vector<size_t>> indices2blocks (const index_array_type&) const;
 
@@ -69,12 +69,33 @@ namespace MR
           }
         }
 
+        // Combine with statistics computed over a disjoint set of values
+        //   (Chan et al.'s parallel update for the mean and sum of squared deviations);
+        //   the values stored in other are moved into this instance, leaving it empty
+        void merge (Stats&& other) {
+          if (!other.count)
+            return;
+          min = complex_type (std::min (min.real(), other.min.real()), std::min (min.imag(), other.min.imag()));
+          max = complex_type (std::max (max.real(), other.max.real()), std::max (max.imag(), other.max.imag()));
+          const size_t total = count + other.count;
+          const value_type fraction = value_type (other.count) / value_type (total);
+          const complex_type diff = other.mean - mean;
+          mean += cdouble (diff.real() * fraction, diff.imag() * fraction);
+          m2 += other.m2 + cdouble (diff.real() * diff.real() * count * fraction, diff.imag() * diff.imag() * count * fraction);
+          count = total;
+          if (values.empty()) {
+            std::swap (values, other.values);
+          } else {
+            values.insert (values.end(), other.values.begin(), other.values.end());
+            vector<float>().swap (other.values);
+          }
+        }
+
         template <class ImageType> void print (ImageType& ima, const vector<std::string>& fields) {
 
           if (count > 1) {
             std = complex_type(sqrt (m2.real() / value_type (count - 1)), sqrt (m2.imag() / value_type (count - 1)));
             std_rv = complex_type(sqrt((m2.real() + m2.imag()) / value_type (count - 1)));
-            std::sort (values.begin(), values.end());
           }
           if (fields.size()) {
             if (!count) {
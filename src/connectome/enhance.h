@@ -70,6 +70,12 @@ namespace MR {
 
           void operator() (in_column_type, const value_type, out_column_type) const override;
 
+          bool operator() (in_column_type in, const vector<value_type>& heights, const value_type E, const value_type H, out_column_type out) const override {
+            Stats::TFCE::integrate_clusters (*adjacency, in, heights, E, H,
+                [] (const value_type stat, const value_type h) { return stat >= h; }, out);
+            return true;
+          }
+
         protected:
           std::shared_ptr< vector< vector<size_t> > > adjacency;
           value_type threshold;
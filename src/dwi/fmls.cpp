@@ -151,7 +151,7 @@ namespace MR {
           az_el_pairs (row, 0) = std::atan2 (d[1], d[0]);
           az_el_pairs (row, 1) = std::acos  (d[2]);
         }
-        transform.reset (new Math::SH::Transform<default_type> (az_el_pairs, lmax));
+        peak_finder.reset (new Math::SH::PeakFinder<default_type> (az_el_pairs, lmax, precomputer.get()));
         weights.reset (new IntegrationWeights (dirs));
       }
 
@@ -174,7 +174,7 @@ namespace MR {
           return true;
 
         Eigen::Matrix<default_type, Eigen::Dynamic, 1> values (dirs.size());
-        transform->SH2A (values, in);
+        peak_finder->SH2A (values, in);
 
         using map_type = std::multimap<default_type, index_type, Max_abs>;
 
@@ -264,8 +264,10 @@ namespace MR {
 
             // Revise multiple peaks if present
             for (size_t peak_index = 0; peak_index != i->num_peaks(); ++peak_index) {
-              Eigen::Vector3 newton_peak_dir = i->get_peak_dir (peak_index); // to be updated by subsequent Math::SH::get_peak() call
-              const default_type newton_peak_value = Math::SH::get_peak (in, lmax, newton_peak_dir, &(*precomputer));
+              // The first iteration from the original peak direction uses the
+              //   derivatives precomputed for that direction
+              Eigen::Vector3 newton_peak_dir;
+              const default_type newton_peak_value = peak_finder->get_peak (in, i->get_peak_bin (peak_index), newton_peak_dir);
               if (std::isfinite (newton_peak_value) && newton_peak_dir.allFinite()) {
 
                 // Ensure that the new peak direction found via Newton optimisation
@@ -69,6 +69,7 @@ namespace MR
               values (Eigen::Array<default_type, Eigen::Dynamic, 1>::Zero (dirs.size())),
               max_peak_value (abs (value)),
               peak_dirs (1, dirs.get_dir (seed)),
+              peak_bins (1, seed),
               mean_dir (peak_dirs.front() * abs(value) * weight),
               integral (abs (value * weight)),
               neg (value <= 0.0)
@@ -130,8 +131,10 @@ namespace MR
             if (that.max_peak_value > max_peak_value) {
               max_peak_value = that.max_peak_value;
               peak_dirs.insert (peak_dirs.begin(), that.peak_dirs.begin(), that.peak_dirs.end());
+              peak_bins.insert (peak_bins.begin(), that.peak_bins.begin(), that.peak_bins.end());
             } else {
               peak_dirs.insert (peak_dirs.end(), that.peak_dirs.begin(), that.peak_dirs.end());
+              peak_bins.insert (peak_bins.end(), that.peak_bins.begin(), that.peak_bins.end());
             }
             const default_type multiplier = (mean_dir.dot (that.mean_dir)) > 0.0 ? 1.0 : -1.0;
             mean_dir += that.mean_dir * that.integral * multiplier;
@@ -143,6 +146,8 @@ namespace MR
           default_type get_max_peak_value() const { return max_peak_value; }
           size_t num_peaks() const { return peak_dirs.size(); }
           const Eigen::Vector3& get_peak_dir (const size_t i) const { assert (i < num_peaks()); return peak_dirs[i]; }
+          // Direction from which this peak was originally identified (prior to any revision)
+          index_type get_peak_bin (const size_t i) const { assert (i < num_peaks()); return peak_bins[i]; }
           const Eigen::Vector3& get_mean_dir() const { return mean_dir; }
           default_type get_integral() const { return integral; }
           bool is_negative() const { return neg; }
@@ -153,6 +158,7 @@ namespace MR
           Eigen::Array<default_type, Eigen::Dynamic, 1> values;
           default_type max_peak_value;
           vector<Eigen::Vector3> peak_dirs;
+          vector<index_type> peak_bins;
           Eigen::Vector3 mean_dir;
           default_type integral;
           bool neg;
@@ -263,8 +269,8 @@ namespace MR
 
           const size_t lmax;
 
-          std::shared_ptr<Math::SH::Transform    <default_type>> transform;
           std::shared_ptr<Math::SH::PrecomputedAL<default_type>> precomputer;
+          std::shared_ptr<Math::SH::PeakFinder   <default_type>> peak_finder;
           std::shared_ptr<IntegrationWeights> weights;
 
           default_type integral_threshold;   // Integral of positive lobe must be at least this value
@@ -53,7 +53,12 @@ namespace MR
                 "the maximum number of iterations to perform for each voxel (default = " + str(DEFAULT_CSD_NITER) + "). "
                 // TODO Explicit SD algorithm?
                 "Use '-niter 0' for a linear unconstrained spherical deconvolution.")
-      + Argument ("number").type_integer (0, 1000);
+      + Argument ("number").type_integer (0, 1000)
+
+      + Option ("single_precision",
+                "perform the deconvolution using single-precision floating-point "
+                "arithmetic; this is faster, at the expense of small differences in "
+                "the resulting FOD coefficients.");
 
 
     }
@@ -17,6 +17,8 @@
 #ifndef __dwi_sdeconv_csd_h__
 #define __dwi_sdeconv_csd_h__
 
+#include <map>
+
 #include "app.h"
 #include "header.h"
 #include "dwi/gradient.h"
@@ -217,6 +219,9 @@ namespace MR
 
 
 
+        template <typename ValueType> class Batch;
+
+
         CSD (const Shared& shared_data) :
           shared (shared_data),
           work (shared.Mt_M.rows(), shared.Mt_M.cols()),
@@ -280,6 +285,127 @@ namespace MR
     };
 
 
+
+
+    // Perform CSD for multiple voxels simultaneously.
+    // Results are equivalent to those of the CSD class (up to floating-point
+    //   precision), but the computation is reorganised for throughput:
+    //   - the initial linear deconvolution and the evaluation of the FOD
+    //     amplitudes along the high-resolution constraint directions are
+    //     performed as matrix-matrix products across all voxels that have
+    //     not yet converged;
+    //   - the Cholesky decomposition for each unique set of negative
+    //     amplitudes is cached and re-used, since adjacent voxels
+    //     frequently converge to the same set.
+    // Setting ValueType to float performs these computations in single
+    //   precision.
+    template <typename ValueType>
+    class CSD::Batch { MEMALIGN(CSD::Batch<ValueType>)
+      public:
+        using value_type = ValueType;
+        using matrix_type = Eigen::Matrix<value_type, Eigen::Dynamic, Eigen::Dynamic>;
+        using solver_type = Eigen::LLT<matrix_type>;
+
+        Batch (const Shared& shared_data, const size_t max_cached = 256) :
+          shared (shared_data),
+          rconv (shared.rconv.cast<value_type>()),
+          HR_trans (shared.HR_trans.cast<value_type>()),
+          Mt (shared.M.transpose().cast<value_type>()),
+          Mt_M (shared.Mt_M.cast<value_type>()),
+          threshold (shared.threshold),
+          max_cached (max_cached) { }
+
+        Batch (const Batch& that) :
+          shared (that.shared),
+          rconv (that.rconv),
+          HR_trans (that.HR_trans),
+          Mt (that.Mt),
+          Mt_M (that.Mt_M),
+          threshold (that.threshold),
+          max_cached (that.max_cached) { }
+
+        // DW signals for each voxel are provided as the columns of the input
+        //   matrix; the FOD for each voxel is written to the corresponding
+        //   column of the output matrix
+        template <class MatrixType>
+          void operator() (const Eigen::MatrixBase<MatrixType>& DW_signals, matrix_type& FODs)
+          {
+            const ssize_t num_voxels = DW_signals.cols();
+            FODs.resize (HR_trans.cols(), num_voxels);
+            FODs.topRows (rconv.rows()).noalias() = rconv * DW_signals;
+            FODs.bottomRows (FODs.rows() - rconv.rows()).setZero();
+            Mt_b.noalias() = Mt * DW_signals;
+
+            old_neg.assign (num_voxels, vector<int> (1, -1));
+            active.resize (num_voxels);
+            for (ssize_t n = 0; n != num_voxels; ++n)
+              active[n] = n;
+
+            for (size_t iter = 0; iter != shared.niter && active.size(); ++iter) {
+              F_active.resize (FODs.rows(), active.size());
+              for (size_t n = 0; n != active.size(); ++n)
+                F_active.col (n) = FODs.col (active[n]);
+              HR_amps.noalias() = HR_trans * F_active;
+
+              size_t num_remaining = 0;
+              for (size_t n = 0; n != active.size(); ++n) {
+                const size_t voxel = active[n];
+                neg.clear();
+                for (ssize_t i = 0; i != HR_amps.rows(); ++i)
+                  if (HR_amps (i, n) < threshold)
+                    neg.push_back (i);
+                if (neg == old_neg[voxel])
+                  continue;
+                FODs.col (voxel).noalias() = get_solver (neg).solve (Mt_b.col (voxel));
+                std::swap (neg, old_neg[voxel]);
+                active[num_remaining++] = voxel;
+              }
+              active.resize (num_remaining);
+            }
+
+            // As with the CSD class, -niter 0 is not considered a failure to converge
+            if (!shared.niter)
+              active.clear();
+          }
+
+        // Indices of those voxels that did not reach full convergence
+        //   in the most recent invocation of operator()
+        const vector<size_t>& unconverged () const { return active; }
+
+        const Shared& shared;
+
+      protected:
+        const matrix_type rconv, HR_trans, Mt, Mt_M;
+        const value_type threshold;
+        const size_t max_cached;
+
+        matrix_type work, HR_T, Mt_b, F_active, HR_amps;
+        vector<int> neg;
+        vector<vector<int>> old_neg;
+        vector<size_t> active;
+        std::map<vector<int>, solver_type> cache;
+
+        const solver_type& get_solver (const vector<int>& negative)
+        {
+          auto it = cache.find (negative);
+          if (it != cache.end())
+            return it->second;
+          if (cache.size() >= max_cached)
+            cache.clear();
+
+          work.resize (Mt_M.rows(), Mt_M.cols());
+          work.template triangularView<Eigen::Lower>() = Mt_M.template triangularView<Eigen::Lower>();
+          if (negative.size()) {
+            HR_T.resize (negative.size(), HR_trans.cols());
+            for (size_t i = 0; i < negative.size(); i++)
+              HR_T.row (i) = HR_trans.row (negative[i]);
+            work.template triangularView<Eigen::Lower>() += HR_T.transpose() * HR_T;
+          }
+          return cache.emplace (negative, solver_type (work)).first->second;
+        }
+    };
+
+
     }
   }
 }
@@ -37,6 +37,11 @@ namespace MR
                 "non-negativity constraint (default = " + str(DEFAULT_MSMTCSD_NEG_LAMBDA, 2) + ").")
       + Argument ("value").type_float (0.0)
 
+      + Option ("warm_start",
+                "initialise the solver in each voxel from the active set found for the "
+                "neighbouring voxel processed previously. This reduces computation time, but "
+                "in rare cases the solver can then arrive at a slightly different solution.")
+
       + Option ("predicted_signal",
                 "output the predicted dwi image.")
       + Argument ("image").type_image_out();
@@ -51,7 +51,8 @@ namespace MR
                   shells (grad),
                   HR_dirs (DWI::Directions::electrostatic_repulsion_300()),
                   solution_min_norm_regularisation (DEFAULT_MSMTCSD_NORM_LAMBDA),
-                  constraint_min_norm_regularisation (DEFAULT_MSMTCSD_NEG_LAMBDA) { shells.select_shells(false,false,false); }
+                  constraint_min_norm_regularisation (DEFAULT_MSMTCSD_NEG_LAMBDA),
+                  warm_start (false) { shells.select_shells(false,false,false); }
 
 
               void parse_cmdline_options()
@@ -69,6 +70,7 @@ namespace MR
                 opt = get_options ("neg_lambda");
                 if (opt.size())
                   constraint_min_norm_regularisation = opt[0][0];
+                warm_start = get_options ("warm_start").size();
               }
 
 
@@ -230,6 +232,7 @@ namespace MR
               vector<std::string> response_files;
               Math::ICLS::Problem<double> problem;
               double solution_min_norm_regularisation, constraint_min_norm_regularisation;
+              bool warm_start;
 
 
             private:
@@ -268,6 +271,14 @@ namespace MR
             niter = solver (output, data);
           }
 
+          // Initialise the active set of the solver from that obtained
+          //   for a previous voxel (typically a neighbour)
+          void operator() (const Eigen::VectorXd& data, Eigen::VectorXd& output, const vector<bool>& initial_active_set) {
+            niter = solver (output, data, initial_active_set);
+          }
+
+          const vector<bool>& active_set () const { return solver.active_set(); }
+
           size_t niter;
           const Shared& shared;
 
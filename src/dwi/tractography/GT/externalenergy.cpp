@@ -17,6 +17,7 @@
 #include "dwi/tractography/GT/externalenergy.h"
 
 #include "algo/loop.h"
+#include "algo/threaded_copy.h"
 #include "dwi/gradient.h"
 #include "dwi/shells.h"
 #include "math/SH.h"
@@ -40,6 +41,12 @@ namespace MR {
           // Create images --------------------------------------------------------------
           Header header (dwimage);
           header.datatype() = DataType::Float32;
+          Stride::set (header, Stride::contiguous_along_axis (3, header));
+          if (!dwi.is_direct_io()) {
+            dwi = Image<float>::scratch(header, "DWI");
+            Image<float> in (dwimage);
+            threaded_copy(in, dwi);
+          }
           header.size(3) = ncols;
           tod = Image<float>::scratch(header, "TOD image");
 
@@ -52,10 +59,17 @@ namespace MR {
 
           header.ndim() = 3;
           eext = Image<float>::scratch(header, "external energy");
+          Header count_header (header);
+          count_header.datatype() = DataType::UInt16;
+          sig_updates = Image<uint16_t>::scratch(count_header, "predicted WM signal update count");
 
           // Set kernel matrices --------------------------------------------------------
           auto grad = DWI::get_DW_scheme(dwimage);
           nrows = grad.rows();
+
+          header.ndim() = 4;
+          header.size(3) = nrows;
+          sig = Image<float>::scratch(header, "predicted WM signal");
           DWI::Shells shells (grad);
 
           if (size_t(props.resp_WM.rows()) != shells.count())
@@ -101,11 +115,44 @@ namespace MR {
           }
           K *= props.weight;
 
+          // Response polynomials: for unit vectors g and u, K.row(r) * delta(u) is
+          //   the sum over even l of w_l * P_l(g.u), with g the gradient direction
+          //   of volume r, and w_l = K.row(r) * delta(g) restricted to band l.
+          //   Expanding each P_l in powers of x = g.u yields a polynomial in x^2.
+          Eigen::MatrixXd Pl = Eigen::MatrixXd::Zero(lmax+1, lmax+1);  // coefficient of x^j in P_l
+          Pl(0,0) = 1.0;
+          if (lmax > 0)
+            Pl(1,1) = 1.0;
+          for (int l = 2; l <= lmax; ++l) {
+            Pl.row(l).tail(lmax) = (double(2*l-1)/l) * Pl.row(l-1).head(lmax);
+            Pl.row(l) -= (double(l-1)/l) * Pl.row(l-2);
+          }
+          gx.resize(nrows); gy.resize(nrows); gz.resize(nrows);
+          poly = Eigen::ArrayXXd::Zero(nrows, lmax/2+1);
+          for (size_t r = 0; r < nrows; r++)
+          {
+            unit_dir << grad(r,0), grad(r,1), grad(r,2);
+            double n = unit_dir.norm();
+            if (n > 0.0)
+              unit_dir /= n;
+            else
+              unit_dir << 1.0, 0.0, 0.0;  // as assumed by Math::SH::delta() for a null vector
+            gx[r] = unit_dir[0]; gy[r] = unit_dir[1]; gz[r] = unit_dir[2];
+            Math::SH::delta(delta_vec, unit_dir, lmax);
+            for (int l = 0; l <= lmax; l+=2) {
+              const double w = K.row(r).segment(Math::SH::index(l,-l), 2*l+1).dot(delta_vec.segment(Math::SH::index(l,-l), 2*l+1));
+              for (int j = 0; j <= l; j+=2)
+                poly(r,j/2) += w * Pl(l,j);
+            }
+          }
+
           // Allocate temporary memory --------------------------------------------------
           y.resize(nrows);
           t.resize(ncols);
           d.resize(ncols);
+          s.resize(nrows);
           fk.resize(nf+1);
+          cos2.resize(nrows);
 
           // Set NNLS solver ------------------------------------------------------------
           nnls = Math::ICLS::Problem<double>(Ak, Eigen::MatrixXd::Identity(nf+1, nf+1));
@@ -121,10 +168,13 @@ namespace MR {
           DEBUG("Reset external energy.");
           double e;
           dE = 0.0;
-          for (auto l = Loop(dwi, 0, 3) (dwi, tod, eext); l; ++l)
+          for (auto l = Loop(dwi, 0, 3) (dwi, tod, eext, sig, sig_updates); l; ++l)
           {
-            y = dwi.row(3);
-            t = tod.row(3);
+            t = row(tod).cast<double>();
+            s.noalias() = K * t;
+            row(sig) = s.cast<float>();
+            sig_updates.value() = 0;
+            y = row(dwi).cast<double>() - s;
             e = calcEnergy();
             eext.value() = e;
             dE += e;
@@ -140,19 +190,20 @@ namespace MR {
 
         void ExternalEnergyComputer::acceptChanges()
         {
-          assert (changes_vox.size() == changes_tod.size());
           assert (changes_vox.size() == changes_eext.size());
-          assert (!fiso.valid() || changes_vox.size() == changes_fiso.size());
 
           for (size_t k = 0; k != changes_vox.size(); ++k)
           {
-            assign_pos_of(changes_vox[k], 0, 3).to(tod, eext);
+            assign_pos_of(changes_vox[k], 0, 3).to(tod, eext, sig, sig_updates);
             assert(!is_out_of_bounds(tod, 0, 3));
-            tod.row(3) = changes_tod[k];
+            row(tod) = changes_tod.col(k).cast<float>();
+            row(sig) = changes_sig.col(k).cast<float>();
+            // the signal was recomputed from the TOD in add2vox() if this count was reached
+            sig_updates.value() = (sig_updates.value() >= SIGNAL_REFRESH_INTERVAL) ? 0 : sig_updates.value() + 1;
             eext.value() = changes_eext[k];
             if (fiso.valid()) {
               assign_pos_of(changes_vox[k], 0, 3).to(fiso);
-              fiso.row(3) = changes_fiso[k];
+              fiso.row(3) = changes_fiso.col(k);
             }
           }
           stats.incEextTotal(dE);
@@ -163,8 +214,6 @@ namespace MR {
         void ExternalEnergyComputer::clearChanges()
         {
           changes_vox.clear();
-          changes_tod.clear();
-          changes_fiso.clear();
           changes_eext.clear();
           dE = 0.0;
         }
@@ -177,6 +226,7 @@ namespace MR {
           Point_t w = Point_t(hanning(p[0]-v[0]), hanning(p[1]-v[1]), hanning(p[2]-v[2]));
 
           Math::SH::delta(d, dir, lmax);
+          calcSignal(dir);
 
           Eigen::Vector3i x = v.cast<int>();
           add2vox(x, factor*(1.-w[0])*(1.-w[1])*(1.-w[2]));
@@ -204,33 +254,50 @@ namespace MR {
           assign_pos_of(vox, 0, 3).to(tod);
           if (is_out_of_bounds(tod, 0, 3))
             return;
-          t = w * d;
           for (size_t k = 0; k != changes_vox.size(); ++k) {
             if (changes_vox[k] == vox) {
-              changes_tod[k] += t;
+              changes_tod.col(k) += w * d;
+              changes_sig.col(k) += w * s;
               return;
             }
           }
+          const size_t k = changes_vox.size();
+          if (k == size_t(changes_tod.cols())) {
+            changes_tod.conservativeResize(ncols, 2*k+8);
+            changes_sig.conservativeResize(nrows, 2*k+8);
+            changes_fiso.conservativeResize(nf, 2*k+8);
+          }
           changes_vox.push_back(vox);
-          t += tod.row(3);
-          changes_tod.push_back(t);
+          assign_pos_of(vox, 0, 3).to(sig, sig_updates);
+          changes_tod.col(k) = row(tod).cast<double>() + w * d;
+          if (sig_updates.value() >= SIGNAL_REFRESH_INTERVAL)
+            changes_sig.col(k).noalias() = K * changes_tod.col(k);
+          else
+            changes_sig.col(k) = row(sig).cast<double>() + w * s;
         }
 
 
-        double ExternalEnergyComputer::eval()
+        void ExternalEnergyComputer::calcSignal(const Point_t& dir)
         {
-          assert (changes_vox.size() == changes_tod.size());
+          cos2 = (gx * dir[0] + gy * dir[1] + gz * dir[2]).square();
+          s = poly.col(lmax/2);
+          for (int j = lmax/2-1; j >= 0; --j)
+            s.array() = s.array() * cos2 + poly.col(j);
+        }
 
+
+        double ExternalEnergyComputer::eval()
+        {
           dE = 0.0;
           double e;
           for (size_t k = 0; k != changes_vox.size(); ++k)
           {
             assign_pos_of(changes_vox[k], 0, 3).to(dwi, eext);
             assert(!is_out_of_bounds(dwi, 0, 3));
-            y = dwi.row(3);
-            t = changes_tod[k];
+            y = row(dwi).cast<double>() - changes_sig.col(k);
+            t = changes_tod.col(k);
             e = calcEnergy();
-            changes_fiso.push_back(fk.tail(nf));
+            changes_fiso.col(k) = fk.tail(nf);
             dE += e;
             dE -= eext.value();
             changes_eext.push_back(e);
@@ -241,10 +308,12 @@ namespace MR {
 
         double ExternalEnergyComputer::calcEnergy()
         {
-          y.noalias() -= K * t;
-          Math::ICLS::Solver<double> nnls_solver (nnls);
-          nnls_solver(fk, y);
-          y.noalias() -= Ak.rightCols(nf) * fk.tail(nf);
+          // y holds the residual after subtracting the WM signal predicted by t
+          if (nf > 0) {
+            Math::ICLS::Solver<double> nnls_solver (nnls);
+            nnls_solver(fk, y);
+            y.noalias() -= Ak.rightCols(nf) * fk.tail(nf);
+          }
           return y.squaredNorm() / nrows + mu * t[0];     // MSE + L1 regularizer
         }
 
@@ -25,12 +25,36 @@
 #include "dwi/tractography/GT/gt.h"
 #include "dwi/tractography/GT/energy.h"
 
+#define SIGNAL_REFRESH_INTERVAL 256
+
 
 namespace MR {
   namespace DWI {
     namespace Tractography {
       namespace GT {
         
+        /**
+         * @brief ExternalEnergyComputer evaluates the data fidelity of the
+         *        particle configuration.
+         *
+         * Alongside the TOD, the WM signal it predicts is stored in each
+         * voxel. Since this signal is linear in the TOD, a proposal only
+         * requires the signal of the particles being added or removed, which
+         * is added to the stored signal of each voxel affected, rather than
+         * predicting the signal from the updated TOD in every such voxel.
+         * To bound the accumulation of rounding errors in the stored (single
+         * precision) signal, it is recomputed from the TOD of a voxel when
+         * that voxel is next modified after every SIGNAL_REFRESH_INTERVAL
+         * accepted changes.
+         *
+         * The signal of a particle is evaluated using the addition theorem:
+         * for each DWI volume, the response along the angle between the
+         * particle and the gradient direction is a weighted sum of even
+         * Legendre polynomials of its cosine, which is tabulated on
+         * construction as a polynomial in the squared cosine. The gradient
+         * directions and polynomial coefficients are stored per component,
+         * such that this evaluation vectorises across volumes.
+         */
         class ExternalEnergyComputer : public EnergyComputer
         { MEMALIGN(ExternalEnergyComputer)
         public:
@@ -77,6 +101,8 @@ namespace MR {
           Image<float> tod;
           Image<float> fiso;
           Image<float> eext;
+          Image<float> sig;
+          Image<uint16_t> sig_updates;
           
           transform_type T;
           
@@ -84,13 +110,20 @@ namespace MR {
           size_t nrows, ncols, nf;
           double beta, mu, dE;
           Eigen::MatrixXd K, Ak;
-          Eigen::VectorXd y, t, d, fk;
+          Eigen::VectorXd y, t, d, s, fk;
+          
+          // Gradient directions, and response per volume as a polynomial in cos^2
+          Eigen::ArrayXd gx, gy, gz;
+          Eigen::ArrayXXd poly;
+          Eigen::ArrayXd cos2;
           
           Math::ICLS::Problem<double> nnls;
           
+          // Staged changes, one column per voxel
           vector<Eigen::Vector3i > changes_vox;
-          vector<Eigen::VectorXd > changes_tod;
-          vector<Eigen::VectorXd > changes_fiso;
+          Eigen::MatrixXd changes_tod;
+          Eigen::MatrixXd changes_sig;
+          Eigen::MatrixXd changes_fiso;
           vector<double> changes_eext;
           
           
@@ -102,6 +135,15 @@ namespace MR {
           
           double calcEnergy();
           
+          void calcSignal(const Point_t& dir);
+          
+          template <class ImageType>
+          inline Eigen::Map<Eigen::VectorXf, 0, Eigen::InnerStride<>> row(ImageType& image)
+          {
+            image.index(3) = 0;
+            return Eigen::Map<Eigen::VectorXf, 0, Eigen::InnerStride<>> (image.address(), image.size(3), Eigen::InnerStride<>(image.stride(3)));
+          }
+          
           inline double hanning(const double w) const
           {
             return (w <= (1.0-beta)/2) ? 0.0 : (w >= (1.0+beta)/2) ? 1.0 : (1 - std::cos(Math::pi * (w-(1.0-beta)/2)/beta )) / 2;
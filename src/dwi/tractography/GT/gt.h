@@ -21,6 +21,7 @@
 #define FRAC_BURNIN 10
 #define FRAC_PHASEOUT 10
 
+#include <atomic>
 #include <iostream>
 #include <mutex>
 
@@ -88,15 +89,21 @@ namespace MR {
           }
 
 
-          bool next() {
+          /**
+           * @brief Register \a n completed iterations, and update the
+           *        temperature for each ITER_BIGSTEP crossed.
+           * @return false once the maximum no. iterations is reached.
+           */
+          bool next(const uint64_t n = 1) {
             std::lock_guard<std::mutex> lock (mutex);
-            ++n_iter;
-            if (n_iter % ITER_BIGSTEP == 0) {
-              if ((n_iter >= n_max/FRAC_BURNIN) && (n_iter < n_max - n_max/FRAC_PHASEOUT))
+            for (uint64_t k = n_iter/ITER_BIGSTEP + 1; k <= (n_iter+n)/ITER_BIGSTEP; ++k) {
+              const uint64_t i = k * ITER_BIGSTEP;
+              if ((i >= n_max/FRAC_BURNIN) && (i < n_max - n_max/FRAC_PHASEOUT))
                 Tint *= alpha;
               progress++;
               out << *this << std::endl;
             }
+            n_iter += n;
             return (n_iter < n_max);
           }
 
@@ -126,13 +133,11 @@ namespace MR {
           }
 
           void incEextTotal(double d) {
-            std::lock_guard<std::mutex> lock (mutex);
-            EextTot += d;
+            atomic_add(EextTot, d);
           }
 
           void incEintTotal(double d) {
-            std::lock_guard<std::mutex> lock (mutex);
-            EintTot += d;
+            atomic_add(EintTot, d);
           }
 
 
@@ -159,7 +164,6 @@ namespace MR {
           }
 
           void incN(const char p, unsigned int i = 1) {
-            std::lock_guard<std::mutex> lock (mutex);
             switch (p) {
               case 'b': n_gen[0] += i; break;
               case 'd': n_gen[1] += i; break;
@@ -171,7 +175,6 @@ namespace MR {
           }
 
           void incNa(const char p, unsigned int i = 1) {
-            std::lock_guard<std::mutex> lock (mutex);
             switch (p) {
               case 'b': n_acc[0] += i; break;
               case 'd': n_acc[1] += i; break;
@@ -196,15 +199,22 @@ namespace MR {
           friend std::ostream& operator<< (std::ostream& o, Stats const& stats);
 
 
+        protected:
+          static void atomic_add(std::atomic<double>& x, const double d) {
+            double x0 = x.load(std::memory_order_relaxed);
+            while (!x.compare_exchange_weak(x0, x0 + d, std::memory_order_relaxed)) { }
+          }
+
+
         protected:
           std::mutex mutex;
           double Text, Tint;
-          double EextTot, EintTot;
+          std::atomic<double> EextTot, EintTot;
           double alpha;
 
-          unsigned long n_gen[5];
-          unsigned long n_acc[5];
-          unsigned long n_iter;
+          std::atomic<unsigned long> n_gen[5];
+          std::atomic<unsigned long> n_acc[5];
+          uint64_t n_iter;
           const uint64_t n_max;
 
           ProgressBar progress;
@@ -27,11 +27,26 @@ namespace MR {
         // RUNTIME METHODS --------------------------------------------------------------
         
         void MHSampler::execute()
-        {          
-          do {
-            next();
-          } while (stats.next());
-          
+        {
+          thread = decomposition->enter();
+          try {
+            do {
+              while (decomposition->claim(block)) {
+                // No. proposals proportional to the mask volume of the block
+                const size_t n = decomposition->num_voxels(block);
+                for (size_t i = 0; i != n; ++i)
+                  next();
+                if (!stats.next(n)) {
+                  decomposition->finish();
+                  break;
+                }
+              }
+            } while (decomposition->barrier());
+          }
+          catch (...) {
+            decomposition->abort();
+            throw;
+          }
         }
         
         
@@ -63,18 +78,18 @@ namespace MR {
           //TRACE;
           stats.incN('b');
           
-          Point_t pos;
-          SpatialLock<float>::Guard spatial_guard (*lock);
-          do {
-            pos = getRandPosInMask();
-          } while (! spatial_guard.try_lock(pos));
+          Point_t pos = getRandPosInBlock();
+          if (!inMask(T.scanner2voxel.cast<float>() * pos) || !inBlock(pos))
+            return;
           Point_t dir = getRandDir();
           
+          vector<Particle*>& particles = decomposition->particles(block);
+          double density = props.density * decomposition->num_voxels(block) / decomposition->total_voxels();
           double dE = E->stageAdd(pos, dir);
-          double R = std::exp(-dE) * props.density / (pGrid.getTotalCount()+1) * props.p_death / props.p_birth;
+          double R = std::exp(-dE) * density / (particles.size()+1) * props.p_death / props.p_birth;
           if (R > rng_uniform()) {
             E->acceptChanges();
-            pGrid.add(pos, dir);
+            particles.push_back(pGrid.add(pos, dir, thread));
             stats.incNa('b');
           }
           else {
@@ -88,19 +103,20 @@ namespace MR {
           //TRACE;
           stats.incN('d');
           
-          Particle* par;
-          SpatialLock<float>::Guard spatial_guard (*lock);
-          do {
-            par = pGrid.getRandom();
-            if (par == NULL || par->hasPredecessor() || par->hasSuccessor())
-              return;
-          } while (! spatial_guard.try_lock(par->getPosition()));
+          size_t idx;
+          Particle* par = getRandParticleInBlock(idx);
+          if (par == NULL || par->hasPredecessor() || par->hasSuccessor())
+            return;
           
+          vector<Particle*>& particles = decomposition->particles(block);
+          double density = props.density * decomposition->num_voxels(block) / decomposition->total_voxels();
           double dE = E->stageRemove(par);
-          double R = std::exp(-dE) * pGrid.getTotalCount() / props.density * props.p_birth / props.p_death;
+          double R = std::exp(-dE) * particles.size() / density * props.p_birth / props.p_death;
           if (R > rng_uniform()) {
             E->acceptChanges();
-            pGrid.remove(par);
+            particles[idx] = particles.back();
+            particles.pop_back();
+            pGrid.remove(par, thread);
             stats.incNa('d');
           }
           else {
@@ -114,18 +130,15 @@ namespace MR {
           //TRACE;
           stats.incN('r');
           
-          Particle* par;
-          SpatialLock<float>::Guard spatial_guard (*lock);
-          do {
-            par = pGrid.getRandom();
-            if (par == NULL)
-              return;
-          } while (! spatial_guard.try_lock(par->getPosition()));
+          size_t idx;
+          Particle* par = getRandParticleInBlock(idx);
+          if (par == NULL)
+            return;
 
           Point_t pos, dir;
           moveRandom(par, pos, dir);
           
-          if (!inMask(T.scanner2voxel.cast<float>() * pos)) {
+          if (!inMask(T.scanner2voxel.cast<float>() * pos) || !inBlock(pos)) {
             return;
           }
           double dE = E->stageShift(par, pos, dir);
@@ -146,17 +159,14 @@ namespace MR {
           //TRACE;
           stats.incN('o');
           
-          Particle* par;
-          SpatialLock<float>::Guard spatial_guard (*lock);
-          do {
-            par = pGrid.getRandom();
-            if (par == NULL)
-              return;
-          } while (! spatial_guard.try_lock(par->getPosition()));
+          size_t idx;
+          Particle* par = getRandParticleInBlock(idx);
+          if (par == NULL)
+            return;
 
           Point_t pos, dir;
           bool moved = moveOptimal(par, pos, dir);
-          if (!moved || !inMask(T.scanner2voxel.cast<float>() * pos)) {
+          if (!moved || !inMask(T.scanner2voxel.cast<float>() * pos) || !inBlock(pos)) {
             return;
           }
           
@@ -179,13 +189,10 @@ namespace MR {
           //TRACE;
           stats.incN('c');
           
-          Particle* par;
-          SpatialLock<float>::Guard spatial_guard (*lock);
-          do {
-            par = pGrid.getRandom();
-            if (par == NULL)
-              return;
-          } while (! spatial_guard.try_lock(par->getPosition()));
+          size_t idx;
+          Particle* par = getRandParticleInBlock(idx);
+          if (par == NULL)
+            return;
 
           int alpha0 = (rng_uniform() < 0.5) ? -1 : 1;
           ParticleEnd pe0;
@@ -219,18 +226,37 @@ namespace MR {
         
         // SUPPORTING METHODS -----------------------------------------------------------
         
-        Point_t MHSampler::getRandPosInMask()
+        Point_t MHSampler::getRandPosInBlock()
         {
-          Point_t p;
-          do {
-            p[0] = rng_uniform() * dims[0] - 0.5;
-            p[1] = rng_uniform() * dims[1] - 0.5;
-            p[2] = rng_uniform() * dims[2] - 0.5;
-          } while (!inMask(p));
+          const size_t n = std::min(size_t(rng_uniform() * decomposition->num_voxels(block)), decomposition->num_voxels(block)-1);
+          Point_t p = decomposition->voxel(block, n).cast<float>();
+          p[0] += rng_uniform() - 0.5;
+          p[1] += rng_uniform() - 0.5;
+          p[2] += rng_uniform() - 0.5;
           return T.voxel2scanner.cast<float>() * p;
         }
         
         
+        Particle* MHSampler::getRandParticleInBlock(size_t& idx)
+        {
+          const vector<Particle*>& particles = decomposition->particles(block);
+          if (particles.empty())
+            return NULL;
+          idx = std::min(size_t(rng_uniform() * particles.size()), particles.size()-1);
+          return particles[idx];
+        }
+        
+        
+        bool MHSampler::inBlock(const Point_t& pos) const
+        {
+          Point_t p = T.scanner2voxel.cast<float>() * pos;
+          for (size_t i = 0; i != 3; ++i)
+            if ((p[i] <= -0.5) || (p[i] >= dims[i]-0.5))
+              return false;
+          return decomposition->block_of(pos) == block;
+        }
+        
+        
         bool MHSampler::inMask(const Point_t p)
         {
           if ((p[0] <= -0.5) || (p[0] >= dims[0]-0.5) || 
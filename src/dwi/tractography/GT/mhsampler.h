@@ -26,7 +26,7 @@
 #include "dwi/tractography/GT/particle.h"
 #include "dwi/tractography/GT/particlegrid.h"
 #include "dwi/tractography/GT/energy.h"
-#include "dwi/tractography/GT/spatiallock.h"
+#include "dwi/tractography/GT/spatialdecomposition.h"
 
 
 namespace MR {
@@ -36,23 +36,32 @@ namespace MR {
 
         /**
          * @brief The MHSampler class
+         *
+         * Copies of the sampler run concurrently, each applying proposals to
+         * the blocks it claims from a shared SpatialDecomposition. Particles
+         * are only ever added, removed or moved within the current block,
+         * and the birth and death rates are scaled to the mask volume of
+         * that block, such that each block update satisfies detailed balance
+         * for the restriction of the target distribution to that block.
          */
         class MHSampler
         { MEMALIGN(MHSampler)
         public:
           MHSampler(const Image<float>& dwi, Properties &p, Stats &s, ParticleGrid &pgrid, 
-                    EnergyComputer* e, Image<bool>& m)
+                    EnergyComputer* e, Image<bool>& m, const size_t nthreads)
             : props(p), stats(s), pGrid(pgrid), E(e), T(dwi), 
               dims{size_t(dwi.size(0)), size_t(dwi.size(1)), size_t(dwi.size(2))}, 
-              mask(m), lock(make_shared<SpatialLock<float>>(5*Particle::L)), 
-              sigpos(Particle::L / 8.), sigdir(0.2)
+              mask(m), decomposition(make_shared<SpatialDecomposition>(dwi, mask, nthreads)),
+              thread(0), block(0), sigpos(Particle::L / 8.), sigdir(0.2)
           {
             DEBUG("Initialise Metropolis Hastings sampler.");
+            pGrid.setNumThreads(nthreads);
           }
           
           MHSampler(const MHSampler& other)
             : props(other.props), stats(other.stats), pGrid(other.pGrid), E(other.E->clone()), 
-              T(other.T), dims(other.dims), mask(other.mask), lock(other.lock), rng_uniform(), rng_normal(), sigpos(other.sigpos), sigdir(other.sigdir)
+              T(other.T), dims(other.dims), mask(other.mask), decomposition(other.decomposition),
+              thread(0), block(0), rng_uniform(), rng_normal(), sigpos(other.sigpos), sigdir(other.sigdir)
           {
             DEBUG("Copy Metropolis Hastings sampler.");
           }
@@ -81,13 +90,18 @@ namespace MR {
           vector<size_t> dims;
           Image<bool> mask;
           
-          std::shared_ptr< SpatialLock<float> > lock;
+          std::shared_ptr<SpatialDecomposition> decomposition;
+          size_t thread, block;
           Math::RNG::Uniform<float> rng_uniform;
           Math::RNG::Normal<float> rng_normal;
           float sigpos, sigdir;
           
           
-          Point_t getRandPosInMask();
+          Point_t getRandPosInBlock();
+          
+          Particle* getRandParticleInBlock(size_t& idx);
+          
+          bool inBlock(const Point_t& pos) const;
           
           bool inMask(const Point_t p);
           
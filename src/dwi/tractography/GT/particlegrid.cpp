@@ -22,28 +22,29 @@ namespace MR {
       namespace GT {
         
         
-        void ParticleGrid::add(const Point_t &pos, const Point_t &dir)
+        Particle* ParticleGrid::add(const Point_t &pos, const Point_t &dir, const size_t thread)
         {
-          Particle* p = pool.create(pos, dir);
+          Particle* p = pool.create(pos, dir, thread);
           size_t gidx = pos2idx(pos);
           grid[gidx].push_back(p);
+          return p;
         }
         
         void ParticleGrid::shift(Particle *p, const Point_t& pos, const Point_t& dir)
         {
           size_t gidx0 = pos2idx(p->getPosition());
           size_t gidx1 = pos2idx(pos);
-          std::remove (grid[gidx0].begin(), grid[gidx0].end(), p);
+          grid[gidx0].erase (std::remove (grid[gidx0].begin(), grid[gidx0].end(), p), grid[gidx0].end());
           p->setPosition(pos);
           p->setDirection(dir);
           grid[gidx1].push_back(p);
         }
         
-        void ParticleGrid::remove(Particle* p)
+        void ParticleGrid::remove(Particle* p, const size_t thread)
         {
           size_t gidx0 = pos2idx(p->getPosition());
-          std::remove (grid[gidx0].begin(), grid[gidx0].end(), p);
-          pool.destroy(p);
+          grid[gidx0].erase (std::remove (grid[gidx0].begin(), grid[gidx0].end(), p), grid[gidx0].end());
+          pool.destroy(p, thread);
         }
         
         void ParticleGrid::clear()
@@ -22,7 +22,6 @@
 #include "header.h"
 #include "transform.h"
 #include "dwi/tractography/file.h"
-#include "math/rng.h"
 
 #include "dwi/tractography/GT/particle.h"
 #include "dwi/tractography/GT/particlepool.h"
@@ -71,20 +70,26 @@ namespace MR {
             return pool.size();
           }
           
-          void add(const Point_t& pos, const Point_t& dir);
+          /**
+           * @brief Set the number of threads that will add and remove
+           *        particles concurrently, each using its own particle pool
+           *        slot. Concurrent threads must never access the same grid
+           *        cell.
+           */
+          inline void setNumThreads(const size_t nthreads) {
+            pool.setNumSlots(nthreads);
+          }
+          
+          Particle* add(const Point_t& pos, const Point_t& dir, const size_t thread = 0);
           
           void shift(Particle* p, const Point_t& pos, const Point_t& dir);
           
-          void remove(Particle* p);
+          void remove(Particle* p, const size_t thread = 0);
           
           void clear();
           
           const ParticleVectorType* at(const ssize_t x, const ssize_t y, const ssize_t z) const;
           
-          inline Particle* getRandom() {
-            return pool.random();
-          }
-          
           void exportTracks(Tractography::Writer<float>& writer);
           
           
@@ -92,7 +97,6 @@ namespace MR {
           std::mutex mutex;
           ParticlePool pool;
           vector<ParticleVectorType> grid;
-          Math::RNG rng;
           transform_type T_s2g;
           size_t dims[3];
           
@@ -17,11 +17,9 @@
 #ifndef __gt_particlepool_h__
 #define __gt_particlepool_h__
 
+#include <atomic>
 #include <deque>
 #include <stack>
-#include <mutex>
-
-#include "math/rng.h"
 
 #include "dwi/tractography/GT/particle.h"
 
@@ -33,29 +31,45 @@ namespace MR {
         /**
          * @brief ParticlePool manages creation and deletion of particles,
          *        minimizing the no. calls to new/delete.
+         *
+         * Storage is split into a number of slots, one for each sampler
+         * thread, such that particles can be created and destroyed without
+         * any locking as long as each thread only ever uses its own slot.
+         * Particles destroyed in one slot can be recycled in that slot
+         * regardless of where they were created.
          */
         class ParticlePool
         { MEMALIGN(ParticlePool)
         public:
-          ParticlePool() { }
+          ParticlePool(const size_t nslots = 1) : slots(nslots), count(0) { }
           
           ParticlePool(const ParticlePool&) = delete;
           ParticlePool& operator=(const ParticlePool&) = delete;
           ~ParticlePool() { }
           
+          /**
+           * @brief Set the number of slots. Not thread-safe; must be called
+           *        before any particles are created.
+           */
+          void setNumSlots(const size_t nslots) {
+            assert (!count);
+            slots.resize(std::max(nslots, size_t(1)));
+          }
+          
           /**
            * @brief Creates a new particle and returns a pointer to its address.
            */
-          Particle* create(const Point_t& pos, const Point_t& dir)
+          Particle* create(const Point_t& pos, const Point_t& dir, const size_t slot = 0)
           {
-            std::lock_guard<std::mutex> lock (mutex);
-            if (avail.empty()) {
-              pool.emplace_back(pos, dir);
-              return &pool.back();
+            Slot& s = slots[slot];
+            ++count;
+            if (s.avail.empty()) {
+              s.pool.emplace_back(pos, dir);
+              return &s.pool.back();
             } else {
-              Particle* p = avail.top();
+              Particle* p = s.avail.top();
               p->init(pos, dir);
-              avail.pop();
+              s.avail.pop();
               return p;
             }
           }
@@ -63,51 +77,43 @@ namespace MR {
           /**
            * @brief Destroys the particle at pointer p.
            */
-          void destroy(Particle* p) {
-            std::lock_guard<std::mutex> lock (mutex);
+          void destroy(Particle* p, const size_t slot = 0) {
             p->finalize();
-            avail.push(p);
+            slots[slot].avail.push(p);
+            --count;
           }
           
           /**
            * @brief Return number of Particles in the pool.
            */
           inline size_t size() const {
-            return pool.size() - avail.size();
-          }
-          
-          /**
-           * @brief Select random particle from the pool (uniformly).
-           */
-          Particle* random() {
-            std::lock_guard<std::mutex> lock (mutex);
-            if (pool.size() > avail.size())
-            {
-              std::uniform_int_distribution<size_t> dist(0, pool.size()-1);
-              for (int k = 0; k != 5; ++k) {
-                Particle* p = &pool[dist(rng)];
-                if (p->isAlive())
-                  return p;
-              }
-            }
-            return nullptr;
+            return count;
           }
           
           /**
            * @brief Clear pool.
            */
           void clear() {
-            std::lock_guard<std::mutex> lock (mutex);
-            pool.clear();
-            std::stack<Particle*, deque<Particle*> > e {};
-            avail.swap(e);
+            for (auto& s : slots) {
+              s.pool.clear();
+              std::stack<Particle*, deque<Particle*> > e {};
+              s.avail.swap(e);
+            }
+            count = 0;
           }
           
         protected:
-          std::mutex mutex;
-          deque<Particle> pool;
-          std::stack<Particle*, deque<Particle*> > avail;
-          Math::RNG rng;
+          class Slot
+          { MEMALIGN(Slot)
+          public:
+            Slot() { }
+            Slot(Slot&&) = default;
+            deque<Particle> pool;
+            std::stack<Particle*, deque<Particle*> > avail;
+          };
+          
+          vector<Slot> slots;
+          std::atomic<size_t> count;
         };
 
       }
@@ -0,0 +1,157 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/GT/spatialdecomposition.h"
+
+#include "algo/loop.h"
+
+
+namespace MR {
+  namespace DWI {
+    namespace Tractography {
+      namespace GT {
+
+
+        SpatialDecomposition::SpatialDecomposition(const Header& header, Image<bool>& mask, const size_t nthreads)
+          : num_threads(std::max(nthreads, size_t(1))),
+            dims(header.size(0), header.size(1), header.size(2)),
+            scanner2voxel(Transform(header).scanner2voxel.cast<float>()),
+            num_entered(0), next_block(0), done(false),
+            colour(0), num_waiting(0), generation(0), terminated(false), aborted(false)
+        {
+          // Blocks of the same colour are separated by at least 5 particle lengths,
+          // the range over which the energy computations access neighbouring particles.
+          for (size_t axis = 0; axis != 3; ++axis)
+            block_size[axis] = std::min<int>(Math::ceil<int>(5.0*Particle::L / header.spacing(axis)), dims[axis]);
+          offset.setZero();
+
+          if (mask.valid()) {
+            for (auto l = Loop(mask, 0, 3)(mask); l; ++l)
+              if (mask.value())
+                voxels.emplace_back(mask.index(0), mask.index(1), mask.index(2));
+          }
+          else {
+            voxels.reserve(size_t(dims[0]) * dims[1] * dims[2]);
+            for (int z = 0; z != dims[2]; ++z)
+              for (int y = 0; y != dims[1]; ++y)
+                for (int x = 0; x != dims[0]; ++x)
+                  voxels.emplace_back(x, y, z);
+          }
+          if (voxels.empty())
+            throw Exception("Mask for global tractography contains no voxels.");
+
+          redistribute();
+          DEBUG("Global tractography spatial decomposition: blocks of " + str(block_size.transpose())
+                + " voxels, " + str(num_threads) + " threads.");
+        }
+
+
+
+        bool SpatialDecomposition::claim(size_t& block)
+        {
+          if (done)
+            return false;
+          const size_t n = next_block++;
+          if (n >= colour_blocks[colour].size())
+            return false;
+          block = colour_blocks[colour][n];
+          return true;
+        }
+
+
+
+        bool SpatialDecomposition::barrier()
+        {
+          std::unique_lock<std::mutex> lock (mutex);
+          if (++num_waiting == num_threads) {
+            num_waiting = 0;
+            // Decided once per barrier, such that all threads agree on whether to continue
+            if (done)
+              terminated = true;
+            else
+              next_phase();
+            ++generation;
+            cond.notify_all();
+          }
+          else {
+            const size_t current = generation;
+            cond.wait(lock, [&] { return generation != current || aborted; });
+          }
+          return !terminated && !aborted;
+        }
+
+
+
+        void SpatialDecomposition::abort()
+        {
+          std::lock_guard<std::mutex> lock (mutex);
+          done = terminated = aborted = true;
+          cond.notify_all();
+        }
+
+
+
+        void SpatialDecomposition::next_phase()
+        {
+          if (++colour == 8) {
+            colour = 0;
+            redistribute();
+          }
+          next_block = 0;
+        }
+
+
+
+        void SpatialDecomposition::redistribute()
+        {
+          for (size_t axis = 0; axis != 3; ++axis) {
+            offset[axis] = std::uniform_int_distribution<int>(0, block_size[axis]-1)(rng);
+            num_blocks[axis] = (dims[axis] + offset[axis] + block_size[axis] - 1) / block_size[axis];
+          }
+          const size_t nblocks = size_t(num_blocks[0]) * num_blocks[1] * num_blocks[2];
+
+          // Sort mask voxels by block
+          voxel_offsets.assign(nblocks+1, 0);
+          for (const auto& v : voxels)
+            ++voxel_offsets[block_of(v)+1];
+          for (size_t b = 0; b != nblocks; ++b)
+            voxel_offsets[b+1] += voxel_offsets[b];
+          vector<size_t> pos (voxel_offsets.begin(), voxel_offsets.end()-1);
+          voxels_scratch.resize(voxels.size());
+          for (const auto& v : voxels)
+            voxels_scratch[pos[block_of(v)]++] = v;
+          std::swap(voxels, voxels_scratch);
+
+          // Reassign particles
+          vector<Particle*> all;
+          for (auto& list : block_particles)
+            all.insert(all.end(), list.begin(), list.end());
+          block_particles.assign(nblocks, vector<Particle*>());
+          for (auto p : all)
+            block_particles[block_of(p->getPosition())].push_back(p);
+
+          for (size_t c = 0; c != 8; ++c)
+            colour_blocks[c].clear();
+          for (size_t b = 0; b != nblocks; ++b)
+            if (num_voxels(b))
+              colour_blocks[colour_of(b)].push_back(b);
+        }
+
+
+      }
+    }
+  }
+}
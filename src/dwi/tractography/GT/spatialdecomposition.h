@@ -0,0 +1,162 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __gt_spatialdecomposition_h__
+#define __gt_spatialdecomposition_h__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "image.h"
+#include "transform.h"
+#include "math/rng.h"
+
+#include "dwi/tractography/GT/particle.h"
+
+
+namespace MR {
+  namespace DWI {
+    namespace Tractography {
+      namespace GT {
+
+        /**
+         * @brief SpatialDecomposition partitions the image into blocks of
+         *        voxels, and schedules these blocks for processing by
+         *        concurrent sampler threads.
+         *
+         * Blocks are at least 5 particle lengths wide along each axis, and
+         * are coloured according to the parity of their block coordinates,
+         * such that any two blocks of the same colour are separated by at
+         * least one full block. Each sweep over the image consists of 8
+         * phases, one per colour; within a phase, threads claim blocks of
+         * that colour and can modify the particles inside them without any
+         * locking. All threads synchronise between phases, and the block
+         * boundaries are shifted by a random offset at the start of each
+         * sweep, so that particles do not remain confined to the same block.
+         *
+         * The mask voxels and particles within each block are tracked here,
+         * such that the sampler can draw proposals from the current block.
+         */
+        class SpatialDecomposition
+        { MEMALIGN(SpatialDecomposition)
+        public:
+          SpatialDecomposition(const Header& header, Image<bool>& mask, const size_t nthreads);
+
+          SpatialDecomposition(const SpatialDecomposition&) = delete;
+          SpatialDecomposition& operator=(const SpatialDecomposition&) = delete;
+
+
+          /**
+           * @brief Register a sampler thread, and return its index.
+           */
+          size_t enter() { return num_entered++; }
+
+          /**
+           * @brief Claim the next block of the current phase.
+           * @return false if all blocks of this phase have been claimed.
+           */
+          bool claim(size_t& block);
+
+          /**
+           * @brief Wait for all threads to complete the current phase.
+           * @return false if sampling should terminate.
+           */
+          bool barrier();
+
+          /**
+           * @brief Request termination at the end of the current phase.
+           */
+          void finish() { done = true; }
+
+          /**
+           * @brief Request immediate termination, e.g. following an exception.
+           */
+          void abort();
+
+
+          inline size_t num_voxels(const size_t block) const {
+            return voxel_offsets[block+1] - voxel_offsets[block];
+          }
+
+          inline size_t total_voxels() const {
+            return voxels.size();
+          }
+
+          inline const Eigen::Vector3i& voxel(const size_t block, const size_t n) const {
+            return voxels[voxel_offsets[block] + n];
+          }
+
+          inline vector<Particle*>& particles(const size_t block) {
+            return block_particles[block];
+          }
+
+          /**
+           * @brief Index of the block containing voxel \a vox, which must lie
+           *        within the image.
+           */
+          inline size_t block_of(const Eigen::Vector3i& vox) const {
+            return (vox[0] + offset[0]) / block_size[0] + num_blocks[0] *
+                  ((vox[1] + offset[1]) / block_size[1] + num_blocks[1] *
+                  ((vox[2] + offset[2]) / block_size[2]));
+          }
+
+          /**
+           * @brief Index of the block containing scanner position \a pos,
+           *        which must lie within the image.
+           */
+          inline size_t block_of(const Point_t& pos) const {
+            const Point_t v = scanner2voxel * pos;
+            return block_of(Eigen::Vector3i(Math::round<int>(v[0]), Math::round<int>(v[1]), Math::round<int>(v[2])));
+          }
+
+
+        protected:
+          const size_t num_threads;
+          Eigen::Vector3i dims, block_size, offset, num_blocks;
+          Eigen::Transform<float, 3, Eigen::AffineCompact> scanner2voxel;
+
+          vector<Eigen::Vector3i> voxels, voxels_scratch;
+          vector<size_t> voxel_offsets;
+          vector<vector<Particle*>> block_particles;
+          vector<size_t> colour_blocks[8];
+
+          std::atomic<size_t> num_entered, next_block;
+          std::atomic<bool> done;
+          size_t colour, num_waiting, generation;
+          bool terminated, aborted;
+          std::mutex mutex;
+          std::condition_variable cond;
+          Math::RNG rng;
+
+          void next_phase();
+          void redistribute();
+
+          inline size_t colour_of(const size_t block) const {
+            const size_t x = block % num_blocks[0];
+            const size_t y = (block / num_blocks[0]) % num_blocks[1];
+            const size_t z = block / (num_blocks[0] * num_blocks[1]);
+            return (x & 1) | ((y & 1) << 1) | ((z & 1) << 2);
+          }
+
+        };
+
+      }
+    }
+  }
+}
+
+#endif // __gt_spatialdecomposition_h__
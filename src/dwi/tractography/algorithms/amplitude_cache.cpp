@@ -0,0 +1,244 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/algorithms/amplitude_cache.h"
+
+#include <cstring>
+
+#include "transform.h"
+#include "math/SH.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Algorithms
+      {
+
+
+
+        namespace {
+
+          // Conversion between single- and half-precision floating-point,
+          //   with round-to-nearest-even
+          inline uint16_t float_to_half (const float value)
+          {
+            uint32_t x;
+            memcpy (&x, &value, sizeof (float));
+            const uint16_t sign = (x >> 16) & 0x8000;
+            const uint32_t mag = x & 0x7FFFFFFF;
+            if (mag >= 0x7F800000) // Inf / NaN
+              return sign | 0x7C00 | (mag > 0x7F800000 ? 0x0200 : 0x0000);
+            if (mag >= 0x477FF000) // overflow
+              return sign | 0x7C00;
+            if (mag < 0x38800000) { // subnormal
+              if (mag < 0x33000000)
+                return sign;
+              const uint32_t exponent = mag >> 23;
+              const uint32_t mantissa = (mag & 0x007FFFFF) | 0x00800000;
+              const uint32_t shift = 126 - exponent;
+              uint32_t h = mantissa >> shift;
+              const uint32_t remainder = mantissa & ((uint32_t(1) << shift) - 1);
+              const uint32_t halfway = uint32_t(1) << (shift - 1);
+              if (remainder > halfway || (remainder == halfway && (h & 1)))
+                ++h;
+              return sign | h;
+            }
+            uint32_t h = (mag - 0x38000000) >> 13;
+            const uint32_t remainder = mag & 0x1FFF;
+            if (remainder > 0x1000 || (remainder == 0x1000 && (h & 1)))
+              ++h;
+            return sign | h;
+          }
+
+          inline float half_to_float (const uint16_t h)
+          {
+            const uint32_t sign = uint32_t(h & 0x8000) << 16;
+            const uint32_t exponent = (h >> 10) & 0x1F;
+            const uint32_t mantissa = h & 0x03FF;
+            uint32_t x;
+            if (exponent == 0x1F) {
+              x = sign | 0x7F800000 | (mantissa << 13);
+            } else if (exponent) {
+              x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+            } else {
+              const float value = std::ldexp (float(mantissa), -24);
+              return sign ? -value : value;
+            }
+            float value;
+            memcpy (&value, &x, sizeof (float));
+            return value;
+          }
+
+          Eigen::MatrixXf sh2amp_transform (const DWI::Directions::Set& dirs, const size_t lmax)
+          {
+            Eigen::MatrixXd directions (dirs.size(), 3);
+            for (size_t i = 0; i != dirs.size(); ++i)
+              directions.row (i) = dirs[i];
+            return Math::SH::init_transform_cart (directions, lmax).cast<float>().transpose();
+          }
+
+        }
+
+
+
+
+        AmplitudeCache::AmplitudeCache (const Image<float>& fod, const size_t num_directions, const size_t lmax) :
+            fod (fod),
+            dirs (num_directions),
+            transform (sh2amp_transform (dirs, lmax)),
+            scanner2voxel (Transform (fod).scanner2voxel.cast<float>()),
+            dim ({ fod.size(0), fod.size(1), fod.size(2) }),
+            num_tiles ({ size_t((fod.size(0) + tile_size - 1) >> tile_shift),
+                         size_t((fod.size(1) + tile_size - 1) >> tile_shift),
+                         size_t((fod.size(2) + tile_size - 1) >> tile_shift) }),
+            tiles (new std::atomic<const Tile*> [num_tiles[0] * num_tiles[1] * num_tiles[2]]),
+            num_built (0)
+        {
+          for (size_t i = 0; i != num_tiles[0] * num_tiles[1] * num_tiles[2]; ++i)
+            tiles[i].store (nullptr, std::memory_order_relaxed);
+          INFO ("FOD amplitudes will be sampled from cache of " + str(dirs.size()) + " directions"
+                + " (up to " + str(dirs.size() * 2 * tile_voxels * num_tiles[0] * num_tiles[1] * num_tiles[2] / (1024*1024)) + " MB)");
+        }
+
+
+
+        AmplitudeCache::~AmplitudeCache()
+        {
+          size_t num_stored = 0;
+          for (size_t i = 0; i != num_tiles[0] * num_tiles[1] * num_tiles[2]; ++i) {
+            const Tile* tile = tiles[i].load (std::memory_order_relaxed);
+            if (tile && tile != &empty) {
+              ++num_stored;
+              delete tile;
+            }
+          }
+          INFO ("FOD amplitude cache: " + str(num_built.load()) + " of " + str(num_tiles[0] * num_tiles[1] * num_tiles[2])
+                + " tiles computed, " + str(num_stored * dirs.size() * 2 * tile_voxels / (1024*1024)) + " MB stored");
+        }
+
+
+
+        float AmplitudeCache::value (const Eigen::Vector3f& position, const Eigen::Vector3f& direction) const
+        {
+          const Eigen::Vector3f voxel = scanner2voxel * position;
+          for (size_t axis = 0; axis != 3; ++axis) {
+            if (!(voxel[axis] > -0.5f && voxel[axis] < dim[axis] - 0.5f))
+              return NaN;
+          }
+
+          // Implicit masking: as in Interp::Masked, the nearest voxel must contain data
+          const ssize_t nearest[3] = { ssize_t(std::round (voxel[0])), ssize_t(std::round (voxel[1])), ssize_t(std::round (voxel[2])) };
+          if (!get_tile (tile_index (nearest[0], nearest[1], nearest[2])).valid[voxel_index (nearest[0], nearest[1], nearest[2])])
+            return NaN;
+
+          const size_t d = dirs.select_direction (direction.cast<default_type>());
+
+          const ssize_t c[3] = { ssize_t(std::floor (voxel[0])), ssize_t(std::floor (voxel[1])), ssize_t(std::floor (voxel[2])) };
+          const float f[3] = { voxel[0] - c[0], voxel[1] - c[1], voxel[2] - c[2] };
+          float result = 0.0f;
+          for (ssize_t z = 0; z < 2; ++z) {
+            const float wz = z ? f[2] : 1.0f - f[2];
+            const ssize_t iz = clamp (c[2] + z, 2);
+            for (ssize_t y = 0; y < 2; ++y) {
+              const float wy = wz * (y ? f[1] : 1.0f - f[1]);
+              const ssize_t iy = clamp (c[1] + y, 1);
+              for (ssize_t x = 0; x < 2; ++x) {
+                const float w = wy * (x ? f[0] : 1.0f - f[0]);
+                result += w * amplitude (clamp (c[0] + x, 0), iy, iz, d);
+              }
+            }
+          }
+          return result;
+        }
+
+
+
+        float AmplitudeCache::amplitude (const ssize_t x, const ssize_t y, const ssize_t z, const size_t direction) const
+        {
+          const Tile& tile (get_tile (tile_index (x, y, z)));
+          if (tile.amplitudes.empty())
+            return 0.0f;
+          return half_to_float (tile.amplitudes[direction * tile_voxels + voxel_index (x, y, z)]);
+        }
+
+
+
+        const AmplitudeCache::Tile& AmplitudeCache::get_tile (const size_t index) const
+        {
+          const Tile* tile = tiles[index].load (std::memory_order_acquire);
+          if (tile)
+            return *tile;
+          std::lock_guard<std::mutex> lock (mutexes[index % mutexes.size()]);
+          tile = tiles[index].load (std::memory_order_relaxed);
+          if (!tile) {
+            tile = build_tile (index);
+            tiles[index].store (tile, std::memory_order_release);
+            ++num_built;
+          }
+          return *tile;
+        }
+
+
+
+        const AmplitudeCache::Tile* AmplitudeCache::build_tile (const size_t index) const
+        {
+          const ssize_t tx = index % num_tiles[0];
+          const ssize_t ty = (index / num_tiles[0]) % num_tiles[1];
+          const ssize_t tz = index / (num_tiles[0] * num_tiles[1]);
+
+          // Each thread needs its own image accessor
+          Image<float> image (fod);
+          Eigen::MatrixXf coefs = Eigen::MatrixXf::Zero (tile_voxels, image.size(3));
+          std::bitset<tile_voxels> valid;
+          for (ssize_t z = tz << tile_shift; z < std::min ((tz+1) << tile_shift, dim[2]); ++z) {
+            image.index(2) = z;
+            for (ssize_t y = ty << tile_shift; y < std::min ((ty+1) << tile_shift, dim[1]); ++y) {
+              image.index(1) = y;
+              for (ssize_t x = tx << tile_shift; x < std::min ((tx+1) << tile_shift, dim[0]); ++x) {
+                image.index(0) = x;
+                const size_t v = voxel_index (x, y, z);
+                for (auto l = Loop (3) (image); l; ++l) {
+                  coefs (v, image.index(3)) = image.value();
+                  if (image.value())
+                    valid[v] = true;
+                }
+              }
+            }
+          }
+
+          // Entirely zero-filled: every amplitude is zero
+          if (valid.none())
+            return &empty;
+
+          Tile* tile = new Tile;
+          tile->valid = valid;
+          const Eigen::MatrixXf amplitudes = coefs * transform;
+          tile->amplitudes.resize (amplitudes.size());
+          for (ssize_t i = 0; i != amplitudes.size(); ++i)
+            tile->amplitudes[i] = float_to_half (amplitudes.data()[i]);
+          return tile;
+        }
+
+
+
+      }
+    }
+  }
+}
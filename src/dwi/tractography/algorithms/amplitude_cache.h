@@ -0,0 +1,117 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __dwi_tractography_algorithms_amplitude_cache_h__
+#define __dwi_tractography_algorithms_amplitude_cache_h__
+
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <mutex>
+
+#include "image.h"
+#include "types.h"
+#include "dwi/directions/set.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Algorithms
+      {
+
+
+
+        //! Lazily-populated cache of FOD amplitudes on a dense set of directions
+        /*! Rather than interpolating all SH coefficients at a position and
+         * then evaluating the SH series along the direction of interest, the
+         * amplitudes of the FOD in every voxel are precomputed along each
+         * direction of a predefined direction set, and stored at half
+         * precision in tiles of 8x8x8 voxels. A sample then consists of
+         * selecting the direction nearest to that requested, and trilinearly
+         * interpolating the amplitude along that direction only.
+         *
+         * Tiles are computed the first time they are accessed, and are
+         * shared between all threads; tiles in which every voxel is
+         * zero-filled are not stored.
+         *
+         * As for Interp::Masked, value() returns NaN if the position lies
+         * outside of the image, or if the voxel nearest to that position
+         * contains no non-zero data. */
+        class AmplitudeCache { MEMALIGN(AmplitudeCache)
+          public:
+            AmplitudeCache (const Image<float>& fod, const size_t num_directions, const size_t lmax);
+            ~AmplitudeCache();
+
+            //! the FOD amplitude at scanner-space \a position along \a direction
+            float value (const Eigen::Vector3f& position, const Eigen::Vector3f& direction) const;
+
+            size_t num_directions() const { return dirs.size(); }
+
+          private:
+            static constexpr size_t tile_shift = 3;
+            static constexpr size_t tile_size = 1 << tile_shift;
+            static constexpr size_t tile_voxels = tile_size * tile_size * tile_size;
+
+            class Tile { MEMALIGN(Tile)
+              public:
+                // Amplitudes as IEEE 754 half-precision, ordered [direction][z][y][x];
+                //   empty if every voxel in the tile is zero-filled
+                vector<uint16_t> amplitudes;
+                // Voxels that would not be rejected by Interp::Masked
+                std::bitset<tile_voxels> valid;
+            };
+
+            const Image<float> fod;
+            const DWI::Directions::FastLookupSet dirs;
+            // SH -> amplitude transform, stored transposed: (coefficients x directions)
+            const Eigen::MatrixXf transform;
+            const Eigen::Transform<float, 3, Eigen::AffineCompact> scanner2voxel;
+            const std::array<ssize_t, 3> dim;
+            const std::array<size_t, 3> num_tiles;
+
+            std::unique_ptr<std::atomic<const Tile*>[]> tiles;
+            const Tile empty;
+            mutable std::array<std::mutex, 64> mutexes;
+            mutable std::atomic<size_t> num_built;
+
+            const Tile& get_tile (const size_t index) const;
+            const Tile* build_tile (const size_t index) const;
+
+            FORCE_INLINE size_t tile_index (const ssize_t x, const ssize_t y, const ssize_t z) const {
+              return (x >> tile_shift) + num_tiles[0] * ((y >> tile_shift) + num_tiles[1] * (z >> tile_shift));
+            }
+            FORCE_INLINE size_t voxel_index (const ssize_t x, const ssize_t y, const ssize_t z) const {
+              return (x & (tile_size-1)) + tile_size * ((y & (tile_size-1)) + tile_size * (z & (tile_size-1)));
+            }
+            FORCE_INLINE ssize_t clamp (const ssize_t x, const size_t axis) const {
+              return x < 0 ? 0 : (x >= dim[axis] ? dim[axis]-1 : x);
+            }
+
+            float amplitude (const ssize_t x, const ssize_t y, const ssize_t z, const size_t direction) const;
+        };
+
+
+
+      }
+    }
+  }
+}
+
+#endif
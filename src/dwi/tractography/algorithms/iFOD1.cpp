@@ -31,13 +31,23 @@ namespace MR
         const OptionGroup iFODOptions = OptionGroup ("Options specific to the iFOD tracking algorithms")
 
         + Option ("power", "raise the FOD to the power specified (defaults are: 1.0 for iFOD1; 1.0/nsamples for iFOD2).")
-          + Argument ("value").type_float (0.0);
+          + Argument ("value").type_float (0.0)
+
+        + Option ("fod_cache", "sample FOD amplitudes from a cache of amplitudes precomputed on a dense set of directions, "
+                               "rather than interpolating the SH coefficients and evaluating the SH series for every sample. "
+                               "The value provided sets the number of directions, and must be one of the predefined sets "
+                               "(60, 129, 300, 321, 469, 513, 1281, 5000). Amplitudes are computed lazily as each part of the "
+                               "image is first visited, stored at half precision, and sampled along the direction of the set "
+                               "closest to that requested; this trades angular precision for speed.")
+          + Argument ("num").type_integer (60, 5000);
 
 
         void load_iFOD_options (Tractography::Properties& properties)
         {
           auto opt = get_options ("power");
           if (opt.size()) properties["fod_power"] = str<float> (opt[0][0]);
+          opt = get_options ("fod_cache");
+          if (opt.size()) properties["fod_cache_directions"] = str<unsigned int> (opt[0][0]);
         }
 
       }
@@ -22,6 +22,7 @@
 #include "dwi/tractography/tracking/shared.h"
 #include "dwi/tractography/tracking/tractography.h"
 #include "dwi/tractography/tracking/types.h"
+#include "dwi/tractography/algorithms/amplitude_cache.h"
 #include "dwi/tractography/algorithms/calibrator.h"
 
 
@@ -85,6 +86,10 @@ namespace MR
           properties.set (precomputed, "sh_precomputed");
           if (precomputed)
             precomputer.init (lmax);
+          size_t cache_directions = 0;
+          properties.set (cache_directions, "fod_cache_directions");
+          if (cache_directions)
+            cache.reset (new AmplitudeCache (source, cache_directions, lmax));
 
         }
 
@@ -113,6 +118,7 @@ namespace MR
         size_t lmax, max_trials;
         float sin_max_angle_1o, fod_power;
         Math::SH::PrecomputedAL<float> precomputer;
+        std::unique_ptr<AmplitudeCache> cache;
 
         private:
         mutable double mean_samples, mean_truncations, max_max_truncation;
@@ -179,12 +185,12 @@ namespace MR
 
       term_t next () override
       {
-        if (!get_data (source))
+        if (!S.cache && !get_data (source))
           return EXIT_IMAGE;
 
         float max_val = 0.0;
         for (size_t i = 0; i < calibrate_list.size(); ++i) {
-          float val = FOD (rotate_direction (dir, calibrate_list[i]));
+          float val = sample (rotate_direction (dir, calibrate_list[i]));
           if (std::isnan (val))
             return EXIT_IMAGE;
           else if (val > max_val)
@@ -200,7 +206,7 @@ namespace MR
 
         for (size_t n = 0; n < S.max_trials; n++) {
           Eigen::Vector3f new_dir = rand_dir (dir);
-          float val = FOD (new_dir);
+          float val = sample (new_dir);
 
           if (val > S.threshold) {
 
@@ -251,6 +257,15 @@ namespace MR
         );
       }
 
+      // FOD amplitude at the current position, for rejection sampling
+      float sample (const Eigen::Vector3f& d) const
+      {
+        return (S.cache ?
+            S.cache->value (pos, d) :
+            FOD (d)
+        );
+      }
+
       Eigen::Vector3f rand_dir (const Eigen::Vector3f& d) { return (random_direction (d, S.max_angle_1o, S.sin_max_angle_1o)); }
 
 
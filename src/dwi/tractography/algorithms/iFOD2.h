@@ -26,6 +26,7 @@
 #include "dwi/tractography/tracking/shared.h"
 #include "dwi/tractography/tracking/tractography.h"
 #include "dwi/tractography/tracking/types.h"
+#include "dwi/tractography/algorithms/amplitude_cache.h"
 #include "dwi/tractography/algorithms/calibrator.h"
 
 
@@ -83,6 +84,10 @@ namespace MR
                   properties.set (precomputed, "sh_precomputed");
                   if (precomputed)
                     precomputer.init (lmax);
+                  size_t cache_directions = 0;
+                  properties.set (cache_directions, "fod_cache_directions");
+                  if (cache_directions)
+                    cache.reset (new AmplitudeCache (source, cache_directions, lmax));
 
                   // num_samples is number of samples excluding first point
                   --num_samples;
@@ -132,6 +137,7 @@ namespace MR
                 size_t lmax, num_samples, max_trials;
                 float sin_max_angle_ho, fod_power;
                 Math::SH::PrecomputedAL<float> precomputer;
+                std::unique_ptr<AmplitudeCache> cache;
 
               private:
                 mutable double mean_samples, mean_truncations, max_max_truncation;
@@ -363,6 +369,8 @@ namespace MR
 
             FORCE_INLINE float FOD (const Eigen::Vector3f& position, const Eigen::Vector3f& direction)
             {
+              if (S.cache)
+                return S.cache->value (position, direction);
               if (!get_data (source, position))
                 return NaN;
               return FOD (direction);
@@ -46,6 +46,12 @@ const OptionGroup AssignmentOptions = OptionGroup ("Structural connectome stream
                                         "Default search distance is " + str(TCK2NODES_RADIAL_DEFAULT_DIST, 2) + "mm.")
     + Argument ("radius").type_float (0.0)
 
+  + Option ("radial_lookup", "when using the radial search assignment mechanism, precompute for every voxel the parcellation voxel whose centre is closest to that voxel's centre, "
+                             "and use this to exclude from the search of each streamline endpoint all voxels that are too close to it to be parcellation voxels, "
+                             "or to skip the search entirely where no parcellation voxel lies within the search radius. "
+                             "The resulting assignments are identical to those of the radial search; "
+                             "this consumes additional memory, but is considerably faster for large search radii and / or large numbers of streamlines.")
+
   + Option ("assignment_reverse_search", "traverse from each streamline endpoint inwards along the streamline, in search of the last node traversed by the streamline. "
                                          "Argument is the maximum traversal length in mm (set to 0 to allow search to continue to the streamline midpoint).")
     + Argument ("max_dist").type_float (0.0)
@@ -64,6 +70,7 @@ Tck2nodes_base* load_assignment_mode (Image<node_t>& nodes_data)
 {
 
   Tck2nodes_base* tck2nodes = nullptr;
+  const bool use_lookup = get_options ("radial_lookup").size();
   for (size_t index = 0; modes[index]; ++index) {
     auto opt = get_options (modes[index]);
     if (opt.size()) {
@@ -76,7 +83,7 @@ Tck2nodes_base* load_assignment_mode (Image<node_t>& nodes_data)
 
       switch (index) {
         case 0: tck2nodes = new Tck2nodes_end_voxels (nodes_data); break;
-        case 1: tck2nodes = new Tck2nodes_radial (nodes_data, float(opt[0][0])); break;
+        case 1: tck2nodes = new Tck2nodes_radial (nodes_data, float(opt[0][0]), use_lookup); break;
         case 2: tck2nodes = new Tck2nodes_revsearch (nodes_data, float(opt[0][0])); break;
         case 3: tck2nodes = new Tck2nodes_forwardsearch (nodes_data, float(opt[0][0])); break;
         case 4: tck2nodes = new Tck2nodes_all_voxels (nodes_data); break;
@@ -87,7 +94,9 @@ Tck2nodes_base* load_assignment_mode (Image<node_t>& nodes_data)
 
   // default
   if (!tck2nodes)
-    tck2nodes = new Tck2nodes_radial (nodes_data, TCK2NODES_RADIAL_DEFAULT_DIST);
+    tck2nodes = new Tck2nodes_radial (nodes_data, TCK2NODES_RADIAL_DEFAULT_DIST, use_lookup);
+  else if (use_lookup && !dynamic_cast<Tck2nodes_radial*> (tck2nodes))
+    WARN ("Option -radial_lookup is only applicable to the radial search assignment mechanism; ignored");
 
   return tck2nodes;
 
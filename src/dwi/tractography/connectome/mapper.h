@@ -75,6 +75,79 @@ class Mapper
 
 
 
+// Maps each streamline to multiple connectomes in a single pass:
+//   assignment of the streamline to nodes is performed once per parcellation,
+//   and the result is then shared between all outputs derived from that
+//   parcellation, each of which may use its own metric
+class MultiMapper
+{ MEMALIGN(MultiMapper)
+
+  public:
+    // For each output: the index of the parcellation to use, and the metric
+    using output_type = std::pair<size_t, const Metric*>;
+
+    MultiMapper (const vector<const Tck2nodes_base*>& parcellations, const vector<output_type>& outputs) :
+      parcellations (parcellations),
+      outputs (outputs)
+    {
+      assert (parcellations.size());
+#ifndef NDEBUG
+      for (const auto& i : parcellations)
+        assert (i->provides_pair() == parcellations.front()->provides_pair());
+      for (const auto& i : outputs)
+        assert (i.first < parcellations.size());
+#endif
+    }
+
+    MultiMapper (const MultiMapper& that) :
+      parcellations (that.parcellations),
+      outputs (that.outputs) { }
+
+
+    bool operator() (const Tractography::Streamline<float>& in, vector<Mapped_track_nodepair>& out)
+    {
+      assert (parcellations.front()->provides_pair());
+      pairs.resize (parcellations.size());
+      for (size_t i = 0; i != parcellations.size(); ++i)
+        pairs[i] = (*parcellations[i]) (in);
+      out.resize (outputs.size());
+      for (size_t i = 0; i != outputs.size(); ++i) {
+        out[i].set_track_index (in.get_index());
+        out[i].set_nodes (pairs[outputs[i].first]);
+        out[i].set_factor ((*outputs[i].second) (in, out[i].get_nodes()));
+        out[i].set_weight (in.weight);
+      }
+      return true;
+    }
+
+    bool operator() (const Tractography::Streamline<float>& in, vector<Mapped_track_nodelist>& out)
+    {
+      assert (!parcellations.front()->provides_pair());
+      lists.resize (parcellations.size());
+      for (size_t i = 0; i != parcellations.size(); ++i)
+        (*parcellations[i]) (in, lists[i]);
+      out.resize (outputs.size());
+      for (size_t i = 0; i != outputs.size(); ++i) {
+        out[i].set_track_index (in.get_index());
+        out[i].set_nodes (lists[outputs[i].first]);
+        out[i].set_factor ((*outputs[i].second) (in, out[i].get_nodes()));
+        out[i].set_weight (in.weight);
+      }
+      return true;
+    }
+
+
+  private:
+    const vector<const Tck2nodes_base*> parcellations;
+    const vector<output_type> outputs;
+
+    vector<NodePair> pairs;
+    vector<vector<node_t>> lists;
+
+};
+
+
+
 
 }
 }
@@ -17,8 +17,10 @@
 #ifndef __dwi_tractography_connectome_matrix_h__
 #define __dwi_tractography_connectome_matrix_h__
 
+#include <atomic>
 #include <set>
 
+#include "thread.h"
 #include "types.h"
 
 #include "connectome/connectome.h"
@@ -117,6 +119,90 @@ extern template class Matrix<double>;
 
 
 
+// Receives the output of MultiMapper, and distributes the contribution of each
+//   streamline to the corresponding connectome matrix. Incoming streamlines
+//   are buffered, such that each buffer can then be applied to the different
+//   matrices in parallel; this is safe since each matrix is only ever
+//   accessed by one thread at a time, and preserves the order in which
+//   streamlines are applied to each individual matrix.
+template <typename T>
+class MultiMatrix
+{ MEMALIGN(MultiMatrix<T>)
+
+  public:
+    MultiMatrix (vector<std::unique_ptr<Matrix<T>>>& matrices, const size_t buffer_size = 4096) :
+        matrices (matrices),
+        buffer_size (buffer_size) { }
+
+    bool operator() (vector<Mapped_track_nodepair>& in) { return push (in, pairs); }
+    bool operator() (vector<Mapped_track_nodelist>& in) { return push (in, lists); }
+
+    // Must be called once the queue has completed, in order to apply
+    //   any streamlines remaining in the buffer
+    void flush()
+    {
+      if (pairs.size())
+        flush (pairs);
+      if (lists.size())
+        flush (lists);
+    }
+
+
+  private:
+    vector<std::unique_ptr<Matrix<T>>>& matrices;
+    const size_t buffer_size;
+
+    vector<vector<Mapped_track_nodepair>> pairs;
+    vector<vector<Mapped_track_nodelist>> lists;
+
+    template <class MappedType>
+    bool push (vector<MappedType>& in, vector<vector<MappedType>>& buffer)
+    {
+      assert (in.size() == matrices.size());
+      buffer.push_back (std::move (in));
+      if (buffer.size() >= buffer_size)
+        flush (buffer);
+      return true;
+    }
+
+    template <class MappedType>
+    class Worker
+    { NOMEMALIGN
+      public:
+        Worker (vector<std::unique_ptr<Matrix<T>>>& matrices, const vector<vector<MappedType>>& buffer, std::atomic<size_t>& counter) :
+            matrices (matrices),
+            buffer (buffer),
+            counter (counter) { }
+        void execute() {
+          size_t index;
+          while ((index = counter++) < matrices.size()) {
+            for (const auto& i : buffer)
+              (*matrices[index]) (i[index]);
+          }
+        }
+      private:
+        vector<std::unique_ptr<Matrix<T>>>& matrices;
+        const vector<vector<MappedType>>& buffer;
+        std::atomic<size_t>& counter;
+    };
+
+    template <class MappedType>
+    void flush (vector<vector<MappedType>>& buffer)
+    {
+      std::atomic<size_t> counter (0);
+      Worker<MappedType> worker (matrices, buffer, counter);
+      const size_t num_threads = std::max (size_t(1), std::min (matrices.size(), Thread::threads_to_execute()));
+      auto threads = Thread::run (Thread::multi (worker, num_threads), "connectome matrix accumulation");
+      threads.wait();
+      buffer.clear();
+    }
+
+};
+
+
+
+
+
 
 }
 }
@@ -14,9 +14,13 @@
  * For more details, see http://www.mrtrix.org/.
  */
 
+#include <atomic>
 #include <map>
 #include <set>
 
+#include "thread.h"
+#include "algo/loop.h"
+
 #include "dwi/tractography/connectome/tck2nodes.h"
 
 
@@ -60,12 +64,166 @@ void Tck2nodes_radial::initialise_search ()
     }
   }
   radial_search.reserve (radial_search_map.size());
-  for (auto i = radial_search_map.begin(); i != radial_search_map.end(); ++i)
+  radial_search_dist.reserve (radial_search_map.size());
+  for (auto i = radial_search_map.begin(); i != radial_search_map.end(); ++i) {
     radial_search.push_back (i->second);
+    radial_search_dist.push_back (i->first);
+  }
+}
+
+
+
+
+namespace {
+
+  constexpr uint32_t no_node_voxel = std::numeric_limits<uint32_t>::max();
+
+  // One pass of the exact Euclidean distance transform of Felzenszwalb & Huttenlocher
+  //   (Theory of Computing, 2012), along a single image axis; the index of the
+  //   nearest node voxel is propagated alongside the squared distance. Each line
+  //   along the axis is independent, so lines are distributed across threads.
+  class DistanceTransformPass { MEMALIGN(DistanceTransformPass)
+    public:
+      DistanceTransformPass (const std::array<size_t, 3>& dims,
+                             const size_t axis,
+                             const default_type spacing,
+                             vector<float>& distances,
+                             vector<uint32_t>& nearest,
+                             std::atomic<size_t>& counter) :
+          axis (axis),
+          other_axes { axis ? size_t(0) : size_t(1), axis == 2 ? size_t(1) : size_t(2) },
+          dims (dims),
+          strides { 1, dims[0], dims[0]*dims[1] },
+          weight (Math::pow2 (spacing)),
+          distances (distances),
+          nearest (nearest),
+          counter (counter),
+          f (dims[axis]),
+          z (dims[axis]),
+          v (dims[axis]),
+          line_nearest (dims[axis]) { }
+
+      void execute ()
+      {
+        const size_t num_lines = dims[other_axes[0]] * dims[other_axes[1]];
+        size_t line;
+        while ((line = counter++) < num_lines)
+          process (strides[other_axes[0]] * (line % dims[other_axes[0]]) + strides[other_axes[1]] * (line / dims[other_axes[0]]));
+      }
+
+    private:
+      const size_t axis;
+      const std::array<size_t, 2> other_axes;
+      const std::array<size_t, 3> dims, strides;
+      const default_type weight;
+      vector<float>& distances;
+      vector<uint32_t>& nearest;
+      std::atomic<size_t>& counter;
+      vector<default_type> f, z;
+      vector<size_t> v;
+      vector<uint32_t> line_nearest;
+
+      void process (const size_t offset)
+      {
+        const size_t length = dims[axis];
+        const size_t stride = strides[axis];
+        for (size_t q = 0; q != length; ++q) {
+          f[q] = distances[offset + q*stride];
+          line_nearest[q] = nearest[offset + q*stride];
+        }
+        // Construct the lower envelope of the parabolas rooted at each voxel
+        //   for which a nearest node voxel is already known
+        size_t k = 0;
+        for (size_t q = 0; q != length; ++q) {
+          if (!std::isfinite (f[q]))
+            continue;
+          default_type s = -std::numeric_limits<default_type>::infinity();
+          while (k) {
+            s = ((f[q] + weight*Math::pow2 (q)) - (f[v[k-1]] + weight*Math::pow2 (v[k-1]))) / (2.0 * weight * (q - v[k-1]));
+            if (s <= z[k-1])
+              --k;
+            else
+              break;
+          }
+          z[k] = k ? s : -std::numeric_limits<default_type>::infinity();
+          v[k++] = q;
+        }
+        if (!k)
+          return;
+        for (size_t p = 0, j = 0; p != length; ++p) {
+          while (j+1 < k && z[j+1] < p)
+            ++j;
+          distances[offset + p*stride] = f[v[j]] + weight * Math::pow2 (default_type(p) - default_type(v[j]));
+          nearest[offset + p*stride] = line_nearest[v[j]];
+        }
+      }
+  };
+
+}
+
+
+
+void Tck2nodes_radial::initialise_lookup ()
+{
+  const std::array<size_t, 3> dims { size_t(nodes.size(0)), size_t(nodes.size(1)), size_t(nodes.size(2)) };
+  const size_t num_voxels = dims[0] * dims[1] * dims[2];
+  if (num_voxels >= size_t(no_node_voxel))
+    throw Exception ("Parcellation image too large for precomputation of radial search lookup");
+
+  nearest = std::make_shared<vector<uint32_t>> (num_voxels, no_node_voxel);
+  vector<float> distances (num_voxels, std::numeric_limits<float>::infinity());
+  Image<node_t> v (nodes);
+  for (auto l = Loop (v, 0, 3) (v); l; ++l) {
+    if (v.value()) {
+      const size_t index = v.index(0) + dims[0] * (v.index(1) + dims[1] * v.index(2));
+      distances[index] = 0.0f;
+      (*nearest)[index] = index;
+    }
+  }
+
+  for (size_t axis = 0; axis != 3; ++axis) {
+    std::atomic<size_t> counter (0);
+    DistanceTransformPass pass (dims, axis, nodes.spacing (axis), distances, *nearest, counter);
+    Thread::run (Thread::multi (pass), "parcellation distance transform").wait();
+  }
 }
 
 
 
+default_type Tck2nodes_radial::lookup_lower_bound (const Eigen::Vector3& p, const Eigen::Vector3& v_float) const
+{
+  // For any voxel centre c whose nearest node voxel lies at distance e, no node
+  //   voxel can be closer to the termination point p than (e - |p-c|); take the
+  //   tightest such bound over the voxels whose centres surround p
+  const voxel_type base { int(std::floor (v_float[0])), int(std::floor (v_float[1])), int(std::floor (v_float[2])) };
+  const size_t dim_x = nodes.size(0), dim_y = nodes.size(1);
+  default_type bound = 0.0;
+  voxel_type offset;
+  for (offset[2] = 0; offset[2] != 2; ++offset[2]) {
+    for (offset[1] = 0; offset[1] != 2; ++offset[1]) {
+      for (offset[0] = 0; offset[0] != 2; ++offset[0]) {
+
+        voxel_type voxel (base + offset);
+        for (size_t axis = 0; axis != 3; ++axis)
+          voxel[axis] = std::min (std::max (voxel[axis], 0), int(nodes.size (axis)) - 1);
+        const uint32_t index = (*nearest)[voxel[0] + dim_x * (voxel[1] + dim_y * voxel[2])];
+        // No node voxels anywhere in the image
+        if (index == no_node_voxel)
+          return std::numeric_limits<default_type>::infinity();
+
+        const voxel_type node_voxel { int(index % dim_x), int((index / dim_x) % dim_y), int(index / (dim_x * dim_y)) };
+        const Eigen::Vector3 p_voxel (transform->voxel2scanner * voxel.matrix().cast<default_type>());
+        const Eigen::Vector3 p_node (transform->voxel2scanner * node_voxel.matrix().cast<default_type>());
+        bound = std::max (bound, (p_voxel - p_node).norm() - (p - p_voxel).norm());
+
+      }
+    }
+  }
+  // Allow for the limited precision of the distance transform
+  return bound - 1e-3 * max_add_dist;
+}
+
+
 
 node_t Tck2nodes_radial::select_node (const Tractography::Streamline<>& tck, Image<node_t>& v, const bool end) const
 {
@@ -76,7 +234,23 @@ node_t Tck2nodes_radial::select_node (const Tractography::Streamline<>& tck, Ima
   const Eigen::Vector3 v_float = transform->scanner2voxel * p;
   const voxel_type centre { int(std::round (v_float[0])), int(std::round (v_float[1])), int(std::round (v_float[2])) };
 
-  for (vector<voxel_type>::const_iterator offset = radial_search.begin(); offset != radial_search.end(); ++offset) {
+  auto offset = radial_search.begin();
+  if (nearest) {
+    // If the voxel containing the termination point is itself a node voxel, its
+    //   centre is the closest of all voxel centres, and so is the first and final
+    //   voxel selected by the radial search
+    assign_pos_of (centre).to (v);
+    if (!is_out_of_bounds (v) && v.value() && (p - transform->voxel2scanner * centre.matrix().cast<default_type>()).norm() < max_dist)
+      return v.value();
+    // Otherwise, skip those voxels that are too close to p to be node voxels;
+    //   each is within max_add_dist of the centre voxel
+    const default_type bound = lookup_lower_bound (p, v_float);
+    if (bound >= max_dist)
+      return 0;
+    offset += std::lower_bound (radial_search_dist.begin(), radial_search_dist.end(), bound - max_add_dist) - radial_search_dist.begin();
+  }
+
+  for (; offset != radial_search.end(); ++offset) {
 
     const voxel_type this_voxel (centre + *offset);
     const Eigen::Vector3 p_voxel (transform->voxel2scanner * this_voxel.matrix().cast<default_type>());
@@ -124,17 +124,21 @@ class Tck2nodes_end_voxels : public Tck2nodes_base { MEMALIGN(Tck2nodes_end_voxe
 class Tck2nodes_radial : public Tck2nodes_base { MEMALIGN(Tck2nodes_radial)
 
   public:
-    Tck2nodes_radial (const Image<node_t>& nodes_data, const default_type radius) :
+    Tck2nodes_radial (const Image<node_t>& nodes_data, const default_type radius, const bool use_lookup = false) :
         Tck2nodes_base (nodes_data, true),
         max_dist       (radius),
         max_add_dist   (std::sqrt (Math::pow2 (0.5 * nodes.spacing(2)) + Math::pow2 (0.5 * nodes.spacing(1)) + Math::pow2 (0.5 * nodes.spacing(0))))
     {
       initialise_search ();
+      if (use_lookup)
+        initialise_lookup ();
     }
 
     Tck2nodes_radial (const Tck2nodes_radial& that) :
         Tck2nodes_base (that),
         radial_search  (that.radial_search),
+        radial_search_dist (that.radial_search_dist),
+        nearest        (that.nearest),
         max_dist       (that.max_dist),
         max_add_dist   (that.max_add_dist) { }
 
@@ -145,6 +149,21 @@ class Tck2nodes_radial : public Tck2nodes_base { MEMALIGN(Tck2nodes_radial)
 
     void initialise_search ();
     vector<voxel_type> radial_search;
+    // Distance of each offset in radial_search from the centre voxel
+    vector<default_type> radial_search_dist;
+
+    // Optional acceleration of the radial search: for every voxel in the image,
+    //   the linear index of the voxel with non-zero node index whose centre is
+    //   closest (exact Euclidean distance transform). From the nearest node voxels
+    //   of the eight voxels surrounding the streamline termination point, a lower
+    //   bound on the distance from that point to any node voxel is derived; the
+    //   radial search can then skip all voxels closer than that bound, or be
+    //   omitted entirely if the bound exceeds the maximum search distance.
+    //   The node selected is therefore identical to that of the full radial search.
+    void initialise_lookup ();
+    default_type lookup_lower_bound (const Eigen::Vector3&, const Eigen::Vector3&) const;
+    std::shared_ptr<vector<uint32_t>> nearest;
+
     const default_type max_dist;
     // Distances are sub-voxel from the precise streamline termination point, so the search order is imperfect.
     //   This parameter controls when to stop the radial search because no voxel within the search space can be closer
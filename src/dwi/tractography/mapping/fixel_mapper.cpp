@@ -0,0 +1,152 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "dwi/tractography/mapping/fixel_mapper.h"
+
+#include "transform.h"
+#include "algo/loop.h"
+#include "dwi/tractography/mapping/voxel.h"
+
+
+namespace MR {
+namespace DWI {
+namespace Tractography {
+namespace Mapping {
+
+
+
+
+FixelMapper::FixelMapper (Image<index_type>& index_image,
+                          Image<default_type>& directions_image,
+                          const default_type angular_threshold) :
+    info (index_image),
+    scanner2voxel (Transform (index_image).scanner2voxel.cast<float>()),
+    angular_threshold_dp (std::cos (angular_threshold * (Math::pi/180.0))),
+    upsampler (1)
+{
+  std::shared_ptr<Lookup> table (new Lookup);
+  const size_t num_voxels = info.size(0) * info.size(1) * info.size(2);
+  table->first.assign (num_voxels, 0);
+  table->count.assign (num_voxels, 0);
+  for (auto l = Loop (index_image, 0, 3) (index_image); l; ++l) {
+    const size_t voxel = index_image.index(0) + info.size(0) * (index_image.index(1) + info.size(1) * index_image.index(2));
+    index_image.index(3) = 0;
+    table->count[voxel] = index_image.value();
+    index_image.index(3) = 1;
+    table->first[voxel] = index_image.value();
+  }
+  table->directions.resize (directions_image.size(0));
+  for (auto l = Loop (directions_image, 0, 1) (directions_image); l; ++l)
+    table->directions[directions_image.index(0)] = directions_image.row(1);
+  lookup = table;
+}
+
+
+
+void FixelMapper::operator() (const Streamline<>& in, vector<index_type>& fixels) const
+{
+  using point_type = Streamline<>::point_type;
+
+  fixels.clear();
+  if (in.size() < 2)
+    return;
+  upsampler (in, upsampled);
+  const Streamline<>& tck (upsampled);
+
+  // Walk the voxels intersected by each streamline segment in turn;
+  //   each time a voxel boundary is crossed, the traversal of the voxel
+  //   just exited is recorded
+  visits.clear();
+  point_type entry = tck.front();
+  Eigen::Vector3f p = scanner2voxel * tck.front();
+  Eigen::Vector3i voxel = round (p);
+  for (size_t i = 1; i != tck.size(); ++i) {
+    const Eigen::Vector3f q = scanner2voxel * tck[i];
+    // no boundary can be crossed if the segment ends within the current voxel
+    if (((q - voxel.cast<float>()).array().abs() < 0.5f).all()) {
+      p = q;
+      continue;
+    }
+    const Eigen::Vector3f step = q - p;
+    while (true) {
+      float t_exit = 1.0f;
+      size_t axis = 3;
+      for (size_t a = 0; a != 3; ++a) {
+        if (step[a]) {
+          const float t = ((step[a] > 0.0f ? voxel[a] + 0.5f : voxel[a] - 0.5f) - p[a]) / step[a];
+          if (t < t_exit) {
+            t_exit = t;
+            axis = a;
+          }
+        }
+      }
+      if (axis == 3)
+        break;
+      const point_type exit = tck[i-1] + std::max (t_exit, 0.0f) * (tck[i] - tck[i-1]);
+      add_visit (voxel, exit - entry);
+      entry = exit;
+      voxel[axis] += (step[axis] > 0.0f) ? 1 : -1;
+    }
+    p = q;
+  }
+  add_visit (voxel, tck.back() - entry);
+
+  // Combine multiple traversals of the same voxel, retaining the order
+  //   of traversal for consistency with SetVoxelDir
+  std::sort (visits.begin(), visits.end());
+  for (auto v = visits.begin(); v != visits.end();) {
+    const size_t voxel_index = v->voxel;
+    Eigen::Vector3 dir = v->dir;
+    while (++v != visits.end() && v->voxel == voxel_index)
+      dir += v->dir * (dir.dot (v->dir) < 0.0 ? -1.0 : 1.0);
+    const index_type num_fixels = lookup->count[voxel_index];
+    if (!num_fixels)
+      continue;
+    dir.normalize();
+    const index_type first_index = lookup->first[voxel_index];
+    index_type closest_fixel_index = 0;
+    float largest_dp = 0.0f;
+    for (index_type j = first_index; j != first_index + num_fixels; ++j) {
+      const float dp = abs (dir.dot (lookup->directions[j]));
+      if (dp > largest_dp) {
+        largest_dp = dp;
+        closest_fixel_index = j;
+      }
+    }
+    if (largest_dp > angular_threshold_dp)
+      fixels.push_back (closest_fixel_index);
+  }
+}
+
+
+
+void FixelMapper::add_visit (const Eigen::Vector3i& voxel, const Streamline<>::point_type& traversal) const
+{
+  if (!check (voxel, info))
+    return;
+  const Eigen::Vector3 dir = traversal.cast<default_type>().normalized();
+  if (!dir.allFinite() || dir.isZero())
+    return;
+  visits.push_back ({ size_t(voxel[0] + info.size(0) * (voxel[1] + info.size(1) * voxel[2])), visits.size(), dir });
+}
+
+
+
+
+}
+}
+}
+}
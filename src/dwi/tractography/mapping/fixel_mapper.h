@@ -0,0 +1,113 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __dwi_tractography_mapping_fixel_mapper_h__
+#define __dwi_tractography_mapping_fixel_mapper_h__
+
+
+#include "header.h"
+#include "image.h"
+#include "memory.h"
+#include "types.h"
+
+#include "fixel/types.h"
+
+#include "dwi/tractography/streamline.h"
+#include "dwi/tractography/resampling/upsampler.h"
+
+
+namespace MR {
+  namespace DWI {
+    namespace Tractography {
+      namespace Mapping {
+
+
+
+        //! Map streamlines directly to the fixels of a fixel directory
+        /*! Rather than first mapping each streamline to a set of voxels and
+         * tangents (as in TrackMapperBase), and subsequently searching the
+         * fixel index & directions images for the fixel corresponding to each
+         * of these, this class walks the voxels intersected by each segment
+         * of the (upsampled) streamline with a 3D DDA, and resolves the fixel
+         * using a flat table of the fixels within each voxel and their
+         * directions, precomputed from the fixel directory.
+         *
+         * As for precise mapping in TrackMapperBase, each voxel traversed by
+         * a streamline yields a single direction (the sum of the directions
+         * of all traversals of that voxel), which is assigned to the fixel
+         * closest in orientation, provided the angle between them does not
+         * exceed the angular threshold. Each fixel is therefore reported at
+         * most once per streamline.
+         *
+         * Copies of this class share the lookup table, but each holds its
+         * own scratch storage; each thread should therefore use its own
+         * copy. */
+        class FixelMapper
+        { MEMALIGN(FixelMapper)
+
+          public:
+            using index_type = MR::Fixel::index_type;
+
+            FixelMapper (Image<index_type>& index_image,
+                         Image<default_type>& directions_image,
+                         const default_type angular_threshold);
+
+            void set_upsample_ratio (const size_t i) { upsampler.set_ratio (i); }
+
+            //! get the indices of the fixels traversed by streamline \a tck
+            void operator() (const Streamline<>& tck, vector<index_type>& fixels) const;
+
+            size_t num_fixels () const { return lookup->directions.size(); }
+
+
+          protected:
+            class Lookup
+            { NOMEMALIGN
+              public:
+                // index of the first fixel, and number of fixels, in each voxel
+                vector<index_type> first, count;
+                vector<Eigen::Vector3> directions;
+            };
+
+            class Visit
+            { NOMEMALIGN
+              public:
+                size_t voxel, order;
+                Eigen::Vector3 dir;
+                bool operator< (const Visit& that) const { return (voxel == that.voxel) ? (order < that.order) : (voxel < that.voxel); }
+            };
+
+            const Header info;
+            const Eigen::Transform<float,3,Eigen::AffineCompact> scanner2voxel;
+            const float angular_threshold_dp;
+            std::shared_ptr<const Lookup> lookup;
+            Resampling::Upsampler upsampler;
+
+            mutable Streamline<> upsampled;
+            mutable vector<Visit> visits;
+
+            void add_visit (const Eigen::Vector3i&, const Streamline<>::point_type&) const;
+
+        };
+
+
+
+      }
+    }
+  }
+}
+
+#endif
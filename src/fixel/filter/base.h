@@ -51,6 +51,15 @@ namespace MR
             throw Exception ("Running empty function Fixel::Filter::Base::operator()");
           }
 
+          // Apply the filter to a number of fixel data files; derived classes
+          //   can override this in order to share work between files
+          virtual void operator() (vector<Image<float>>& inputs, vector<Image<float>>& outputs) const
+          {
+            assert (inputs.size() == outputs.size());
+            for (size_t i = 0; i != inputs.size(); ++i)
+              (*this) (inputs[i], outputs[i]);
+          }
+
         protected:
           std::string message;
 
@@ -40,7 +40,6 @@ namespace MR
           matrix (matrix),
           threshold (smoothing_threshold)
       {
-        set_fwhm (smoothing_fwhm);
         // For smoothing, we need to be able to quickly
         //   calculate the distance between any pair of fixels
         fixel_positions.resize (matrix.size());
@@ -55,6 +54,7 @@ namespace MR
           for (size_t fixel_index = 0; fixel_index != count; ++fixel_index)
             fixel_positions[offset + fixel_index] = scanner;
         }
+        set_fwhm (smoothing_fwhm);
       }
 
       Smooth::Smooth (Image<index_type> index_image,
@@ -66,15 +66,7 @@ namespace MR
                       const Matrix::Reader& matrix,
                       const float smoothing_fwhm,
                       const float smoothing_threshold) :
-          Smooth (index_image, matrix, Image<bool>(), smoothing_fwhm, smoothing_threshold)
-      {
-        Header mask_header = Fixel::data_header_from_index (index_image);
-        mask_header.datatype() = DataType::Bit;
-        assert (size_t(mask_header.size(0)) == matrix.size());
-        mask_image = Image<bool>::scratch (mask_header, "full scratch fixel mask");
-        for (auto l = Loop(0) (mask_image); l; ++l)
-          mask_image.value() = true;
-      }
+          Smooth (index_image, matrix, Image<bool>(), smoothing_fwhm, smoothing_threshold) { }
 
       Smooth::Smooth (Image<index_type> index_image,
                       const Matrix::Reader& matrix) :
@@ -87,22 +79,153 @@ namespace MR
         stdev = fwhm / 2.3548f;
         gaussian_const1 = 1.0 / (stdev * std::sqrt (2.0 * Math::pi));
         gaussian_const2 = -1.0 / (2.0 * stdev * stdev);
+        compute_kernel();
+      }
+
+
+
+      void Smooth::compute_kernel()
+      {
+        const size_t num_fixels = matrix.size();
+        in_mask.assign (num_fixels, true);
+        if (mask_image.valid()) {
+          Image<bool> mask (mask_image);
+          if (size_t(mask.size(0)) != num_fixels)
+            throw Exception ("Size of fixel mask \"" + mask.name() + "\" (" + str(mask.size(0)) +
+                             ") does not match fixel connectivity matrix (" + str(num_fixels) + ")");
+          for (auto l = Loop(0) (mask); l; ++l)
+            in_mask[mask.index(0)] = mask.value();
+        }
+
+        // Compute the kernel for each fixel in parallel, then concatenate
+        class Row
+        { NOMEMALIGN
+          public:
+            Row() : disconnected (false) { }
+            vector<std::pair<index_type, float>> entries;
+            bool disconnected;
+        };
+        vector<Row> rows (num_fixels);
+
+        class Source
+        { NOMEMALIGN
+          public:
+            Source (const size_t N) :
+                number (N),
+                counter (0) { }
+            bool operator() (size_t& fixel)
+            {
+              if ((fixel = counter) == number)
+                return false;
+              ++counter;
+              return true;
+            }
+          private:
+            const size_t number;
+            size_t counter;
+        };
+
+        auto worker = [&] (const size_t fixel) {
+          if (!in_mask[fixel])
+            return true;
+          const Eigen::Vector3f& pos (fixel_positions[fixel]);
+          const auto connectivity = matrix[fixel];
+          Row& row (rows[fixel]);
+          row.disconnected = connectivity.empty();
+          for (const auto& c : connectivity) {
+            if (in_mask[c.index()]) {
+              const Matrix::connectivity_value_type weight = c.value() * gaussian_const1 * std::exp (gaussian_const2 * (fixel_positions[c.index()] - pos).squaredNorm());
+              if (weight >= threshold)
+                row.entries.emplace_back (c.index(), weight);
+            }
+          }
+          return true;
+        };
+
+        Thread::run_queue (Source (num_fixels),
+                           Thread::batch (size_t()),
+                           Thread::multi (worker));
+
+        size_t num_entries = 0;
+        for (const auto& row : rows)
+          num_entries += row.entries.size();
+        kernel_offsets.resize (num_fixels+1);
+        kernel_fixels.resize (num_entries);
+        kernel_weights.resize (num_entries);
+        kernel_sums.resize (num_fixels);
+        disconnected.resize (num_fixels);
+        size_t offset = 0;
+        for (size_t fixel = 0; fixel != num_fixels; ++fixel) {
+          kernel_offsets[fixel] = offset;
+          default_type sum_weights = 0.0;
+          for (const auto& entry : rows[fixel].entries) {
+            kernel_fixels[offset] = entry.first;
+            kernel_weights[offset++] = entry.second;
+            sum_weights += entry.second;
+          }
+          kernel_sums[fixel] = sum_weights;
+          disconnected[fixel] = rows[fixel].disconnected;
+          vector<std::pair<index_type, float>>().swap (rows[fixel].entries);
+        }
+        kernel_offsets[num_fixels] = offset;
       }
 
 
 
-      // TODO Provide an alternative functor for when the input & output images contain more than one column
-      //   (more efficient to construct the smoothing kernel once per fixel, then loop over image channels)
       void Smooth::operator() (Image<float>& input, Image<float>& output) const
       {
-        Fixel::check_data_file (input);
-        Fixel::check_data_file (output);
+        vector<Image<float>> inputs (1, input), outputs (1, output);
+        (*this) (inputs, outputs);
+      }
 
-        check_dimensions (input, output);
 
-        if (size_t (input.size(0)) != matrix.size())
-          throw Exception ("Size of fixel data file \"" + input.name() + "\" (" + str(input.size(0)) +
-                           ") does not match fixel connectivity matrix (" + str(matrix.size()) + ")");
+
+      void Smooth::operator() (vector<Image<float>>& inputs, vector<Image<float>>& outputs) const
+      {
+        assert (inputs.size() == outputs.size());
+        for (size_t n = 0; n != inputs.size(); ++n) {
+          Fixel::check_data_file (inputs[n]);
+          Fixel::check_data_file (outputs[n]);
+          check_dimensions (inputs[n], outputs[n]);
+          if (size_t (inputs[n].size(0)) != matrix.size())
+            throw Exception ("Size of fixel data file \"" + inputs[n].name() + "\" (" + str(inputs[n].size(0)) +
+                             ") does not match fixel connectivity matrix (" + str(matrix.size()) + ")");
+        }
+
+        // Fixel data files are processed in blocks, each holding the data
+        //   for all fixels (rows) of a number of files (columns)
+        const size_t max_block_size = 16;
+        for (size_t first = 0; first < inputs.size(); first += max_block_size) {
+          const size_t block_size = std::min (max_block_size, inputs.size() - first);
+          block_type input_block (matrix.size(), block_size), output_block (matrix.size(), block_size);
+          for (size_t n = 0; n != block_size; ++n) {
+            Image<float>& input (inputs[first+n]);
+            for (auto l = Loop(0) (input); l; ++l)
+              input_block (input.index(0), n) = input.value();
+          }
+          apply (input_block, output_block);
+          for (size_t n = 0; n != block_size; ++n) {
+            Image<float>& output (outputs[first+n]);
+            for (auto l = Loop(0) (output); l; ++l)
+              output.value() = output_block (output.index(0), n);
+          }
+        }
+      }
+
+
+
+      void Smooth::apply (const block_type& input, block_type& output) const
+      {
+        // Non-finite values are excluded from the weighted average; only where
+        //   such values are present do the sums of weights need to be computed
+        //   explicitly for each column
+        const bool all_finite = input.allFinite();
+        block_type values, finite;
+        if (!all_finite) {
+          values = input.unaryExpr ([] (const float v) { return std::isfinite (v) ? v : 0.0f; });
+          finite = input.unaryExpr ([] (const float v) { return std::isfinite (v) ? 1.0f : 0.0f; });
+        }
+        const block_type& data (all_finite ? input : values);
 
         class Source
         { NOMEMALIGN
@@ -125,59 +248,56 @@ namespace MR
         class Worker
         { MEMALIGN(Worker)
           public:
-            Worker (const Smooth& master, const Image<float>& input, const Image<float>& output) :
+            Worker (const Smooth& master, const block_type& input, const block_type& data, const block_type& finite, const bool all_finite, block_type& output) :
                 master (master),
-                matrix (master.matrix),
                 input (input),
+                data (data),
+                finite (finite),
+                all_finite (all_finite),
                 output (output),
-                mask (master.mask_image) { }
+                sum_values (1, input.cols()),
+                sum_weights (1, input.cols()) { }
 
             bool operator() (const size_t fixel)
             {
-              mask.index(0) = output.index(0) = fixel;
-              if (mask.value()) {
-                const Eigen::Vector3f& pos (master.fixel_positions[fixel]);
-                const auto connectivity = matrix[fixel];
-                default_type sum_weights (0.0);
-                output.value() = 0.0;
-                for (const auto& c : connectivity) {
-                  mask.index (0) = input.index(0) = c.index();
-                  if (mask.value() && std::isfinite (static_cast<float>(input.value()))) {
-                    const Matrix::connectivity_value_type weight = c.value() * master.gaussian_const1 * std::exp (master.gaussian_const2 * (master.fixel_positions[c.index()] - pos).squaredNorm());
-                    if (weight >= master.threshold) {
-                      output.value() += weight * input.value();
-                      sum_weights += weight;
-                    }
-                  }
-                }
-                if (sum_weights) {
-                  output.value() /= sum_weights;
-                } else if (connectivity.empty()) {
-                  // Provide unsmoothed value if disconnected
-                  input.index(0) = fixel;
-                  output.value() = input.value();
-                } else {
-                  output.value() = std::numeric_limits<float>::quiet_NaN();
-                }
+              if (!master.in_mask[fixel]) {
+                output.row (fixel).setConstant (std::numeric_limits<float>::quiet_NaN());
+                return true;
+              }
+              if (master.disconnected[fixel]) {
+                // Provide unsmoothed value if disconnected
+                output.row (fixel) = input.row (fixel);
+                return true;
+              }
+              sum_values.setZero();
+              const size_t end = master.kernel_offsets[fixel+1];
+              for (size_t i = master.kernel_offsets[fixel]; i != end; ++i)
+                sum_values += master.kernel_weights[i] * data.row (master.kernel_fixels[i]);
+              if (all_finite) {
+                sum_weights.setConstant (master.kernel_sums[fixel]);
               } else {
-                output.value() = std::numeric_limits<float>::quiet_NaN();
+                sum_weights.setZero();
+                for (size_t i = master.kernel_offsets[fixel]; i != end; ++i)
+                  sum_weights += master.kernel_weights[i] * finite.row (master.kernel_fixels[i]);
               }
+              for (ssize_t n = 0; n != output.cols(); ++n)
+                output (fixel, n) = sum_weights[n] ? sum_values[n] / sum_weights[n] : std::numeric_limits<float>::quiet_NaN();
               return true;
             }
 
           private:
             const Smooth& master;
-            // Need a local copy of each of these
-            Matrix::Reader matrix;
-            Image<float> input;
-            Image<float> output;
-            Image<bool> mask;
+            const block_type& input;
+            const block_type& data;
+            const block_type& finite;
+            const bool all_finite;
+            block_type& output;
+            Eigen::Matrix<float, 1, Eigen::Dynamic> sum_values, sum_weights;
         };
 
-        Thread::run_queue (Source (input.size (0)),
+        Thread::run_queue (Source (input.rows()),
                            Thread::batch (size_t()),
-                           Thread::multi (Worker (*this, input, output)));
-
+                           Thread::multi (Worker (*this, input, data, finite, all_finite, output)));
       }
 
 
@@ -48,6 +48,13 @@ namespace MR
        * smooth_filter (fixel_data_in, fixel_data_out);
        *
        * \endcode
+       *
+       * The smoothing kernel (the product of the connectivity values and the
+       * spatial Gaussian, restricted to those weights above threshold) is
+       * computed once on construction, and stored in compressed sparse row
+       * form. When multiple fixel data files are provided, these are
+       * processed in blocks, such that each kernel entry is applied to all
+       * files within the block at once.
        */
 
       class Smooth : public Base
@@ -72,13 +79,27 @@ namespace MR
           void set_fwhm (const float fwhm);
 
           void operator() (Image<float>& input, Image<float>& output) const override;
+          void operator() (vector<Image<float>>& inputs, vector<Image<float>>& outputs) const override;
 
         protected:
+          using block_type = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
           Image<bool> mask_image;
           Matrix::Reader matrix;
           vector<Eigen::Vector3f> fixel_positions;
           float stdev, gaussian_const1, gaussian_const2, threshold;
 
+          // Smoothing kernel in compressed sparse row form
+          vector<size_t> kernel_offsets;
+          vector<index_type> kernel_fixels;
+          vector<float> kernel_weights;
+          vector<float> kernel_sums;
+          // Fixels within the mask, and fixels with no connectivity
+          vector<bool> in_mask, disconnected;
+
+          void compute_kernel();
+          void apply (const block_type& input, block_type& output) const;
+
       };
     //! @}
 
@@ -263,8 +263,11 @@ namespace MR
                                   "Default: l2")
         + Argument ("type").type_choice (linear_robust_estimator_choices)
 
-      // + Option ("rigid_loop_density", "density of gradient descent 1 (batch) to 0.0 (max stochastic) (Default: 1.0)")
-      //   + Argument ("num").type_sequence_float () // TODO
+      + Option ("rigid_loop_density", "density of gradient descent 1 (batch) to 0.0 (max stochastic). "
+        "If less than 1.0, the cost function and its gradient are estimated from a stratified random sample "
+        "of this fraction of the voxels in the midway space, drawn once per scale factor. "
+        "Can be set per scale factor or as a single value used for all scale factors. (Default: 1.0)")
+        + Argument ("num").type_sequence_float ()
 
       // + Option ("rigid_repetitions", " ")
       //   + Argument ("num").type_sequence_int () // TODO
@@ -331,8 +334,11 @@ namespace MR
                                   "Default: l2")
         + Argument ("type").type_choice (linear_robust_estimator_choices)
 
-      // + Option ("affine_loop_density", "density of gradient descent 1 (batch) to 0.0 (max stochastic) (Default: 1.0)")
-      //   + Argument ("num").type_sequence_float () // TODO
+      + Option ("affine_loop_density", "density of gradient descent 1 (batch) to 0.0 (max stochastic). "
+        "If less than 1.0, the cost function and its gradient are estimated from a stratified random sample "
+        "of this fraction of the voxels in the midway space, drawn once per scale factor. "
+        "Can be set per scale factor or as a single value used for all scale factors. (Default: 1.0)")
+        + Argument ("num").type_sequence_float ()
 
       // + Option ("affine_repetitions", " ")
       //   + Argument ("num").type_sequence_int () // TODO
@@ -41,6 +41,7 @@
 #include "math/math.h"
 
 #include "registration/multi_resolution_lmax.h"
+#include "registration/pyramid.h"
 #include "registration/multi_contrast.h"
 
 namespace MR
@@ -210,10 +211,21 @@ namespace MR
           contrasts = mcs;
         }
 
+        // share smoothed multi-resolution images with other registration stages
+        // needs to be set after set_scale_factor
+        void set_pyramids (std::shared_ptr<Pyramid> im1, std::shared_ptr<Pyramid> im2) {
+          im1_pyramid = im1;
+          im2_pyramid = im2;
+          for (const auto& stage : stages) {
+            im1_pyramid->expect (stage.scale_factor);
+            im2_pyramid->expect (stage.scale_factor);
+          }
+        }
+
         void set_loop_density (const vector<default_type>& loop_density_){
           for (size_t d = 0; d < loop_density_.size(); ++d)
-            if (loop_density_[d] < 0.0 or loop_density_[d] > 1.0 )
-              throw Exception ("loop density must be between 0.0 and 1.0");
+            if (loop_density_[d] <= 0.0 or loop_density_[d] > 1.0 )
+              throw Exception ("loop density must be greater than 0.0 and not more than 1.0");
           if (loop_density_.size() == stages.size()) {
             for (size_t i = 0; i < stages.size (); ++i)
               stages[i].loop_density = loop_density_[i];
@@ -417,9 +429,9 @@ namespace MR
                 DEBUG (str(mc));
 
               INFO ("smoothing image 1");
-              auto im1_smoothed = Registration::multi_resolution_lmax (im1_image, stage.scale_factor, do_reorientation, stage_contrasts);
+              auto im1_smoothed = Registration::multi_resolution_lmax (im1_pyramid, im1_image, stage.scale_factor, do_reorientation, stage_contrasts);
               INFO ("smoothing image 2");
-              auto im2_smoothed = Registration::multi_resolution_lmax (im2_image, stage.scale_factor, do_reorientation, stage_contrasts, &stage_contrasts);
+              auto im2_smoothed = Registration::multi_resolution_lmax (im2_pyramid, im2_image, stage.scale_factor, do_reorientation, stage_contrasts, &stage_contrasts);
 
               DEBUG ("after downsampling:");
               for (const auto & mc : stage_contrasts)
@@ -576,6 +588,7 @@ namespace MR
       protected:
         vector<StageSetting> stages;
         vector<MultiContrastSetting> contrasts, stage_contrasts;
+        std::shared_ptr<Pyramid> im1_pyramid, im2_pyramid;
         vector<size_t> kernel_extent;
         default_type grad_tolerance;
         default_type step_tolerance;
@@ -198,16 +198,20 @@ namespace MR
 
               // estimate (params.transformation, metric, params, overall_cost_function, gradient, x, &overlap_count);
               if (params.loop_density < 1.0) {
-                DEBUG ("stochastic gradient descent, density: " + str(params.loop_density));
-                Math::RNG rng;
-                gradient.setZero();
-                auto loop = ThreadedLoop (params.midway_image, 0, 3, 2);
+                if (!samples) {
+                  samples.reset (new SampleSet (params.midway_image, params.loop_density));
+                  DEBUG ("stochastic gradient descent, density: " + str(params.loop_density) + ", samples: " + str(samples->size()));
+                }
                 overlap_count = 0;
-                StochasticThreadKernel <MetricType, ParamType> functor (loop.inner_axes, params.loop_density, metric, params, overall_cost_function, gradient, rng, &overlap_count);
                 {
+                  std::atomic<size_t> next_chunk (0);
+                  SampledThreadKernel<MetricType, ParamType> kernel (*samples, next_chunk, metric, params, overall_cost_function, gradient, &overlap_count);
                   LogLevelLatch log_level (0);
-                  loop.run_outer (functor);
+                  Thread::run (Thread::multi (kernel), "metric sample threads").wait();
                 }
+                // scale to estimate the cost function and gradient over all voxels
+                overall_cost_function *= samples->weight();
+                gradient *= samples->weight();
               } else {
                 overlap_count = 0;
                 ThreadKernel <MetricType, ParamType> kernel (metric, params, overall_cost_function, gradient, &overlap_count);
@@ -258,6 +262,7 @@ namespace MR
             size_t iteration;
             Eigen::MatrixXd directions;
             ssize_t overlap_count;
+            std::shared_ptr<SampleSet> samples;
 
       };
     }
@@ -0,0 +1,107 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __registration_metric_sample_set_h__
+#define __registration_metric_sample_set_h__
+
+#include <numeric>
+
+#include "types.h"
+#include "math/rng.h"
+
+namespace MR
+{
+  namespace Registration
+  {
+    namespace Metric
+    {
+
+      //! A stratified random sample of voxel positions within a 3D image
+      /*! The image is divided into cubic blocks that would each be expected
+       * to hold about one sample at the requested \a density, and voxels are
+       * drawn at random without replacement within each block. This provides
+       * much more uniform coverage of the image than simple random sampling,
+       * and hence a lower variance estimate of the metric for the same number
+       * of samples.
+       *
+       * The voxel indices are stored as separate arrays per axis, in block
+       * order, such that consecutive samples lie close together in memory.
+       * The sample is intended to be drawn once per registration stage, so
+       * that the cost function is consistent between gradient descent
+       * iterations. */
+      class SampleSet { NOMEMALIGN
+        public:
+          template <class HeaderType>
+            SampleSet (const HeaderType& header, const default_type density) :
+              num_voxels (header.size(0) * header.size(1) * header.size(2))
+            {
+              assert (density > 0.0 && density <= 1.0);
+              const ssize_t edge = std::max (ssize_t (1), ssize_t (std::round (std::cbrt (1.0 / density))));
+              Math::RNG rng;
+              std::uniform_real_distribution<default_type> uniform;
+              vector<uint32_t> offsets;
+
+              x.reserve (density * num_voxels + 1);
+              y.reserve (density * num_voxels + 1);
+              z.reserve (density * num_voxels + 1);
+              for (ssize_t k0 = 0; k0 < header.size(2); k0 += edge) {
+                const ssize_t nk = std::min (edge, header.size(2) - k0);
+                for (ssize_t j0 = 0; j0 < header.size(1); j0 += edge) {
+                  const ssize_t nj = std::min (edge, header.size(1) - j0);
+                  for (ssize_t i0 = 0; i0 < header.size(0); i0 += edge) {
+                    const ssize_t ni = std::min (edge, header.size(0) - i0);
+
+                    // number of samples in this block, rounded stochastically
+                    const default_type expected = density * ni * nj * nk;
+                    size_t n = std::floor (expected);
+                    if (uniform (rng) < expected - n)
+                      ++n;
+                    if (!n)
+                      continue;
+
+                    // partial Fisher-Yates shuffle of the voxels in this block
+                    offsets.resize (ni * nj * nk);
+                    std::iota (offsets.begin(), offsets.end(), 0);
+                    for (size_t s = 0; s != n; ++s)
+                      std::swap (offsets[s], offsets[s + std::uniform_int_distribution<size_t> (0, offsets.size()-s-1) (rng)]);
+                    std::sort (offsets.begin(), offsets.begin() + n);
+
+                    for (size_t s = 0; s != n; ++s) {
+                      x.push_back (i0 + offsets[s] % ni);
+                      y.push_back (j0 + (offsets[s] / ni) % nj);
+                      z.push_back (k0 + offsets[s] / (ni * nj));
+                    }
+                  }
+                }
+              }
+            }
+
+          size_t size () const { return x.size(); }
+
+          //! the factor by which sums over the sample must be scaled to estimate sums over the whole image
+          default_type weight () const { return size() ? default_type (num_voxels) / size() : 0.0; }
+
+          vector<uint32_t> x, y, z;
+
+        protected:
+          const size_t num_voxels;
+      };
+
+    }
+  }
+}
+
+#endif
@@ -17,11 +17,12 @@
 #ifndef __registration_metric_threadkernel_h__
 #define __registration_metric_threadkernel_h__
 
+#include <atomic>
+
 #include "image.h"
 #include "algo/iterator.h"
 #include "transform.h"
-#include "algo/random_threaded_loop.h"
-#include "algo/random_loop.h"
+#include "registration/metric/sample_set.h"
 
 namespace MR
 {
@@ -327,61 +328,47 @@ namespace MR
             // MR::Transform transform;
       };
 
+      //! Evaluate the metric over a precomputed sample of midway voxels
+      /*! Each thread repeatedly claims the next chunk of samples from the
+       * shared counter \a next_chunk, and accumulates the cost and gradient
+       * over these samples using ThreadKernel, such that all metrics that can
+       * be evaluated voxel-wise are supported. This is intended to be run via
+       * Thread::run (Thread::multi (...)). */
       template <class MetricType, class ParamType>
-      struct StochasticThreadKernel { MEMALIGN(StochasticThreadKernel)
+      class SampledThreadKernel { MEMALIGN(SampledThreadKernel)
         public:
-          StochasticThreadKernel (
-              const vector<size_t>& inner_axes,
-              const default_type density,
+          SampledThreadKernel (
+              const SampleSet& samples,
+              std::atomic<size_t>& next_chunk,
               const MetricType& metric,
               const ParamType& parameters,
               Eigen::VectorXd& overall_cost_function,
               Eigen::VectorXd& overall_grad,
-              Math::RNG& rng_engine,
               ssize_t* overlap_count = nullptr) :
-            inner_axes (inner_axes),
-            density (density),
-            metric (metric),
-            params (parameters),
-            cost_function (overall_cost_function.size()),
-            gradient (overall_grad.size()),
-            overall_cost_function (overall_cost_function),
-            overall_gradient (overall_grad),
-            rng (rng_engine),
-            overlap_count (overlap_count)  {
-              gradient.setZero();
-              cost_function.setZero();
-              assert(inner_axes.size() >= 2);
-              assert(overall_cost_function.size() == 1);
+            samples (samples),
+            next_chunk (next_chunk),
+            kernel (metric, parameters, overall_cost_function, overall_grad, overlap_count),
+            iter (parameters.midway_image) { }
+
+          void execute () {
+            size_t chunk;
+            while ((chunk = next_chunk++) * chunk_size < samples.size()) {
+              const size_t end = std::min ((chunk+1) * chunk_size, samples.size());
+              for (size_t n = chunk * chunk_size; n != end; ++n) {
+                iter.index(0) = samples.x[n];
+                iter.index(1) = samples.y[n];
+                iter.index(2) = samples.z[n];
+                kernel (iter);
+              }
             }
-
-          ~StochasticThreadKernel () {
-            overall_cost_function += cost_function;
-            overall_gradient += gradient;
           }
 
-          void operator() (const Iterator& iter) {
-            auto engine = std::default_random_engine{static_cast<std::default_random_engine::result_type>(rng.get_seed())};
-            auto kern = ThreadKernel<MetricType, ParamType> (metric, params, cost_function, gradient, overlap_count);
-            Iterator iterator (iter);
-            assign_pos_of(iter).to(iterator);
-            auto inner_loop = Random_loop<Iterator, std::default_random_engine>(iterator, engine, inner_axes[1], (float) iterator.size(inner_axes[1]) * density);
-            for (auto j = inner_loop; j; ++j)
-              for (auto k = Loop (inner_axes[0]) (iterator); k; ++k) {
-                kern (iterator);
-              }
-          }
         protected:
-          vector<size_t> inner_axes;
-          default_type density;
-          MetricType metric;
-          ParamType params;
-          Eigen::VectorXd cost_function;
-          Eigen::VectorXd gradient;
-          Eigen::VectorXd& overall_cost_function;
-          Eigen::VectorXd& overall_gradient;
-          Math::RNG rng;
-          ssize_t* overlap_count;
+          static constexpr size_t chunk_size = 1024;
+          const SampleSet& samples;
+          std::atomic<size_t>& next_chunk;
+          ThreadKernel<MetricType, ParamType> kernel;
+          Iterator iter;
       };
     }
   }
@@ -27,6 +27,16 @@ namespace MR
   namespace Registration
   {
 
+    //! the Gaussian smoothing (in mm along each spatial axis) applied to \a input for \a scale_factor
+    template <class HeaderType>
+    FORCE_INLINE vector<default_type> multi_resolution_stdev (const HeaderType& input, const default_type scale_factor)
+    {
+      vector<default_type> stdev (3);
+      for (size_t dim = 0; dim < 3; ++dim)
+        stdev[dim] = input.spacing(dim) / (2.0 * scale_factor);
+      return stdev;
+    }
+
     template <class ImageType>
     FORCE_INLINE ImageType multi_resolution_lmax (ImageType& input,
                                                   const default_type scale_factor,
@@ -41,11 +51,7 @@ namespace MR
         size[3] = Math::SH::NforL (lmax);
       Adapter::Subset<ImageType> subset (input, from, size);
       Filter::Smooth smooth_filter (subset);
-      vector<default_type> stdev(3);
-      for (size_t dim = 0; dim < 3; ++dim)
-        stdev[dim] = input.spacing(dim) / (2.0 * scale_factor);
-
-      smooth_filter.set_stdev (stdev);
+      smooth_filter.set_stdev (multi_resolution_stdev (input, scale_factor));
       DEBUG ("creating scratch image for smoothing input image...");
       auto smoothed = ImageType::scratch (smooth_filter);
       threaded_copy (subset, smoothed);
@@ -78,11 +84,7 @@ namespace MR
       Adapter::Extract1D<ImageType> subset (input, 3, volume_indices);
 
       Filter::Smooth smooth_filter (subset);
-      vector<default_type> stdev(3);
-      for (size_t dim = 0; dim < 3; ++dim)
-        stdev[dim] = input.spacing(dim) / (2.0 * scale_factor);
-
-      smooth_filter.set_stdev (stdev);
+      smooth_filter.set_stdev (multi_resolution_stdev (input, scale_factor));
       DEBUG ("creating scratch image for smoothing input image...");
       auto smoothed = ImageType::scratch (smooth_filter);
       threaded_copy (subset, smoothed);
@@ -33,6 +33,7 @@
 #include "registration/metric/cc_helper.h"
 #include "registration/metric/demons4D.h"
 #include "registration/multi_resolution_lmax.h"
+#include "registration/pyramid.h"
 #include "math/average_space.h"
 #include "registration/multi_contrast.h"
 
@@ -146,8 +147,8 @@ namespace MR
               for (const auto & mc : stage_contrasts)
                 DEBUG (str(mc));
 
-              auto im1_smoothed = Registration::multi_resolution_lmax (im1_image, scale_factor[level], do_reorientation, stage_contrasts);
-              auto im2_smoothed = Registration::multi_resolution_lmax (im2_image, scale_factor[level], do_reorientation, stage_contrasts, &stage_contrasts);
+              auto im1_smoothed = Registration::multi_resolution_lmax (im1_pyramid, im1_image, scale_factor[level], do_reorientation, stage_contrasts);
+              auto im2_smoothed = Registration::multi_resolution_lmax (im2_pyramid, im2_image, scale_factor[level], do_reorientation, stage_contrasts, &stage_contrasts);
 
               for (const auto & mc : stage_contrasts)
                 INFO (str(mc));
@@ -200,6 +201,10 @@ namespace MR
                 }
               }
 
+              // deformation fields are fully overwritten on every iteration, so are allocated once per level
+              auto im1_deform_field = Image<default_type>::scratch (field_header);
+              auto im2_deform_field = Image<default_type>::scratch (field_header);
+
               ssize_t iteration = 1;
               default_type grad_step_altered = gradient_step * (field_header.spacing(0) + field_header.spacing(1) + field_header.spacing(2)) / 3.0;
               default_type cost = std::numeric_limits<default_type>::max();
@@ -208,15 +213,14 @@ namespace MR
               while (!converged) {
                 if (iteration > 1) {
                   DEBUG ("smoothing update fields");
+                  // for large kernels, smoothing is performed in the frequency domain
                   Filter::Smooth smooth_filter (*im1_update);
                   smooth_filter.set_stdev (update_smoothing_mm);
+                  smooth_filter.set_fft (true);
                   smooth_filter (*im1_update);
                   smooth_filter (*im2_update);
                 }
 
-                Image<default_type> im1_deform_field = Image<default_type>::scratch (field_header);
-                Image<default_type> im2_deform_field = Image<default_type>::scratch (field_header);
-
                 if (iteration > 1) {
                   DEBUG ("updating displacement field");
                   Warp::update_displacement_scaling_and_squaring (*im1_to_mid, *im1_update, *im1_to_mid_new, grad_step_altered);
@@ -226,6 +230,7 @@ namespace MR
                   Filter::Smooth smooth_filter (*im1_to_mid_new);
                   smooth_filter.set_stdev (disp_smoothing_mm);
                   smooth_filter.set_zero_boundary (true);
+                  smooth_filter.set_fft (true);
                   smooth_filter (*im1_to_mid_new);
                   smooth_filter (*im2_to_mid_new);
 
@@ -440,6 +445,18 @@ namespace MR
             contrasts = mcs;
           }
 
+          // share smoothed multi-resolution images with other registration stages
+          // needs to be set after initialise and set_scale_factor
+          void set_pyramids (std::shared_ptr<Pyramid> im1, std::shared_ptr<Pyramid> im2) {
+            im1_pyramid = im1;
+            im2_pyramid = im2;
+            // if initialised, only the full resolution level is used
+            for (auto s : is_initialised ? vector<default_type> (1, 1.0) : scale_factor) {
+              im1_pyramid->expect (s);
+              im2_pyramid->expect (s);
+            }
+          }
+
           ssize_t get_lmax () {
             return (ssize_t) *std::max_element(fod_lmax.begin(), fod_lmax.end());
           }
@@ -565,6 +582,7 @@ namespace MR
           Header midway_image_header;
 
           vector<MultiContrastSetting> contrasts, stage_contrasts;
+          std::shared_ptr<Pyramid> im1_pyramid, im2_pyramid;
 
           // Internally the warp is stored as a displacement field to enable easy smoothing near the boundaries
           std::shared_ptr<Image<default_type> > im1_to_mid_new;
@@ -0,0 +1,241 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "registration/pyramid.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+#include "adapter/extract.h"
+#include "algo/loop.h"
+#include "algo/threaded_copy.h"
+#include "app.h"
+#include "file/path.h"
+#include "file/utils.h"
+
+namespace MR
+{
+  namespace Registration
+  {
+
+    namespace
+    {
+      // 64-bit FNV-1a hash
+      class Hash { NOMEMALIGN
+        public:
+          template <typename T>
+            void operator() (const T& value) {
+              const uint8_t* p = reinterpret_cast<const uint8_t*> (&value);
+              for (size_t n = 0; n != sizeof (T); ++n) {
+                hash ^= p[n];
+                hash *= 1099511628211ULL;
+              }
+            }
+          uint64_t hash = 14695981039346656037ULL;
+      };
+
+      std::string hex (const uint64_t value)
+      {
+        std::ostringstream stream;
+        stream << std::hex << std::setfill ('0') << std::setw (16) << value;
+        return stream.str();
+      }
+    }
+
+
+
+    Pyramid::Pyramid (Image<default_type>& input, const std::string& cache_dir) :
+      input (input),
+      cache_dir (cache_dir),
+      input_hash (0)
+    {
+      if (cache_dir.empty())
+        return;
+      Hash hash;
+      for (size_t n = 0; n != input.ndim(); ++n) {
+        hash (input.size (n));
+        hash (input.spacing (n));
+      }
+      for (ssize_t i = 0; i != 3; ++i)
+        for (ssize_t j = 0; j != 4; ++j)
+          hash (input.transform() (i,j));
+      for (auto l = Loop (input) (input); l; ++l)
+        hash (default_type (input.value()));
+      input_hash = hash.hash;
+      DEBUG ("registration pyramid cache key for image \"" + input.name() + "\": " + hex (input_hash));
+    }
+
+
+
+    Image<default_type> Pyramid::get (const default_type scale_factor,
+                                      const bool do_reorientation,
+                                      const vector<MultiContrastSetting>& contrast,
+                                      vector<MultiContrastSetting>* contrast_updated)
+    {
+      vector<uint32_t> volumes;
+      for (const auto& mc : contrast) {
+        assert (mc.nvols > 0);
+        for (size_t i = 0; i < mc.nvols; i++)
+          volumes.push_back (mc.start + i);
+      }
+
+      // only retain images for this scale factor if they will be requested again
+      auto remaining = expected.find (scale_factor);
+      if (remaining != expected.end() && remaining->second)
+        --remaining->second;
+      const bool retain = remaining != expected.end() && remaining->second;
+
+      Image<default_type> smoothed;
+      for (const auto& level : levels) {
+        if (level.scale_factor != scale_factor)
+          continue;
+        if (level.volumes == volumes) {
+          DEBUG ("using cached smoothed image for scale factor " + str(scale_factor));
+          smoothed = level.image;
+          break;
+        }
+        if (input.ndim() > 3 && std::all_of (volumes.begin(), volumes.end(), [&] (uint32_t v) {
+              return std::find (level.volumes.begin(), level.volumes.end(), v) != level.volumes.end(); })) {
+          DEBUG ("extracting volumes from cached smoothed image for scale factor " + str(scale_factor));
+          smoothed = extract (level, volumes);
+          break;
+        }
+      }
+
+      if (!smoothed.valid()) {
+        std::string path;
+        if (cache_dir.size()) {
+          path = cache_path (scale_factor, volumes);
+          if (Path::exists (path))
+            smoothed = load (path, volumes);
+        }
+        if (!smoothed.valid()) {
+          smoothed = multi_resolution_lmax (input, scale_factor, do_reorientation, contrast);
+          if (path.size())
+            save (smoothed, path);
+        }
+        if (retain)
+          levels.push_back ({ scale_factor, volumes, smoothed });
+      }
+
+      if (!retain) {
+        // the image returned remains valid for as long as the caller holds it
+        levels.erase (std::remove_if (levels.begin(), levels.end(), [&] (const Level& level) {
+              return level.scale_factor == scale_factor; }), levels.end());
+      }
+
+      // adjust start index to be relative to subset
+      if (contrast_updated) {
+        size_t start = 0;
+        for (size_t ic = 0; ic < contrast.size(); ic++) {
+          const size_t nvols = contrast[ic].nvols;
+          (*contrast_updated)[ic].start = start;
+          start += nvols;
+        }
+      }
+      return smoothed;
+    }
+
+
+
+    Image<default_type> Pyramid::extract (const Level& level, const vector<uint32_t>& volumes) const
+    {
+      vector<uint32_t> indices;
+      for (auto v : volumes)
+        indices.push_back (std::find (level.volumes.begin(), level.volumes.end(), v) - level.volumes.begin());
+      Adapter::Extract1D<Image<default_type>> subset (level.image, 3, indices);
+      auto result = Image<default_type>::scratch (subset);
+      threaded_copy (subset, result);
+      return result;
+    }
+
+
+
+    std::string Pyramid::cache_path (const default_type scale_factor, const vector<uint32_t>& volumes) const
+    {
+      Hash hash;
+      hash (scale_factor);
+      for (auto v : volumes)
+        hash (v);
+      // cache files written by a different implementation of the smoothing
+      // filter, or with different smoothing, must not be reused
+      for (auto s : multi_resolution_stdev (input, scale_factor))
+        hash (s);
+      for (const char* c = App::mrtrix_version; *c; ++c)
+        hash (*c);
+      return Path::join (cache_dir, "pyramid-" + hex (input_hash) + "-" + hex (hash.hash) + ".mif");
+    }
+
+
+
+    Image<default_type> Pyramid::load (const std::string& path, const vector<uint32_t>& volumes) const
+    {
+      try {
+        auto cached = Image<default_type>::open (path);
+        bool match = cached.ndim() == input.ndim();
+        for (size_t n = 0; match && n != 3; ++n)
+          match = cached.size (n) == input.size (n);
+        if (match && input.ndim() > 3)
+          match = cached.size (3) == ssize_t (volumes.size());
+        if (!match) {
+          WARN ("ignoring pyramid cache file \"" + path + "\" with unexpected dimensions");
+          return Image<default_type>();
+        }
+        INFO ("loading smoothed image from pyramid cache file \"" + path + "\"");
+        auto smoothed = Image<default_type>::scratch (cached);
+        threaded_copy (cached, smoothed);
+        return smoothed;
+      }
+      catch (Exception& e) {
+        e.display (2);
+        WARN ("error reading pyramid cache file \"" + path + "\"");
+        return Image<default_type>();
+      }
+    }
+
+
+
+    void Pyramid::save (Image<default_type>& smoothed, const std::string& path) const
+    {
+      // write to a temporary file first, so that concurrent runs sharing the
+      // same cache directory never see an incomplete file
+      std::string temp = path.substr (0, path.size() - 4) + "-tmp-XXXXXX.mif";
+      for (size_t n = temp.size() - 10; n != temp.size() - 4; ++n)
+        temp[n] = File::random_char();
+      try {
+        Header header (smoothed);
+        header.datatype() = DataType::Float64;
+        header.datatype().set_byte_order_native();
+        {
+          auto out = Image<default_type>::create (temp, header);
+          threaded_copy (smoothed, out);
+        }
+        if (std::rename (temp.c_str(), path.c_str()))
+          throw Exception ("error renaming file \"" + temp + "\" to \"" + path + "\": " + strerror (errno));
+        INFO ("smoothed image written to pyramid cache file \"" + path + "\"");
+      }
+      catch (Exception& e) {
+        e.display (2);
+        WARN ("unable to write pyramid cache file \"" + path + "\"");
+        if (Path::exists (temp))
+          File::remove (temp);
+      }
+    }
+
+  }
+}
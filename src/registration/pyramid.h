@@ -0,0 +1,113 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#ifndef __registration_pyramid_h__
+#define __registration_pyramid_h__
+
+#include <map>
+
+#include "image.h"
+#include "types.h"
+#include "registration/multi_contrast.h"
+#include "registration/multi_resolution_lmax.h"
+
+namespace MR
+{
+  namespace Registration
+  {
+
+    //! Cache of the smoothed multi-resolution images of a registration input
+    /*! Each resolution level and set of contrast volumes is smoothed only
+     * once, and can then be shared by all registration stages (rigid, affine
+     * and non-linear) that make use of it. A request for a subset of the
+     * volumes of an existing level is served by extracting these volumes,
+     * since the smoothing is applied independently to each volume.
+     *
+     * Each registration stage declares the scale factors it will request
+     * via expect(); a smoothed image is only retained in memory while
+     * further requests for its scale factor are expected, and is otherwise
+     * released once the stage that requested it has finished with it.
+     *
+     * If a cache directory is provided, smoothed images are also stored
+     * there, keyed by a hash of the input image data and geometry, the
+     * smoothing applied and the MRtrix3 version, such that subsequent runs
+     * on the same input (e.g. registration of many subjects to a common
+     * template) can load rather than recompute them. */
+    class Pyramid { MEMALIGN(Pyramid)
+      public:
+        Pyramid (Image<default_type>& input, const std::string& cache_dir = std::string());
+
+        //! get the input image smoothed for \a scale_factor, as for multi_resolution_lmax()
+        Image<default_type> get (const default_type scale_factor,
+                                 const bool do_reorientation,
+                                 const vector<MultiContrastSetting>& contrast,
+                                 vector<MultiContrastSetting>* contrast_updated = nullptr);
+
+        //! declare that get() will be called (once more) for \a scale_factor
+        void expect (const default_type scale_factor) { ++expected[scale_factor]; }
+
+        const Image<default_type>& image () const { return input; }
+
+      protected:
+        class Level { MEMALIGN(Level)
+          public:
+            default_type scale_factor;
+            vector<uint32_t> volumes;
+            Image<default_type> image;
+        };
+
+        Image<default_type> input;
+        const std::string cache_dir;
+        uint64_t input_hash;
+        vector<Level> levels;
+        std::map<default_type, size_t> expected;
+
+        Image<default_type> extract (const Level& level, const vector<uint32_t>& volumes) const;
+        std::string cache_path (const default_type scale_factor, const vector<uint32_t>& volumes) const;
+        Image<default_type> load (const std::string& path, const vector<uint32_t>& volumes) const;
+        void save (Image<default_type>& smoothed, const std::string& path) const;
+    };
+
+
+
+    //! smooth \a input for \a scale_factor, via \a pyramid if provided
+    template <class ImageType>
+      FORCE_INLINE ImageType multi_resolution_lmax (const std::shared_ptr<Pyramid>&,
+                                                    ImageType& input,
+                                                    const default_type scale_factor,
+                                                    const bool do_reorientation,
+                                                    const vector<MultiContrastSetting>& contrast,
+                                                    vector<MultiContrastSetting>* contrast_updated = nullptr)
+      {
+        return multi_resolution_lmax (input, scale_factor, do_reorientation, contrast, contrast_updated);
+      }
+
+    FORCE_INLINE Image<default_type> multi_resolution_lmax (const std::shared_ptr<Pyramid>& pyramid,
+                                                            Image<default_type>& input,
+                                                            const default_type scale_factor,
+                                                            const bool do_reorientation,
+                                                            const vector<MultiContrastSetting>& contrast,
+                                                            vector<MultiContrastSetting>* contrast_updated = nullptr)
+    {
+      if (!pyramid)
+        return multi_resolution_lmax (input, scale_factor, do_reorientation, contrast, contrast_updated);
+      assert (dimensions_match (pyramid->image(), input));
+      return pyramid->get (scale_factor, do_reorientation, contrast, contrast_updated);
+    }
+
+  }
+}
+#endif
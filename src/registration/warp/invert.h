@@ -32,93 +32,135 @@ namespace MR
 
       namespace {
 
-
-      class DisplacementThreadKernel { MEMALIGN(DisplacementThreadKernel)
-
-        public:
-          DisplacementThreadKernel (Image<default_type> & displacement,
-                        Image<default_type> & displacement_inverse,
-                        const size_t max_iter,
-                        const default_type error_tol) :
-                          displacement (displacement),
-                          transform (displacement_inverse),
-                          max_iter (max_iter),
-                          error_tolerance (error_tol) {}
-
-          void operator() (Image<default_type>& displacement_inverse)
-          {
-            Eigen::Vector3 voxel ((default_type)displacement_inverse.index(0), (default_type)displacement_inverse.index(1), (default_type)displacement_inverse.index(2));
-            Eigen::Vector3 truth = transform.voxel2scanner * voxel;
-            Eigen::Vector3 current = truth + Eigen::Vector3(displacement_inverse.row(3));
-
-            size_t iter = 0;
-            default_type error = std::numeric_limits<default_type>::max();
-            while (iter < max_iter && error > error_tolerance) {
-              error = update (current, truth);
-              ++iter;
-            }
-            displacement_inverse.row(3) = current - truth;
-          }
-
-        private:
-
-          default_type update (Eigen::Vector3& current, const Eigen::Vector3& truth)
-          {
-            displacement.scanner (current);
-            Eigen::Vector3 discrepancy = truth - (current + Eigen::Vector3 (displacement.row(3)));
-            current += discrepancy;
-            return discrepancy.dot (discrepancy);
-          }
-
-          Interp::Linear<Image<default_type> > displacement;
-          MR::Transform transform;
-          const size_t max_iter;
-          default_type error_tolerance;
-      };
-
-
-        class DeformationThreadKernel { MEMALIGN(DeformationThreadKernel)
+        // Fixed-point inversion of a warp field, processing each slice one
+        // scanline (along axis 0) at a time. All voxels of a scanline are
+        // iterated together using batched interpolation, and each voxel
+        // starts from whichever is closer to the solution of its own initial
+        // estimate, and the converged estimate of its neighbour on the
+        // previous scanline (shifted by the distance between the two voxels).
+        class InvertKernel { MEMALIGN(InvertKernel)
 
           public:
-            DeformationThreadKernel (Image<default_type> & deform,
-                          Image<default_type> & inv_deform,
+            InvertKernel (Image<default_type>& warp,
+                          Image<default_type>& inverse,
+                          const bool is_displacement,
                           const size_t max_iter,
                           const default_type error_tol) :
-                            deform (deform),
-                            transform (inv_deform),
+                            warp (warp),
+                            inverse (inverse),
+                            transform (inverse),
+                            is_displacement (is_displacement),
                             max_iter (max_iter),
                             error_tolerance (error_tol) {}
 
-            void operator() (Image<default_type>& inv_deform)
+            void operator() (const Iterator& pos)
             {
-              Eigen::Vector3 voxel ((default_type)inv_deform.index(0), (default_type)inv_deform.index(1), (default_type)inv_deform.index(2));
-              Eigen::Vector3 truth = transform.voxel2scanner * voxel;
-              Eigen::Vector3 current = inv_deform.row(3);
-
-              size_t iter = 0;
-              default_type error = std::numeric_limits<default_type>::max();
-              while (iter < max_iter && error > error_tolerance) {
-                error = update (current, truth);
-                ++iter;
+              assign_pos_of (pos, 2, 3).to (inverse);
+              const ssize_t nx = inverse.size(0);
+              truth.resize (3, nx);
+              current.resize (3, nx);
+              for (inverse.index(1) = 0; inverse.index(1) < inverse.size(1); ++inverse.index(1)) {
+                for (inverse.index(0) = 0; inverse.index(0) < nx; ++inverse.index(0)) {
+                  const ssize_t x = inverse.index(0);
+                  truth.col(x) = transform.voxel2scanner * Eigen::Vector3 (x, inverse.index(1), inverse.index(2));
+                  current.col(x) = inverse.row(3);
+                  if (is_displacement)
+                    current.col(x) += truth.col(x);
+                }
+
+                // first iteration: where the initial estimate has not yet
+                // converged, start instead from the neighbour's solution if
+                // that is closer
+                discrepancy (current, truth, update);
+                error = update.colwise().squaredNorm().transpose();
+                active.clear();
+                if (inverse.index(1) > 0) {
+                  for (ssize_t x = 0; x < nx; ++x)
+                    if (!(error[x] <= error_tolerance))
+                      active.push_back (x);
+                  subset_current.resize (3, active.size());
+                  subset_truth.resize (3, active.size());
+                  for (size_t n = 0; n < active.size(); ++n) {
+                    subset_current.col(n) = previous.col (active[n]) + truth.col (active[n]) - previous_truth.col (active[n]);
+                    subset_truth.col(n) = truth.col (active[n]);
+                  }
+                  discrepancy (subset_current, subset_truth, seed_update);
+                  for (size_t n = 0; n < active.size(); ++n) {
+                    const ssize_t x = active[n];
+                    const default_type seed_error = seed_update.col(n).squaredNorm();
+                    if (seed_error < error[x] || (std::isnan (error[x]) && !std::isnan (seed_error))) {
+                      current.col(x) = subset_current.col(n);
+                      update.col(x) = seed_update.col(n);
+                      error[x] = seed_error;
+                    }
+                  }
+                }
+                current += update;
+
+                active.clear();
+                for (ssize_t x = 0; x < nx; ++x)
+                  if (error[x] > error_tolerance)
+                    active.push_back (x);
+
+                for (size_t iter = 1; iter < max_iter && active.size(); ++iter) {
+                  subset_current.resize (3, active.size());
+                  subset_truth.resize (3, active.size());
+                  for (size_t n = 0; n < active.size(); ++n) {
+                    subset_current.col(n) = current.col (active[n]);
+                    subset_truth.col(n) = truth.col (active[n]);
+                  }
+                  discrepancy (subset_current, subset_truth, update);
+                  size_t remaining = 0;
+                  for (size_t n = 0; n < active.size(); ++n) {
+                    current.col (active[n]) += update.col(n);
+                    if (update.col(n).squaredNorm() > error_tolerance)
+                      active[remaining++] = active[n];
+                  }
+                  active.resize (remaining);
+                }
+
+                for (inverse.index(0) = 0; inverse.index(0) < nx; ++inverse.index(0)) {
+                  const ssize_t x = inverse.index(0);
+                  if (is_displacement)
+                    inverse.row(3) = current.col(x) - truth.col(x);
+                  else
+                    inverse.row(3) = current.col(x);
+                }
+                previous = current;
+                previous_truth = truth;
               }
-              inv_deform.row(3) = current;
             }
 
           private:
+            using positions_type = Eigen::Matrix<default_type, 3, Eigen::Dynamic>;
 
-            default_type update (Eigen::Vector3& current, const Eigen::Vector3& truth)
+            // the update towards the solution for each position
+            void discrepancy (const positions_type& positions, const positions_type& target, positions_type& result)
             {
-              deform.scanner (current);
-              Eigen::Vector3 discrepancy = truth - Eigen::Vector3 (deform.row(3));
-              current += discrepancy;
-              return discrepancy.dot (discrepancy);
+              warp.scanner_rows (positions, result);
+              if (is_displacement)
+                result += positions;
+              result = target - result;
             }
 
-            Interp::Linear<Image<default_type> > deform;
+            Interp::Linear<Image<default_type>> warp;
+            Image<default_type> inverse;
             MR::Transform transform;
+            const bool is_displacement;
             const size_t max_iter;
-            default_type error_tolerance;
+            const default_type error_tolerance;
+            positions_type truth, current, update, seed_update, previous, previous_truth, subset_current, subset_truth;
+            Eigen::Array<default_type, Eigen::Dynamic, 1> error;
+            vector<ssize_t> active;
         };
+
+
+        FORCE_INLINE void invert (const std::string& message, Image<default_type>& warp, Image<default_type>& inverse,
+                                  const bool is_displacement, const size_t max_iter, const default_type error_tolerance)
+        {
+          ThreadedLoop (message, inverse, { 2 }, { 0, 1 })
+            .run_outer (InvertKernel (warp, inverse, is_displacement, max_iter, error_tolerance));
+        }
       }
 
 
@@ -136,8 +178,7 @@ namespace MR
             if (!is_initialised)
               displacement2deformation (inv_deform_field, inv_deform_field);
 
-            ThreadedLoop ("inverting warp field...", inv_deform_field, 0, 3)
-              .run (DeformationThreadKernel (deform_field, inv_deform_field, max_iter, error_tolerance), inv_deform_field);
+            invert ("inverting warp field...", deform_field, inv_deform_field, false, max_iter, error_tolerance);
           }
 
           /*! Estimate the inverse of a displacement field, output the inverse as a deformation field
@@ -160,8 +201,7 @@ namespace MR
             check_dimensions (disp_field, inv_disp_field);
             error_tolerance *= (disp_field.spacing(0) + disp_field.spacing(1) + disp_field.spacing(2)) / 3;
 
-            ThreadedLoop ("inverting displacement field...", inv_disp_field, 0, 3)
-              .run (DisplacementThreadKernel (disp_field, inv_disp_field, max_iter, error_tolerance), inv_disp_field);
+            invert ("inverting displacement field...", disp_field, inv_disp_field, true, max_iter, error_tolerance);
           }
 
 
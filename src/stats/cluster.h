@@ -55,6 +55,13 @@ namespace MR
           }
 
           void operator() (in_column_type, const value_type, out_column_type) const override;
+
+          bool operator() (in_column_type in, const vector<value_type>& heights, const value_type E, const value_type H, out_column_type out) const override {
+            // Filter::Connector compares against a single-precision threshold
+            Stats::TFCE::integrate_clusters (connector.adjacency, in, heights, E, H,
+                [] (const value_type stat, const value_type h) { return stat > float(h); }, out);
+            return true;
+          }
       };
       //! @}
 
@@ -58,9 +58,9 @@ namespace MR
 
       bool PreProcessor::operator() (const Math::Stats::Shuffle& shuffle)
       {
-        if (!shuffle.data.rows())
+        if (!shuffle.rows())
           return false;
-        (*stats_calculator) (shuffle.data, stats);
+        (*stats_calculator) (shuffle, stats);
         (*enhancer) (stats, enhanced_stats);
         for (size_t ih = 0; ih != stats_calculator->num_hypotheses(); ++ih) {
           for (size_t ie = 0; ie != stats_calculator->num_elements(); ++ie) {
@@ -115,7 +115,7 @@ namespace MR
 
       bool Processor::operator() (const Math::Stats::Shuffle& shuffle)
       {
-        (*stats_calculator) (shuffle.data, statistics);
+        (*stats_calculator) (shuffle, statistics);
         if (enhancer)
           (*enhancer) (statistics, enhanced_statistics);
         else
@@ -190,7 +190,7 @@ namespace MR
         output_statistics.resize (stats_calculator->num_elements(), stats_calculator->num_hypotheses());
         output_zstats    .resize (stats_calculator->num_elements(), stats_calculator->num_hypotheses());
         output_enhanced  .resize (stats_calculator->num_elements(), stats_calculator->num_hypotheses());
-        const matrix_type default_shuffle (matrix_type::Identity (stats_calculator->num_inputs(), stats_calculator->num_inputs()));
+        const Math::Stats::Shuffle default_shuffle (stats_calculator->num_inputs());
         ++progress;
 
         (*stats_calculator) (default_shuffle, output_statistics, output_zstats);
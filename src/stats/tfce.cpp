@@ -45,8 +45,18 @@ namespace MR
 
       void Wrapper::operator() (in_column_type in, out_column_type out) const
       {
-        out.setZero();
         const value_type max_input_value = in.maxCoeff();
+        // With a zero extent exponent, elements outside of any cluster
+        //   still contribute at every height; leave this to the explicit loop
+        if (E > 0.0) {
+          vector<value_type> heights;
+          for (value_type h = dH; (h-dH) < max_input_value; h += dH)
+            heights.push_back (h);
+          if ((*enhancer) (in, heights, E, H, out))
+            return;
+        }
+
+        out.setZero();
         for (value_type h = dH; (h-dH) < max_input_value; h += dH) {
           matrix_type temp (in.size(), 1);
           (*enhancer) (in, h, temp.col(0));
@@ -49,12 +49,48 @@ namespace MR
           // Alternative functor that also takes the threshold value;
           //   makes TFCE integration cleaner
           virtual void operator() (in_column_type /*input_statistics*/, const value_type /*threshold*/, out_column_type /*enhanced_statistics*/) const = 0;
+          // Optional functor that performs the complete TFCE integration in a
+          //   single pass; derived classes that can do so should return true
+          virtual bool operator() (in_column_type /*input_statistics*/, const vector<value_type>& /*heights*/,
+                                   const value_type /*E*/, const value_type /*H*/, out_column_type /*enhanced_statistics*/) const { return false; }
           friend class Wrapper;
       };
 
 
 
 
+      /** \addtogroup Statistics
+      @{ */
+      /*! Perform TFCE integration of cluster extent over all thresholds in a
+       * single pass.
+       *
+       * Rather than running connected components anew at each height,
+       * elements are added in order of descending statistic value, and
+       * clusters are merged using a union-find structure as the threshold
+       * is lowered. The contribution of each cluster is accumulated at its
+       * root over the range of heights during which its extent remains
+       * constant, with the offsets stored along the union-find tree
+       * ensuring that each element only receives the contributions of
+       * those clusters it was a member of.
+       *
+       * \a adjacency must provide, for each element, the list of indices of
+       * adjacent elements via operator[]. An element is considered part of
+       * the supra-threshold region at height \a h if \a above (statistic,
+       * \a h) returns true; this must be consistent with the thresholding
+       * performed by the per-threshold enhancer. Non-finite statistics
+       * never contribute. */
+      template <class AdjacencyType, class CompareType>
+      void integrate_clusters (const AdjacencyType& adjacency,
+                               matrix_type::ConstColXpr input,
+                               const vector<value_type>& heights,
+                               const value_type E,
+                               const value_type H,
+                               CompareType&& above,
+                               matrix_type::ColXpr output);
+      //! @}
+
+
+
       class Wrapper : public Stats::EnhancerBase
       { MEMALIGN (Wrapper)
         public:
@@ -79,6 +115,120 @@ namespace MR
 
 
 
+
+      template <class AdjacencyType, class CompareType>
+      void integrate_clusters (const AdjacencyType& adjacency,
+                               matrix_type::ConstColXpr input,
+                               const vector<value_type>& heights,
+                               const value_type E,
+                               const value_type H,
+                               CompareType&& above,
+                               matrix_type::ColXpr output)
+      {
+        using index_t = uint32_t;
+        const index_t num_elements = input.size();
+        const ssize_t num_heights = heights.size();
+        output.setZero();
+
+        // Weight of each height, and cumulative weight of all heights from
+        //   a given index upwards
+        vector<value_type> cumulative (num_heights+1, value_type(0));
+        for (ssize_t level = num_heights-1; level >= 0; --level)
+          cumulative[level] = cumulative[level+1] + std::pow (heights[level], H);
+
+        // Bin elements according to the highest height at which they are
+        //   supra-threshold
+        vector<ssize_t> top_level (num_elements, -1);
+        vector<size_t> level_offsets (num_heights+1, 0);
+        for (index_t i = 0; i != num_elements; ++i) {
+          if (std::isfinite (input[i])) {
+            top_level[i] = std::partition_point (heights.begin(), heights.end(),
+                [&] (const value_type h) { return above (input[i], h); }) - heights.begin() - 1;
+            if (top_level[i] >= 0)
+              ++level_offsets[top_level[i]+1];
+          }
+        }
+        for (ssize_t level = 0; level != num_heights; ++level)
+          level_offsets[level+1] += level_offsets[level];
+        vector<index_t> order (level_offsets.back());
+        {
+          vector<size_t> pos (level_offsets.begin(), level_offsets.end()-1);
+          for (index_t i = 0; i != num_elements; ++i) {
+            if (top_level[i] >= 0)
+              order[pos[top_level[i]]++] = i;
+          }
+        }
+
+        // For a root: accumulated enhancement, cluster size, and highest level
+        //   from which that size has not yet been accounted for
+        // For other elements: enhancement relative to that of the parent
+        vector<index_t> parent (num_elements);
+        vector<value_type> value (num_elements, value_type(0));
+        vector<index_t> size (num_elements, 0);
+        vector<ssize_t> since (num_elements, 0);
+        vector<index_t> path;
+
+        auto find = [&] (index_t node) {
+          while (parent[node] != node) {
+            path.push_back (node);
+            node = parent[node];
+          }
+          // Path compression: offsets become relative to the root
+          for (auto i = path.rbegin(); i != path.rend(); ++i) {
+            if (parent[*i] != node) {
+              value[*i] += value[parent[*i]];
+              parent[*i] = node;
+            }
+          }
+          path.clear();
+          return node;
+        };
+
+        // Account for the extent of the cluster at all levels down to (and
+        //   excluding) the current level
+        auto flush = [&] (const index_t root, const ssize_t level) {
+          if (since[root] != level) {
+            value[root] += std::pow (value_type(size[root]), E) * (cumulative[level+1] - cumulative[since[root]+1]);
+            since[root] = level;
+          }
+        };
+
+        for (ssize_t level = num_heights-1; level >= 0; --level) {
+          for (size_t i = level_offsets[level]; i != level_offsets[level+1]; ++i) {
+            const index_t element = order[i];
+            parent[element] = element;
+            size[element] = 1;
+            since[element] = level;
+            index_t root = element;
+            for (auto n : adjacency[element]) {
+              if (!size[n])
+                continue;
+              index_t other = find (n);
+              if (other == root)
+                continue;
+              flush (root, level);
+              flush (other, level);
+              if (size[root] < size[other])
+                std::swap (root, other);
+              parent[other] = root;
+              value[other] -= value[root];
+              size[root] += size[other];
+            }
+          }
+        }
+
+        for (const auto element : order) {
+          if (parent[element] == element)
+            flush (element, -1);
+        }
+        for (const auto element : order) {
+          const index_t root = find (element);
+          output[element] = (root == element) ? value[element] : value[element] + value[root];
+        }
+      }
+
+
+
     }
   }
 }
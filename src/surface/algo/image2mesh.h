@@ -18,9 +18,12 @@
 #define __surface_algo_image2mesh_h__
 
 #include <array>
+#include <atomic>
+#include <limits>
 #include <map>
 
 #include "image_helpers.h"
+#include "thread.h"
 #include "transform.h"
 #include "types.h"
 
@@ -143,20 +146,22 @@ namespace MR
 
 
 
-    // Image-to-mesh conversion function using the Marching Cubes algorithm
-    template <class ImageType>
-    void image2mesh_mc (const ImageType& input_image, Mesh& out, const default_type threshold)
-    {
-      static const Vox neighbour_offsets[] = { Vox (0, 0, 0),
-                                               Vox (1, 0, 0),
-                                               Vox (1, 1, 0),
-                                               Vox (0, 1, 0),
-                                               Vox (0, 0, 1),
-                                               Vox (1, 0, 1),
-                                               Vox (1, 1, 1),
-                                               Vox (0, 1, 1) };
-
-      static const uint32_t cube_edge_flags[256] = {
+    //! \cond skip
+    namespace {
+
+      // Marching Cubes lookup tables
+      // Cube corners are numbered as follows, relative to the lower corner:
+      //   (0,0,0), (1,0,0), (1,1,0), (0,1,0), (0,0,1), (1,0,1), (1,1,1), (0,1,1)
+      const int mc_corner_offsets[8][3] = { {0, 0, 0},
+                                            {1, 0, 0},
+                                            {1, 1, 0},
+                                            {0, 1, 0},
+                                            {0, 0, 1},
+                                            {1, 0, 1},
+                                            {1, 1, 1},
+                                            {0, 1, 1} };
+
+      const uint32_t mc_cube_edge_flags[256] = {
           0x000, 0x109, 0x203, 0x30a, 0x406, 0x50f, 0x605, 0x70c, 0x80c, 0x905, 0xa0f, 0xb06, 0xc0a, 0xd03, 0xe09, 0xf00,
           0x190, 0x099, 0x393, 0x29a, 0x596, 0x49f, 0x795, 0x69c, 0x99c, 0x895, 0xb9f, 0xa96, 0xd9a, 0xc93, 0xf99, 0xe90,
           0x230, 0x339, 0x033, 0x13a, 0x636, 0x73f, 0x435, 0x53c, 0xa3c, 0xb35, 0x83f, 0x936, 0xe3a, 0xf33, 0xc39, 0xd30,
@@ -173,13 +178,13 @@ namespace MR
           0xd30, 0xc39, 0xf33, 0xe3a, 0x936, 0x83f, 0xb35, 0xa3c, 0x53c, 0x435, 0x73f, 0x636, 0x13a, 0x033, 0x339, 0x230,
           0xe90, 0xf99, 0xc93, 0xd9a, 0xa96, 0xb9f, 0x895, 0x99c, 0x69c, 0x795, 0x49f, 0x596, 0x29a, 0x393, 0x099, 0x190,
           0xf00, 0xe09, 0xd03, 0xc0a, 0xb06, 0xa0f, 0x905, 0x80c, 0x70c, 0x605, 0x50f, 0x406, 0x30a, 0x203, 0x109, 0x000 };
-
-      static const uint8_t edge_vertices[12][2] = {
-          {0,1}, {1,2}, {2,3}, {3,0},
-          {4,5}, {5,6}, {6,7}, {7,4},
+      // For each cube edge, the two corners it connects, lower coordinates first
+      const uint8_t mc_edge_corners[12][2] = {
+          {0,1}, {1,2}, {3,2}, {0,3},
+          {4,5}, {5,6}, {7,6}, {4,7},
           {0,4}, {1,5}, {2,6}, {3,7} };
 
-      static const int8_t cube_triangle_table[256][16] = {
+      const int8_t mc_cube_triangle_table[256][16] = {
         {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
         {0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
         {0, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
@@ -437,96 +442,225 @@ namespace MR
         {0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
         {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1} };
 
-      VertexList vertices;
-      TriangleList triangles;
 
-      Transform transform (input_image);
-
-      ImageType voxel (input_image);
-      float in_vertex_values[8];
-      std::map< Vox, std::map<Vox, size_t> > input_vertex_pair_to_output_vertex_index_map;
-      Vox lower_corner;
-      for (lower_corner[2] = -1; lower_corner[2] != voxel.size(2); ++lower_corner[2]) {
-        for (lower_corner[1] = -1; lower_corner[1] != voxel.size(1); ++lower_corner[1]) {
-          for (lower_corner[0] = -1; lower_corner[0] != voxel.size(0); ++lower_corner[0]) {
-
-            // This is our lower corner for our region of 8 voxels
-            uint8_t code = 0x00;
-            for (size_t neighbour_index = 0; neighbour_index != 8; ++neighbour_index) {
-              assign_pos_of (lower_corner + neighbour_offsets[neighbour_index]).to (voxel);
-              in_vertex_values[neighbour_index] = 0.0f;
-              if (!is_out_of_bounds (voxel))
-                in_vertex_values[neighbour_index] = voxel.value();
-              if (in_vertex_values[neighbour_index] > threshold)
-                code |= (1 << neighbour_index);
-            }
-            // Our code here acts as a lookup index to the table cube_edge_flags
-            const uint32_t edge_flags = cube_edge_flags[code];
-            // Now we find out which edges are intersected, based on this flag
-            // For all relevant output vertices, we need to store the output index
-            //   of that vertex
-            std::array<uint32_t, 12> edge_to_output_vertex;
-            edge_to_output_vertex.fill (0);
-            for (size_t edge_index = 0; edge_index != 12; ++edge_index) {
-              if (edge_flags & (1 << edge_index)) {
-
-                // OK, so now we have two vertices corresponding to this edge
-                // However, we don't want to duplicate vertices
-                // Therefore, need to do a lookup
-                // Remember: we have the lower corner position, and 8 offsets from that
-                std::array<uint8_t, 2> vertex_indices;
-                std::array<Vox,     2> vertex_positions;
-
-                for (size_t i = 0; i != 2; ++i) {
-                  const uint8_t vertex_index = edge_vertices[edge_index][i];
-                  vertex_indices[i] = vertex_index;
-                  vertex_positions[i] = lower_corner + neighbour_offsets[vertex_index];
-                }
-                // Has a vertex already been generated somewhere along this edge?
-                auto lookup_zero_it = input_vertex_pair_to_output_vertex_index_map.find (vertex_positions[0]);
-                if (lookup_zero_it == input_vertex_pair_to_output_vertex_index_map.end())
-                  lookup_zero_it = input_vertex_pair_to_output_vertex_index_map.insert (std::make_pair (vertex_positions[0], std::map<Vox, size_t>())).first;
-                auto lookup_one_it = input_vertex_pair_to_output_vertex_index_map.find (vertex_positions[1]);
-                if (lookup_one_it == input_vertex_pair_to_output_vertex_index_map.end())
-                  lookup_one_it = input_vertex_pair_to_output_vertex_index_map.insert (std::make_pair (vertex_positions[1], std::map<Vox, size_t>())).first;
-                auto& lookup_zero = lookup_zero_it->second;
-                auto& lookup_one  = lookup_one_it ->second;
-                auto existing_zero = lookup_zero.find (vertex_positions[1]);
-                if (existing_zero == lookup_zero.end()) {
-                  lookup_zero.insert (std::make_pair (vertex_positions[1], vertices.size()));
-                  lookup_one .insert (std::make_pair (vertex_positions[0], vertices.size()));
-                  edge_to_output_vertex[edge_index] = vertices.size();
-                  // Calculate the precise position of this vertex, based on the
-                  //   image intensities in the two relevant voxels
-                  const default_type alpha = (threshold - in_vertex_values[vertex_indices[0]]) / (in_vertex_values[vertex_indices[1]] - in_vertex_values[vertex_indices[0]]);
-                  const Vertex pos_voxelspace = vertex_positions[0].cast<default_type>() + (alpha * (vertex_positions[1] - vertex_positions[0]).cast<default_type>());
-                  vertices.push_back (transform.voxel2scanner * pos_voxelspace);
-                } else {
-                  edge_to_output_vertex[edge_index] = existing_zero->second;
-                }
+      // Marching Cubes output for a slab of consecutive layers of cubes
+      // Vertices are indexed within the slab; vertices on edges within the
+      //   bottom face of any slab other than the first are instead generated
+      //   by the preceding slab, and are referenced as (-1 - (2*index + axis)),
+      //   where index is the position of the edge within that face
+      class __MCSlab { NOMEMALIGN
+        public:
+          VertexList vertices;
+          vector<std::array<int32_t, 3>> triangles;
+          // Vertex indices along the x & y edges within the top face of the slab
+          vector<int32_t> top_edges[2];
+      };
+
 
+
+      template <class ImageType>
+      class __MarchingCubes { MEMALIGN(__MarchingCubes<ImageType>)
+        public:
+          __MarchingCubes (const ImageType& image, const Transform& transform, const default_type threshold,
+                           vector<__MCSlab>& slabs, std::atomic<size_t>& next_slab) :
+              voxel (image),
+              transform (transform),
+              threshold (threshold),
+              slabs (slabs),
+              next_slab (next_slab),
+              row (image.size(0) + 2),
+              plane (row * (image.size(1) + 2)) { }
+
+          void execute ()
+          {
+            for (size_t i = 0; i != 2; ++i) {
+              values[i].resize (plane);
+              for (size_t axis = 0; axis != 2; ++axis)
+                edges[i][axis].resize (plane);
+            }
+            z_edges.resize (plane);
+            size_t index;
+            while ((index = next_slab++) < slabs.size())
+              process (index);
+          }
+
+        protected:
+          static constexpr int32_t unset = std::numeric_limits<int32_t>::min();
+
+          ImageType voxel;
+          const Transform& transform;
+          const default_type threshold;
+          vector<__MCSlab>& slabs;
+          std::atomic<size_t>& next_slab;
+          const size_t row, plane;
+
+          // Image intensities within the lower & upper faces of the current
+          //   layer of cubes, including one voxel of zero-padding on all sides
+          vector<float> values[2];
+          // Output vertex indices for the x & y edges within these faces,
+          //   and for the z edges between them
+          vector<int32_t> edges[2][2], z_edges;
+
+
+          void load (const ssize_t z, vector<float>& data)
+          {
+            std::fill (data.begin(), data.end(), 0.0f);
+            if (z < 0 || z >= voxel.size(2))
+              return;
+            voxel.index(2) = z;
+            for (voxel.index(1) = 0; voxel.index(1) != voxel.size(1); ++voxel.index(1)) {
+              float* p = &data[(voxel.index(1)+1) * row + 1];
+              for (voxel.index(0) = 0; voxel.index(0) != voxel.size(0); ++voxel.index(0))
+                *p++ = voxel.value();
+            }
+          }
+
+
+          void process (const size_t index)
+          {
+            __MCSlab& slab (slabs[index]);
+            // Layers of cubes are indexed by the z position of their lower corners,
+            //   from -1 to (size(2)-1) inclusive
+            const ssize_t num_layers = voxel.size(2) + 1;
+            const ssize_t z_begin = -1 + (num_layers * index) / slabs.size();
+            const ssize_t z_end = -1 + (num_layers * (index+1)) / slabs.size();
+
+            load (z_begin, values[0]);
+            for (size_t axis = 0; axis != 2; ++axis) {
+              if (index) {
+                for (size_t i = 0; i != plane; ++i)
+                  edges[0][axis][i] = -1 - int32_t(2*i + axis);
+              } else {
+                std::fill (edges[0][axis].begin(), edges[0][axis].end(), unset);
               }
             }
 
-            // OK, so now the relevant edges have an output vertex index associated with them
-            // Based on the code for this voxel, now we use the table cube_triangle_table to see
-            //   which edges need to have triangles constructed from the relevant generated vertices
-            // Note that flipping the last two vertex indices is deliberate; the provided
-            //   lookup table does not use a right-hand rule axis convention, so this is necessary
-            //   to calculate the correct surface normals
-            for (const int8_t* first_edge = cube_triangle_table[code]; *first_edge >= 0; first_edge += 3) {
-              const uint32_t indices[3] { edge_to_output_vertex[*first_edge], edge_to_output_vertex[*(first_edge+2)], edge_to_output_vertex[*(first_edge+1)] };
-              triangles.push_back (Triangle (indices));
+            for (ssize_t z = z_begin; z != z_end; ++z) {
+              load (z+1, values[1]);
+              for (size_t axis = 0; axis != 2; ++axis)
+                std::fill (edges[1][axis].begin(), edges[1][axis].end(), unset);
+              std::fill (z_edges.begin(), z_edges.end(), unset);
+
+              for (ssize_t y = -1; y != voxel.size(1); ++y) {
+                for (ssize_t x = -1; x != voxel.size(0); ++x) {
+
+                  const size_t lower_corner = (y+1) * row + (x+1);
+                  float in_vertex_values[8];
+                  uint8_t code = 0x00;
+                  for (size_t corner = 0; corner != 8; ++corner) {
+                    const int* offset = mc_corner_offsets[corner];
+                    in_vertex_values[corner] = values[offset[2]][lower_corner + offset[1]*row + offset[0]];
+                    if (in_vertex_values[corner] > threshold)
+                      code |= (1 << corner);
+                  }
+                  const uint32_t edge_flags = mc_cube_edge_flags[code];
+                  if (!edge_flags)
+                    continue;
+
+                  // Find or generate the output vertex along each intersected edge
+                  std::array<int32_t, 12> edge_to_output_vertex;
+                  for (size_t edge_index = 0; edge_index != 12; ++edge_index) {
+                    if (edge_flags & (1 << edge_index)) {
+                      const uint8_t c0 = mc_edge_corners[edge_index][0];
+                      const uint8_t c1 = mc_edge_corners[edge_index][1];
+                      const int* offset = mc_corner_offsets[c0];
+                      const size_t axis = offset[0] != mc_corner_offsets[c1][0] ? 0 : (offset[1] != mc_corner_offsets[c1][1] ? 1 : 2);
+                      const size_t i = lower_corner + offset[1]*row + offset[0];
+                      int32_t& output_index (axis == 2 ? z_edges[i] : edges[offset[2]][axis][i]);
+                      if (output_index == unset) {
+                        output_index = slab.vertices.size();
+                        // Calculate the precise position of this vertex, based on the
+                        //   image intensities in the two relevant voxels
+                        const default_type alpha = (threshold - in_vertex_values[c0]) / (default_type(in_vertex_values[c1]) - in_vertex_values[c0]);
+                        Vertex pos_voxelspace (x + offset[0], y + offset[1], z + offset[2]);
+                        pos_voxelspace[axis] += alpha;
+                        slab.vertices.push_back (transform.voxel2scanner * pos_voxelspace);
+                      }
+                      edge_to_output_vertex[edge_index] = output_index;
+                    }
+                  }
+
+                  // Note that flipping the last two vertex indices is deliberate; the provided
+                  //   lookup table does not use a right-hand rule axis convention, so this is necessary
+                  //   to calculate the correct surface normals
+                  for (const int8_t* first_edge = mc_cube_triangle_table[code]; *first_edge >= 0; first_edge += 3)
+                    slab.triangles.push_back ({ { edge_to_output_vertex[*first_edge], edge_to_output_vertex[*(first_edge+2)], edge_to_output_vertex[*(first_edge+1)] } });
+
+                }
+              }
+
+              std::swap (values[0], values[1]);
+              for (size_t axis = 0; axis != 2; ++axis)
+                std::swap (edges[0][axis], edges[1][axis]);
             }
 
-      } } } // Finished looping over all voxels in the input image
+            for (size_t axis = 0; axis != 2; ++axis)
+              slab.top_edges[axis] = edges[0][axis];
+          }
+
+      };
+
+    }
+    //! \endcond
+
+
+
+    // Image-to-mesh conversion function using the Marching Cubes algorithm
+    // The image is processed in slabs along the z axis, in parallel where
+    //   possible; vertices are shared between adjacent cubes by tracking the
+    //   output vertex along each edge of the two faces of the current layer
+    //   of cubes, and those on the faces between slabs are stitched once all
+    //   slabs have been processed
+    template <class ImageType>
+    void image2mesh_mc (const ImageType& input_image, Mesh& out, const default_type threshold)
+    {
+      const Transform transform (input_image);
+      const size_t num_threads = Thread::threads_to_execute();
+      // Use more slabs than threads for load balancing, but no fewer than
+      //   8 layers of cubes per slab
+      const size_t num_layers = input_image.size(2) + 1;
+      const size_t num_slabs = std::max (size_t(1), std::min (4 * num_threads, num_layers / 8));
+
+      vector<__MCSlab> slabs (num_slabs);
+      std::atomic<size_t> next_slab (0);
+      __MarchingCubes<ImageType> functor (input_image, transform, threshold, slabs, next_slab);
+      if (num_threads > 1 && num_slabs > 1)
+        Thread::run (Thread::multi (functor, num_threads), "Marching Cubes");
+      else
+        functor.execute();
+
+      // Concatenate the slabs, mapping references to vertices of the preceding slab
+      vector<size_t> offsets (num_slabs + 1, 0);
+      size_t num_triangles = 0;
+      for (size_t s = 0; s != num_slabs; ++s) {
+        offsets[s+1] = offsets[s] + slabs[s].vertices.size();
+        num_triangles += slabs[s].triangles.size();
+      }
+      VertexList vertices;
+      vertices.reserve (offsets.back());
+      TriangleList triangles;
+      triangles.reserve (num_triangles);
+      for (size_t s = 0; s != num_slabs; ++s) {
+        vertices.insert (vertices.end(), slabs[s].vertices.begin(), slabs[s].vertices.end());
+        VertexList().swap (slabs[s].vertices);
+        auto output_index = [&] (const int32_t index) -> uint32_t {
+          if (index >= 0)
+            return offsets[s] + index;
+          assert (s);
+          const size_t i = -1 - index;
+          const int32_t previous = slabs[s-1].top_edges[i&1][i>>1];
+          assert (previous >= 0);
+          return offsets[s-1] + previous;
+        };
+        for (const auto& t : slabs[s].triangles)
+          triangles.push_back (Triangle { output_index (t[0]), output_index (t[1]), output_index (t[2]) });
+      }
 
       // Write the result to the output class
       out.load (vertices, triangles);
 
     }
 
-
     }
   }
 }
@@ -16,12 +16,15 @@
 
 #include "surface/algo/mesh2image.h"
 
-#include <map>
+#include <atomic>
 
 #include "header.h"
 #include "progressbar.h"
+#include "stride.h"
+#include "thread.h"
 #include "thread_queue.h"
 #include "types.h"
+#include "algo/threaded_loop.h"
 
 #include "surface/types.h"
 #include "surface/utils.h"
@@ -39,6 +42,160 @@ namespace MR
       constexpr size_t pve_nsamples = Math::pow3 (pve_os_ratio);
 
 
+
+      namespace {
+
+        // Voxels intersected by the mesh, and for each of these the polygons that
+        //   intersect it, in ascending order; the polygons intersecting voxel
+        //   voxels[i] are polygons[offsets[i]] to polygons[offsets[i+1]-1]
+        class EdgeVoxels
+        { NOMEMALIGN
+          public:
+            vector<Vox> voxels;
+            vector<size_t> offsets, polygons;
+        };
+
+
+
+        // Use the Separating Axis Theorem to determine whether or not a polygon
+        //   intersects a voxel
+        bool overlap (const Vox& vox, const VertexList& vertices, const Eigen::Vector3& polygon_normal)
+        {
+          const size_t num_vertices = vertices.size();
+
+          // Test whether or not the two objects can be separated via projection onto an axis
+          auto separating_axis = [&] (const Eigen::Vector3& axis) -> bool {
+            default_type voxel_low  =  std::numeric_limits<default_type>::infinity();
+            default_type voxel_high = -std::numeric_limits<default_type>::infinity();
+            default_type poly_low   =  std::numeric_limits<default_type>::infinity();
+            default_type poly_high  = -std::numeric_limits<default_type>::infinity();
+
+            static const Eigen::Vector3 voxel_offsets[8] = { { -0.5, -0.5, -0.5 },
+                                                             { -0.5, -0.5,  0.5 },
+                                                             { -0.5,  0.5, -0.5 },
+                                                             { -0.5,  0.5,  0.5 },
+                                                             {  0.5, -0.5, -0.5 },
+                                                             {  0.5, -0.5,  0.5 },
+                                                             {  0.5,  0.5, -0.5 },
+                                                             {  0.5,  0.5,  0.5 } };
+
+            for (size_t i = 0; i != 8; ++i) {
+              const Eigen::Vector3 v (vox.matrix().cast<default_type>() + voxel_offsets[i]);
+              const default_type projection = axis.dot (v);
+              voxel_low  = std::min (voxel_low,  projection);
+              voxel_high = std::max (voxel_high, projection);
+            }
+
+            for (const auto& v : vertices) {
+              const default_type projection = axis.dot (v);
+              poly_low  = std::min (poly_low,  projection);
+              poly_high = std::max (poly_high, projection);
+            }
+
+            // Is this a separating axis?
+            return (poly_low > voxel_high || voxel_low > poly_high);
+          };
+
+          // The following axes need to be tested as potential separating axes:
+          //   x, y, z
+          //   All cross-products between voxel and polygon edges
+          //   Polygon normal
+          for (size_t i = 0; i != 3; ++i) {
+            Eigen::Vector3 axis (0.0, 0.0, 0.0);
+            axis[i] = 1.0;
+            if (separating_axis (axis))
+              return false;
+            for (size_t j = 0; j != num_vertices-1; ++j) {
+              if (separating_axis (axis.cross (vertices[j+1] - vertices[j])))
+                return false;
+            }
+            if (separating_axis (axis.cross (vertices[num_vertices-1] - vertices[0])))
+              return false;
+          }
+          if (separating_axis (polygon_normal))
+            return false;
+
+          // No axis has been found that separates the two objects
+          // Therefore, the two objects overlap
+          return true;
+        }
+
+
+
+        // Map each polygon to the voxels that it intersects; polygons are
+        //   processed in blocks, claimed by each thread in turn
+        class PolygonMapper
+        { MEMALIGN(PolygonMapper)
+          public:
+            using pair_type = std::pair<size_t, size_t>;
+            static constexpr size_t block_size = 1024;
+
+            PolygonMapper (const Mesh& mesh, const vector<Eigen::Vector3>& polygon_normals, const Vox& dims,
+                           vector<vector<pair_type>>& blocks, std::atomic<size_t>& next_block) :
+                mesh (mesh),
+                polygon_normals (polygon_normals),
+                dims (dims),
+                blocks (blocks),
+                next_block (next_block) { }
+
+            void execute ()
+            {
+              size_t block;
+              while ((block = next_block++) < blocks.size()) {
+                const size_t end = std::min ((block+1) * block_size, mesh.num_polygons());
+                for (size_t poly_index = block * block_size; poly_index != end; ++poly_index)
+                  map (poly_index, blocks[block]);
+              }
+            }
+
+          private:
+            const Mesh& mesh;
+            const vector<Eigen::Vector3>& polygon_normals;
+            const Vox dims;
+            vector<vector<pair_type>>& blocks;
+            std::atomic<size_t>& next_block;
+
+            void map (const size_t poly_index, vector<pair_type>& pairs) const
+            {
+              VertexList vertices;
+              if (poly_index < mesh.num_triangles())
+                mesh.load_triangle_vertices (vertices, poly_index);
+              else
+                mesh.load_quad_vertices (vertices, poly_index - mesh.num_triangles());
+
+              // Figure out the voxel extent of this polygon in three dimensions
+              Vox lower_bound (dims[0]-1, dims[1]-1, dims[2]-1), upper_bound (0, 0, 0);
+              for (const auto& v : vertices) {
+                for (size_t axis = 0; axis != 3; ++axis) {
+                  const int this_axis_voxel = std::round (v[axis]);
+                  lower_bound[axis] = std::min (lower_bound[axis], this_axis_voxel);
+                  upper_bound[axis] = std::max (upper_bound[axis], this_axis_voxel);
+                }
+              }
+
+              // Constrain to lie within the dimensions of the image
+              for (size_t axis = 0; axis != 3; ++axis) {
+                lower_bound[axis] = std::max (0,               lower_bound[axis]);
+                upper_bound[axis] = std::min (dims[axis] - 1, upper_bound[axis]);
+              }
+
+              // Rather than adding this polygon to the list of polygons to test for
+              //   every single voxel within this 3D bounding box, only test it within
+              //   those voxels that the polygon actually intersects
+              Vox voxel;
+              for (voxel[2] = lower_bound[2]; voxel[2] <= upper_bound[2]; ++voxel[2]) {
+                for (voxel[1] = lower_bound[1]; voxel[1] <= upper_bound[1]; ++voxel[1]) {
+                  for (voxel[0] = lower_bound[0]; voxel[0] <= upper_bound[0]; ++voxel[0]) {
+                    if (overlap (voxel, vertices, polygon_normals[poly_index]))
+                      pairs.push_back (std::make_pair (voxel[0] + dims[0] * (voxel[1] + dims[1] * size_t(voxel[2])), poly_index));
+              } } }
+            }
+        };
+
+      }
+
+
+
       void mesh2image (const Mesh& mesh_realspace, Image<float>& image)
       {
 
@@ -50,8 +207,7 @@ namespace MR
         vector<Eigen::Vector3> polygon_normals;
 
         // For every edge voxel, stores those polygons that may intersect the voxel
-        using Vox2Poly = std::map< Vox, vector<size_t> >;
-        Vox2Poly voxel2poly;
+        EdgeVoxels edge;
 
         {
           ProgressBar progress ("Performing voxel-based segmentation of surface", 8);
@@ -80,135 +236,43 @@ namespace MR
             polygon_normals.push_back (normal (mesh, *p));
           ++progress;
 
-          // Create some memory to work with:
+          // Voxel data are stored in flat arrays, indexed as x + X * (y + Y * z)
+          const Vox dims (image.size(0), image.size(1), image.size(2));
+          const size_t num_voxels = size_t(dims[0]) * dims[1] * dims[2];
+          auto voxel_index = [&] (const Vox& v) -> size_t { return v[0] + dims[0] * (v[1] + dims[1] * size_t(v[2])); };
+          auto is_out_of_bounds = [&] (const Vox& v) -> bool {
+            return v[0] < 0 || v[0] >= dims[0] || v[1] < 0 || v[1] >= dims[1] || v[2] < 0 || v[2] >= dims[2];
+          };
+
           // Stores a flag for each voxel as encoded in enum vox_mesh_t
-          Header H (image);
-          H.datatype() = DataType::UInt8;
-          auto init_seg = Image<uint8_t>::scratch (H);
-          for (auto l = Loop(init_seg) (init_seg); l; ++l)
-            init_seg.value() = vox_mesh_t::UNDEFINED;
+          vector<uint8_t> init_seg (num_voxels, vox_mesh_t::UNDEFINED);
 
           // Map each polygon to the underlying voxels
-          for (size_t poly_index = 0; poly_index != mesh.num_polygons(); ++poly_index) {
-
-            const size_t num_vertices = (poly_index < mesh.num_triangles()) ? 3 : 4;
-
-            // Figure out the voxel extent of this polygon in three dimensions
-            Vox lower_bound (H.size(0)-1, H.size(1)-1, H.size(2)-1), upper_bound (0, 0, 0);
-            VertexList this_poly_verts;
-            if (num_vertices == 3)
-              mesh.load_triangle_vertices (this_poly_verts, poly_index);
-            else
-              mesh.load_quad_vertices (this_poly_verts, poly_index - mesh.num_triangles());
-            for (VertexList::const_iterator v = this_poly_verts.begin(); v != this_poly_verts.end(); ++v) {
-              for (size_t axis = 0; axis != 3; ++axis) {
-                const int this_axis_voxel = std::round((*v)[axis]);
-                lower_bound[axis] = std::min (lower_bound[axis], this_axis_voxel);
-                upper_bound[axis] = std::max (upper_bound[axis], this_axis_voxel);
-              }
+          {
+            vector<vector<PolygonMapper::pair_type>> blocks ((mesh.num_polygons() + PolygonMapper::block_size - 1) / PolygonMapper::block_size);
+            std::atomic<size_t> next_block (0);
+            PolygonMapper mapper (mesh, polygon_normals, dims, blocks, next_block);
+            Thread::run (Thread::multi (mapper), "mesh polygon mapping");
+
+            // Sort by voxel, retaining the polygons for each voxel in ascending order
+            vector<PolygonMapper::pair_type> pairs;
+            for (auto& block : blocks) {
+              pairs.insert (pairs.end(), block.begin(), block.end());
+              vector<PolygonMapper::pair_type>().swap (block);
             }
-
-            // Constrain to lie within the dimensions of the image
-            for (size_t axis = 0; axis != 3; ++axis) {
-              lower_bound[axis] = std::max(0,                   lower_bound[axis]);
-              upper_bound[axis] = std::min(int(H.size(axis)-1), upper_bound[axis]);
-            }
-
-            // For all voxels within this rectangular region, assign this polygon to the map
-            // Use the Separating Axis Theorem to be more stringent as to which voxels this
-            //   polygon will be processed in
-            auto overlap = [&] (const Vox& vox, const size_t poly_index) -> bool {
-
-              VertexList vertices;
-              if (num_vertices == 3)
-                mesh.load_triangle_vertices (vertices, poly_index);
-              else
-                mesh.load_quad_vertices (vertices, poly_index - mesh.num_triangles());
-
-              // Test whether or not the two objects can be separated via projection onto an axis
-              auto separating_axis = [&] (const Eigen::Vector3& axis) -> bool {
-                default_type voxel_low  =  std::numeric_limits<default_type>::infinity();
-                default_type voxel_high = -std::numeric_limits<default_type>::infinity();
-                default_type poly_low   =  std::numeric_limits<default_type>::infinity();
-                default_type poly_high  = -std::numeric_limits<default_type>::infinity();
-
-                static const Eigen::Vector3 voxel_offsets[8] = { { -0.5, -0.5, -0.5 },
-                                                                 { -0.5, -0.5,  0.5 },
-                                                                 { -0.5,  0.5, -0.5 },
-                                                                 { -0.5,  0.5,  0.5 },
-                                                                 {  0.5, -0.5, -0.5 },
-                                                                 {  0.5, -0.5,  0.5 },
-                                                                 {  0.5,  0.5, -0.5 },
-                                                                 {  0.5,  0.5,  0.5 } };
-
-                for (size_t i = 0; i != 8; ++i) {
-                  const Eigen::Vector3 v (vox.matrix().cast<default_type>() + voxel_offsets[i]);
-                  const default_type projection = axis.dot (v);
-                  voxel_low  = std::min (voxel_low,  projection);
-                  voxel_high = std::max (voxel_high, projection);
-                }
-
-                for (const auto& v : vertices) {
-                  const default_type projection = axis.dot (v);
-                  poly_low  = std::min (poly_low,  projection);
-                  poly_high = std::max (poly_high, projection);
-                }
-
-                // Is this a separating axis?
-                return (poly_low > voxel_high || voxel_low > poly_high);
-              };
-
-              // The following axes need to be tested as potential separating axes:
-              //   x, y, z
-              //   All cross-products between voxel and polygon edges
-              //   Polygon normal
-              for (size_t i = 0; i != 3; ++i) {
-                Eigen::Vector3 axis (0.0, 0.0, 0.0);
-                axis[i] = 1.0;
-                if (separating_axis (axis))
-                  return false;
-                for (size_t j = 0; j != num_vertices-1; ++j) {
-                  if (separating_axis (axis.cross (vertices[j+1] - vertices[j])))
-                    return false;
-                }
-                if (separating_axis (axis.cross (vertices[num_vertices-1] - vertices[0])))
-                  return false;
+            std::sort (pairs.begin(), pairs.end());
+
+            edge.polygons.reserve (pairs.size());
+            for (size_t i = 0; i != pairs.size(); ++i) {
+              if (!i || pairs[i].first != pairs[i-1].first) {
+                const size_t index = pairs[i].first;
+                edge.voxels.push_back (Vox (index % dims[0], (index / dims[0]) % dims[1], index / (size_t(dims[0]) * dims[1])));
+                edge.offsets.push_back (i);
+                init_seg[index] = vox_mesh_t::ON_MESH;
               }
-              if (separating_axis (polygon_normals[poly_index]))
-                return false;
-
-              // No axis has been found that separates the two objects
-              // Therefore, the two objects overlap
-              return true;
-            };
-
-            Vox voxel;
-            for (voxel[2] = lower_bound[2]; voxel[2] <= upper_bound[2]; ++voxel[2]) {
-              for (voxel[1] = lower_bound[1]; voxel[1] <= upper_bound[1]; ++voxel[1]) {
-                for (voxel[0] = lower_bound[0]; voxel[0] <= upper_bound[0]; ++voxel[0]) {
-                  // Rather than adding this polygon to the list of polygons to test for
-                  //   every single voxel within this 3D bounding box, only test it within
-                  //   those voxels that the polygon actually intersects
-                  if (overlap (voxel, poly_index)) {
-                    vector<size_t> this_voxel_polys;
-                    // Has this voxel already been intersected by at least one polygon?
-                    // If it has, we need to concatenate this polygon to the list
-                    //   (which involves deleting the existing entry then re-writing the concatenated list);
-                    // If it has not, we're adding a new entry to the list of voxels to be tested,
-                    //   with only one entry in the list for that voxel
-                    Vox2Poly::const_iterator existing = voxel2poly.find (voxel);
-                    if (existing != voxel2poly.end()) {
-                      this_voxel_polys = existing->second;
-                      voxel2poly.erase (existing);
-                    } else {
-                      // Only call this once each voxel, regardless of the number of intersecting polygons
-                      assign_pos_of (voxel).to (init_seg);
-                      init_seg.value() = vox_mesh_t::ON_MESH;
-                    }
-                    this_voxel_polys.push_back (poly_index);
-                    voxel2poly.insert (std::make_pair (voxel, this_voxel_polys));
-                  } } } }
-
+              edge.polygons.push_back (pairs[i].second);
+            }
+            edge.offsets.push_back (pairs.size());
           }
           ++progress;
 
@@ -218,32 +282,29 @@ namespace MR
           //   by the normal at the vertex.
           // Each voxel not directly on the mesh should then be assigned as prelim_inside or prelim_outside
           //   depending on whether the summed value is positive or negative
-          H.datatype() = DataType::Float32;
-          H.datatype().set_byte_order_native();
-          auto sum_distances = Image<float>::scratch (H, "Sum of distances from polygon planes");
+          vector<float> sum_distances (num_voxels, 0.0f);
           Vox adj_voxel;
           for (size_t i = 0; i != mesh.num_vertices(); ++i) {
             const Vox centre_voxel (mesh.vert(i));
             for (adj_voxel[2] = centre_voxel[2]-1; adj_voxel[2] <= centre_voxel[2]+1; ++adj_voxel[2]) {
               for (adj_voxel[1] = centre_voxel[1]-1; adj_voxel[1] <= centre_voxel[1]+1; ++adj_voxel[1]) {
                 for (adj_voxel[0] = centre_voxel[0]-1; adj_voxel[0] <= centre_voxel[0]+1; ++adj_voxel[0]) {
-                  if (!is_out_of_bounds (H, adj_voxel) && (adj_voxel - centre_voxel).any()) {
+                  if (!is_out_of_bounds (adj_voxel) && (adj_voxel - centre_voxel).any()) {
                     const Eigen::Vector3 offset (adj_voxel.cast<default_type>().matrix() - mesh.vert(i));
                     const default_type dp_normal = offset.dot (mesh.norm(i));
                     const default_type offset_on_plane = (offset - (mesh.norm(i) * dp_normal)).norm();
-                    assign_pos_of (adj_voxel).to (sum_distances);
                     // If offset_on_plane is close to zero, this vertex should contribute strongly toward
                     //   the sum of distances from the surface within this voxel
-                    sum_distances.value() += (1.0 / (1.0 + offset_on_plane)) * dp_normal;
+                    sum_distances[voxel_index (adj_voxel)] += (1.0 / (1.0 + offset_on_plane)) * dp_normal;
                   }
                 }
               }
             }
           }
           ++progress;
-          for (auto l = Loop(init_seg) (init_seg, sum_distances); l; ++l) {
-            if (static_cast<float> (sum_distances.value()) != 0.0f && init_seg.value() != vox_mesh_t::ON_MESH)
-              init_seg.value() = sum_distances.value() < 0.0 ? vox_mesh_t::PRELIM_INSIDE : vox_mesh_t::PRELIM_OUTSIDE;
+          for (size_t i = 0; i != num_voxels; ++i) {
+            if (sum_distances[i] != 0.0f && init_seg[i] != vox_mesh_t::ON_MESH)
+              init_seg[i] = sum_distances[i] < 0.0 ? vox_mesh_t::PRELIM_INSIDE : vox_mesh_t::PRELIM_OUTSIDE;
           }
           ++progress;
 
@@ -253,132 +314,136 @@ namespace MR
           //   - Select voxels both inside and outside the mesh to expand
           //   - When expanding each region, count the number of pre-assigned voxels both inside and outside
           //   - For the final region selection, assign values to voxels based on a majority vote
-          Image<uint8_t> seed (init_seg);
+          // Seed voxels are visited in order of increasing stride of the image axes
+          const auto axes = Stride::order (image, 0, 3);
           vector<Vox> to_fill;
           std::stack<Vox> to_expand;
-          for (auto l = Loop(seed) (seed); l; ++l) {
-            if (seed.value() == vox_mesh_t::PRELIM_INSIDE || seed.value() == vox_mesh_t::PRELIM_OUTSIDE) {
-              size_t prelim_inside_count = 0, prelim_outside_count = 0;
-              float sum_sum_distances = 0.0f;
-              if (seed.value() == vox_mesh_t::PRELIM_INSIDE)
-                prelim_inside_count = 1;
-              else
-                prelim_outside_count = 1;
-              to_expand.push (Vox (seed.index(0), seed.index(1), seed.index(2)));
-              to_fill.assign (1, to_expand.top());
-              do {
-                const Vox voxel (to_expand.top());
-                to_expand.pop();
-                for (size_t adj_vox_idx = 0; adj_vox_idx != 6; ++adj_vox_idx) {
-                  const Vox adj_voxel (voxel + adj_voxels[adj_vox_idx]);
-                  assign_pos_of (adj_voxel).to (init_seg);
-                  if (!is_out_of_bounds (init_seg)) {
-                    const uint8_t adj_value = init_seg.value();
-                    if (adj_value == vox_mesh_t::UNDEFINED || adj_value == vox_mesh_t::PRELIM_INSIDE || adj_value == vox_mesh_t::PRELIM_OUTSIDE) {
-                      if (adj_value == vox_mesh_t::PRELIM_INSIDE)
-                        ++prelim_inside_count;
-                      else if (adj_value == vox_mesh_t::PRELIM_OUTSIDE)
-                        ++prelim_outside_count;
-                      assign_pos_of (init_seg).to (sum_distances);
-                      sum_sum_distances += sum_distances.value();
-                      to_expand.push (adj_voxel);
-                      to_fill.push_back (adj_voxel);
-                      init_seg.value() = vox_mesh_t::FILL_TEMP;
+          Vox seed;
+          for (seed[axes[2]] = 0; seed[axes[2]] != dims[axes[2]]; ++seed[axes[2]]) {
+            for (seed[axes[1]] = 0; seed[axes[1]] != dims[axes[1]]; ++seed[axes[1]]) {
+              for (seed[axes[0]] = 0; seed[axes[0]] != dims[axes[0]]; ++seed[axes[0]]) {
+                const uint8_t seed_value = init_seg[voxel_index (seed)];
+                if (seed_value != vox_mesh_t::PRELIM_INSIDE && seed_value != vox_mesh_t::PRELIM_OUTSIDE)
+                  continue;
+                size_t prelim_inside_count = 0, prelim_outside_count = 0;
+                float sum_sum_distances = 0.0f;
+                if (seed_value == vox_mesh_t::PRELIM_INSIDE)
+                  prelim_inside_count = 1;
+                else
+                  prelim_outside_count = 1;
+                to_expand.push (seed);
+                to_fill.assign (1, seed);
+                do {
+                  const Vox voxel (to_expand.top());
+                  to_expand.pop();
+                  for (size_t adj_vox_idx = 0; adj_vox_idx != 6; ++adj_vox_idx) {
+                    const Vox adj_voxel (voxel + adj_voxels[adj_vox_idx]);
+                    if (!is_out_of_bounds (adj_voxel)) {
+                      const size_t index = voxel_index (adj_voxel);
+                      const uint8_t adj_value = init_seg[index];
+                      if (adj_value == vox_mesh_t::UNDEFINED || adj_value == vox_mesh_t::PRELIM_INSIDE || adj_value == vox_mesh_t::PRELIM_OUTSIDE) {
+                        if (adj_value == vox_mesh_t::PRELIM_INSIDE)
+                          ++prelim_inside_count;
+                        else if (adj_value == vox_mesh_t::PRELIM_OUTSIDE)
+                          ++prelim_outside_count;
+                        sum_sum_distances += sum_distances[index];
+                        to_expand.push (adj_voxel);
+                        to_fill.push_back (adj_voxel);
+                        init_seg[index] = vox_mesh_t::FILL_TEMP;
+                      }
                     }
                   }
-                }
-              } while (to_expand.size());
-              vox_mesh_t fill_value = vox_mesh_t::UNDEFINED;
-              if (prelim_inside_count == prelim_outside_count && sum_sum_distances) {
-                fill_value = sum_sum_distances < 0.0f ? vox_mesh_t::INSIDE : vox_mesh_t::OUTSIDE;
-              } else if (prelim_inside_count > 10 * prelim_outside_count) {
-                fill_value = vox_mesh_t::INSIDE;
-              } else if (prelim_outside_count > 10 * prelim_inside_count) {
-                fill_value = vox_mesh_t::OUTSIDE;
-              } else {
-                // Residual ambiguity about whether the connected region is inside or outside the surface
-                // What other tests can we perform to make this decision?
-                // If all eight corners of the FoV are included in to_fill, we can be
-                //   reasonably confident that this connected region lies outside the structure
-                size_t corner_count = 0;
-                for (const auto& voxel : to_fill) {
-                  if ((voxel[0] == 0 || voxel[0] == H.size(0) - 1) &&
-                      (voxel[1] == 0 || voxel[1] == H.size(1) - 1) &&
-                      (voxel[2] == 0 || voxel[2] == H.size(2) - 1))
-                    ++corner_count;
-                }
-                if (corner_count == 8) {
-                  fill_value = vox_mesh_t::OUTSIDE;
-                } else if (!corner_count) {
-                  fill_value = vox_mesh_t::INSIDE;
-                } else if (sum_sum_distances) {
+                } while (to_expand.size());
+                vox_mesh_t fill_value = vox_mesh_t::UNDEFINED;
+                if (prelim_inside_count == prelim_outside_count && sum_sum_distances) {
                   fill_value = sum_sum_distances < 0.0f ? vox_mesh_t::INSIDE : vox_mesh_t::OUTSIDE;
+                } else if (prelim_inside_count > 10 * prelim_outside_count) {
+                  fill_value = vox_mesh_t::INSIDE;
+                } else if (prelim_outside_count > 10 * prelim_inside_count) {
+                  fill_value = vox_mesh_t::OUTSIDE;
                 } else {
-                  Exception e ("Internal error: fundamental ambiguity in voxel-based segmentation of surface");
-                  e.push_back ("Fill region size: " + str(to_fill.size()));
-                  e.push_back ("Preliminary classifications: " + str(prelim_inside_count) + " inside, " + str(prelim_outside_count) + " outside");
-                  e.push_back ("FoV corners: " + str(corner_count));
-                  throw e;
+                  // Residual ambiguity about whether the connected region is inside or outside the surface
+                  // What other tests can we perform to make this decision?
+                  // If all eight corners of the FoV are included in to_fill, we can be
+                  //   reasonably confident that this connected region lies outside the structure
+                  size_t corner_count = 0;
+                  for (const auto& voxel : to_fill) {
+                    if ((voxel[0] == 0 || voxel[0] == dims[0] - 1) &&
+                        (voxel[1] == 0 || voxel[1] == dims[1] - 1) &&
+                        (voxel[2] == 0 || voxel[2] == dims[2] - 1))
+                      ++corner_count;
+                  }
+                  if (corner_count == 8) {
+                    fill_value = vox_mesh_t::OUTSIDE;
+                  } else if (!corner_count) {
+                    fill_value = vox_mesh_t::INSIDE;
+                  } else if (sum_sum_distances) {
+                    fill_value = sum_sum_distances < 0.0f ? vox_mesh_t::INSIDE : vox_mesh_t::OUTSIDE;
+                  } else {
+                    Exception e ("Internal error: fundamental ambiguity in voxel-based segmentation of surface");
+                    e.push_back ("Fill region size: " + str(to_fill.size()));
+                    e.push_back ("Preliminary classifications: " + str(prelim_inside_count) + " inside, " + str(prelim_outside_count) + " outside");
+                    e.push_back ("FoV corners: " + str(corner_count));
+                    throw e;
+                  }
                 }
+                for (const auto& voxel : to_fill)
+                  init_seg[voxel_index (voxel)] = fill_value;
+                to_fill.clear();
               }
-              for (const auto& voxel : to_fill) {
-                assign_pos_of (voxel).to (init_seg);
-                init_seg.value() = fill_value;
-              }
-              to_fill.clear();
             }
           }
           ++progress;
 
           // Any voxel not yet processed must lie outside the structure(s)
-          for (auto l = Loop(init_seg) (init_seg); l; ++l) {
-            if (init_seg.value() == vox_mesh_t::UNDEFINED)
-              init_seg.value() = vox_mesh_t::OUTSIDE;
+          for (auto& value : init_seg) {
+            if (value == vox_mesh_t::UNDEFINED)
+              value = vox_mesh_t::OUTSIDE;
           }
           ++progress;
 
           // Write initial ternary segmentation
-          for (auto l = Loop (init_seg) (init_seg, image); l; ++l) {
-            switch (init_seg.value()) {
+          ThreadedLoop (image, 0, 3).run ([&] (Image<float>& out) {
+            switch (init_seg[out.index(0) + dims[0] * (out.index(1) + dims[1] * size_t(out.index(2)))]) {
               case vox_mesh_t (UNDEFINED): throw Exception ("Code error: poor filling of initial mesh estimate"); break;
-              case vox_mesh_t (ON_MESH):   image.value() = 0.5; break;
-              case vox_mesh_t (OUTSIDE):   image.value() = 0.0; break;
-              case vox_mesh_t (INSIDE):    image.value() = 1.0; break;
+              case vox_mesh_t (ON_MESH):   out.value() = 0.5; break;
+              case vox_mesh_t (OUTSIDE):   out.value() = 0.0; break;
+              case vox_mesh_t (INSIDE):    out.value() = 1.0; break;
               default: assert (0);
             }
-          }
+          }, image);
 
         }
 
         // Construct class functors necessary to calculate, for each voxel intersected by the
         //   surface, the partial volume fraction
         class Source
-        { MEMALIGN(Source)
+        { NOMEMALIGN
           public:
-            Source (const Vox2Poly& data) :
-                data (data),
-                i (data.begin()) { }
+            Source (const size_t count) :
+                count (count),
+                i (0) { }
 
-            bool operator() (std::pair<Vox, vector<size_t>>& out)
+            bool operator() (size_t& out)
             {
-              if (i == data.end())
+              if (i == count)
                 return false;
-              out = std::make_pair (i->first, i->second);
-              ++i;
+              out = i++;
               return true;
             }
 
           private:
-            const Vox2Poly& data;
-            Vox2Poly::const_iterator i;
+            const size_t count;
+            size_t i;
         };
 
         class Pipe
         { NOMEMALIGN
           public:
-            Pipe (const Mesh& mesh, const vector<Eigen::Vector3>& polygon_normals) :
+            Pipe (const Mesh& mesh, const vector<Eigen::Vector3>& polygon_normals, const EdgeVoxels& edge) :
                 mesh (mesh),
-                polygon_normals (polygon_normals)
+                polygon_normals (polygon_normals),
+                edge (edge)
 
             {
               // Generate a set of points within this voxel that need to be tested individually
@@ -396,9 +461,30 @@ namespace MR
               }
             }
 
-            bool operator() (const std::pair<Vox, vector<size_t>>& in, std::pair<Vox, float>& out) const
+            bool operator() (const size_t& in, std::pair<Vox, float>& out)
             {
-              const Vox& voxel (in.first);
+              const Vox& voxel (edge.voxels[in]);
+
+              // Those quantities that do not depend on the point being tested are
+              //   computed once for each polygon near this voxel
+              polygons.resize (edge.offsets[in+1] - edge.offsets[in]);
+              for (size_t i = 0; i != polygons.size(); ++i) {
+                const size_t polygon_index = edge.polygons[edge.offsets[in] + i];
+                PolygonData& data (polygons[i]);
+                data.n = polygon_normals[polygon_index];
+                if (polygon_index < mesh.num_triangles()) {
+                  mesh.load_triangle_vertices (data.v, polygon_index);
+                  const VertexList& v (data.v);
+                  data.centre = (v[0] + v[1] + v[2]) * (1.0/3.0);
+                  data.edge_normals[0] = (v[1]-v[2]).cross (data.n); data.edge_normals[0].normalize();
+                  data.edge_normals[1] = (v[2]-v[0]).cross (data.n); data.edge_normals[1].normalize();
+                  data.edge_normals[2] = (v[0]-v[1]).cross (data.n); data.edge_normals[2].normalize();
+                } else {
+                  mesh.load_quad_vertices (data.v, polygon_index - mesh.num_triangles());
+                  const VertexList& v (data.v);
+                  data.centre = (v[0] + v[1] + v[2] + v[3]) * 0.25;
+                }
+              }
 
               // Count the number of these points that lie inside the mesh
               size_t inside_mesh_count = 0;
@@ -411,11 +497,9 @@ namespace MR
                 default_type best_min_distance_from_interior_projection = std::numeric_limits<default_type>::infinity();
 
                 // Only test against those polygons that are near this voxel
-                for (vector<size_t>::const_iterator polygon_index = in.second.begin(); polygon_index != in.second.end(); ++polygon_index) {
-                  const Eigen::Vector3& n (polygon_normals[*polygon_index]);
-
-                  const size_t polygon_num_vertices = (*polygon_index < mesh.num_triangles()) ? 3 : 4;
-                  VertexList v;
+                for (const auto& polygon : polygons) {
+                  const Eigen::Vector3& n (polygon.n);
+                  const VertexList& v (polygon.v);
 
                   bool is_inside = false;
                   default_type min_edge_distance_on_plane = std::numeric_limits<default_type>::infinity();
@@ -428,44 +512,27 @@ namespace MR
                   // If point does lie within projection of polygon (potentially more than one), then the
                   //   polygon to which the distance from the plane is minimal classifies the point
 
-                  if (polygon_num_vertices == 3) {
-
-                    mesh.load_triangle_vertices (v, *polygon_index);
+                  // First: is it aligned with the normal?
+                  const Vertex diff (p - polygon.centre);
+                  distance_from_plane = diff.dot (n);
+                  is_inside = (distance_from_plane <= 0.0);
 
-                    // First: is it aligned with the normal?
-                    const Vertex poly_centre ((v[0] + v[1] + v[2]) * (1.0/3.0));
-                    const Vertex diff (p - poly_centre);
-                    distance_from_plane = diff.dot (n);
-                    is_inside = (distance_from_plane <= 0.0);
+                  // Second: how well does it project onto this polygon?
+                  const Vertex p_on_plane (p - (n * (diff.dot (n))));
 
-                    // Second: how well does it project onto this polygon?
-                    const Vertex p_on_plane (p - (n * (diff.dot (n))));
+                  if (v.size() == 3) {
 
                     std::array<default_type, 3> edge_distances;
-                    Vertex zero = (v[1]-v[2]).cross (n); zero.normalize();
-                    Vertex one  = (v[2]-v[0]).cross (n); one .normalize();
-                    Vertex two  = (v[0]-v[1]).cross (n); two .normalize();
-                    edge_distances[0] = (p_on_plane-v[2]).dot (zero);
-                    edge_distances[1] = (p_on_plane-v[0]).dot (one);
-                    edge_distances[2] = (p_on_plane-v[1]).dot (two);
+                    edge_distances[0] = (p_on_plane-v[2]).dot (polygon.edge_normals[0]);
+                    edge_distances[1] = (p_on_plane-v[0]).dot (polygon.edge_normals[1]);
+                    edge_distances[2] = (p_on_plane-v[1]).dot (polygon.edge_normals[2]);
                     min_edge_distance_on_plane = std::min ( { edge_distances[0], edge_distances[1], edge_distances[2] } );
 
                   } else {
 
-                    mesh.load_quad_vertices (v, *polygon_index);
-
                     // This may be slightly ill-posed with a quad; no guarantee of fixed normal
                     // Proceed regardless
 
-                    // First: is it aligned with the normal?
-                    const Vertex poly_centre ((v[0] + v[1] + v[2] + v[3]) * 0.25);
-                    const Vertex diff (p - poly_centre);
-                    distance_from_plane = diff.dot (n);
-                    is_inside = (distance_from_plane <= 0.0);
-
-                    // Second: how well does it project onto this polygon?
-                    const Vertex p_on_plane (p - (n * (diff.dot (n))));
-
                     for (int edge = 0; edge != 4; ++edge) {
                       // Want an appropriate vector emanating from this edge from which to test the 'on-plane' distance
                       //   (bearing in mind that there may not be a uniform normal)
@@ -517,9 +584,20 @@ namespace MR
           private:
             const Mesh& mesh;
             const vector<Eigen::Vector3>& polygon_normals;
+            const EdgeVoxels& edge;
 
             std::shared_ptr<vector<Eigen::Vector3>> offsets_to_test;
 
+            class PolygonData
+            { NOMEMALIGN
+              public:
+                VertexList v;
+                Eigen::Vector3 n, centre;
+                // For triangles only: normals to each edge within the plane of the polygon
+                std::array<Eigen::Vector3, 3> edge_normals;
+            };
+            vector<PolygonData> polygons;
+
         };
 
         class Sink
@@ -544,12 +622,12 @@ namespace MR
 
         };
 
-        Source source (voxel2poly);
-        Pipe pipe (mesh, polygon_normals);
-        Sink sink (image, voxel2poly.size());
+        Source source (edge.voxels.size());
+        Pipe pipe (mesh, polygon_normals, edge);
+        Sink sink (image, edge.voxels.size());
 
         Thread::run_queue (source,
-                           std::pair<Vox, vector<size_t>>(),
+                           size_t(),
                            Thread::multi (pipe),
                            std::pair<Vox, float>(),
                            sink);
@@ -561,5 +639,3 @@ namespace MR
     }
   }
 }
-
-
@@ -132,6 +132,83 @@ void run ()
 
 
 
+  // warm starts: solution should not depend on the initial active set
+
+  vector_type perturbed_problem_vector (problem_vector);
+  for (ssize_t n = 0; n < perturbed_problem_vector.size(); ++n)
+    perturbed_problem_vector[n] += 0.05 * std::sin (double(n));
+
+  {
+    vector_type x, x_cold;
+    Math::ICLS::Problem<double> problem (problem_matrix, inequality_constraint_matrix, equality_constraint_matrix, inequality_constraint_vector, equality_constraint_vector);
+    Math::ICLS::Solver<double> solve (problem);
+    solve (x, problem_vector);
+    const vector<bool> active_set (solve.active_set());
+
+    solve (x, problem_vector, active_set);
+    if (!x.isApprox (solution, 1.0e-6))
+      throw Exception ("ICLS solver test failed at warm start test 1");
+
+    solve (x_cold, perturbed_problem_vector);
+    solve (x, perturbed_problem_vector, active_set);
+    if (!x.isApprox (x_cold, 1.0e-6))
+      throw Exception ("ICLS solver test failed at warm start test 2");
+
+    vector<bool> arbitrary_set (problem.num_constraints(), false);
+    for (size_t n = 0; n < num_ineq; n += 3)
+      arbitrary_set[n] = true;
+    solve (x, problem_vector, arbitrary_set);
+    if (!x.isApprox (solution, 1.0e-6))
+      throw Exception ("ICLS solver test failed at warm start test 3");
+  }
+
+  {
+    vector_type x, x_cold;
+    Math::ICLS::Problem<double> problem (problem_matrix, inequality_constraint_matrix, inequality_constraint_vector);
+    Math::ICLS::Solver<double> solve (problem);
+    solve (x, problem_vector);
+    const vector<bool> active_set (solve.active_set());
+
+    solve (x, problem_vector, active_set);
+    if (!x.isApprox (solution_no_eq, 1.0e-6))
+      throw Exception ("ICLS solver test failed at warm start test 4");
+
+    solve (x_cold, perturbed_problem_vector);
+    solve (x, perturbed_problem_vector, active_set);
+    if (!x.isApprox (x_cold, 1.0e-6))
+      throw Exception ("ICLS solver test failed at warm start test 5");
+
+    solve (x, problem_vector, vector<bool> (problem.num_constraints(), true));
+    if (!x.isApprox (solution_no_eq, 1.0e-6))
+      throw Exception ("ICLS solver test failed at warm start test 6");
+  }
+
+
+
+  // linearly dependent constraints: x1 >= 0, x2 >= 0 and x1 + x2 >= 1, with
+  // the third becoming violated only once the first two are active
+
+  {
+    vector_type x;
+    matrix_type A (3, 2);
+    A << 1.0, 0.0,
+         0.0, 1.0,
+         1.0, 1.0;
+    vector_type t (3);
+    t << 0.0, 0.0, 1.0;
+    vector_type b (2);
+    b << -20.0, -5.0;
+    vector_type expected (2);
+    expected << 0.0, 1.0;
+    Math::ICLS::Problem<double> problem (matrix_type::Identity (2, 2), A, t);
+    Math::ICLS::Solver<double> solve (problem);
+    solve (x, b);
+    if (!x.isApprox (expected, 1.0e-6))
+      throw Exception ("ICLS solver test failed at dependent constraint test");
+  }
+
+
+
 
   CONSOLE ("All tests passed OK");
 
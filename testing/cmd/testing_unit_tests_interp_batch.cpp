@@ -0,0 +1,136 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "header.h"
+#include "image.h"
+#include "adapter/subset.h"
+#include "interp/cubic.h"
+#include "interp/linear.h"
+#include "interp/nearest.h"
+
+
+using namespace MR;
+using namespace App;
+
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+
+  SYNOPSIS = "Verify that batched interpolation matches interpolation of individual points";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+using value_type = float;
+using positions_type = Eigen::Matrix<default_type,3,Eigen::Dynamic>;
+using values_type = Eigen::Matrix<value_type,Eigen::Dynamic,1>;
+using rows_type = Eigen::Matrix<value_type,Eigen::Dynamic,Eigen::Dynamic>;
+
+
+
+bool same (const value_type a, const value_type b)
+{
+  if (std::isnan (a) || std::isnan (b))
+    return std::isnan (a) && std::isnan (b);
+  return std::abs (a - b) <= 1e-5 * (1.0 + std::abs (a));
+}
+
+
+
+template <class InterpType>
+void check_values (InterpType& interp, const positions_type& positions, const std::string& name)
+{
+  values_type batch;
+  interp.scanner_values (positions, batch);
+  for (ssize_t n = 0; n != positions.cols(); ++n) {
+    interp.scanner (positions.col (n));
+    if (!same (batch[n], interp.value()))
+      throw Exception ("batched values differ from individual values for " + name + " interpolator (point " + str(n)
+                       + ": " + str(batch[n]) + " vs " + str(interp.value()) + ")");
+  }
+}
+
+
+
+template <class InterpType>
+void check_rows (InterpType& interp, const positions_type& positions, const std::string& name)
+{
+  rows_type batch;
+  interp.scanner_rows (positions, batch);
+  for (ssize_t n = 0; n != positions.cols(); ++n) {
+    interp.scanner (positions.col (n));
+    const values_type row = interp.row (3);
+    for (ssize_t v = 0; v != row.size(); ++v) {
+      if (!same (batch (v, n), row[v]))
+        throw Exception ("batched rows differ from individual rows for " + name + " interpolator (point " + str(n) + ")");
+    }
+  }
+}
+
+
+
+template <class ImageType>
+void check_all (const ImageType& image, const positions_type& positions, const std::string& name)
+{
+  Interp::Nearest<ImageType> nearest (image);
+  check_values (nearest, positions, "nearest (" + name + ")");
+  Interp::Linear<ImageType> linear (image);
+  check_values (linear, positions, "linear (" + name + ")");
+  check_rows (linear, positions, "linear (" + name + ")");
+  Interp::Cubic<ImageType> cubic (image, 0.0);
+  check_values (cubic, positions, "cubic (" + name + ")");
+  check_rows (cubic, positions, "cubic (" + name + ")");
+
+  // values along axis 3 other than the first
+  nearest.index(3) = linear.index(3) = cubic.index(3) = 2;
+  check_values (nearest, positions, "nearest (" + name + ", volume 2)");
+  check_values (linear, positions, "linear (" + name + ", volume 2)");
+  check_values (cubic, positions, "cubic (" + name + ", volume 2)");
+}
+
+
+
+void run ()
+{
+  Header header;
+  header.ndim() = 4;
+  header.size(0) = 13; header.size(1) = 9; header.size(2) = 7; header.size(3) = 5;
+  header.spacing(0) = 2.0; header.spacing(1) = 2.5; header.spacing(2) = 3.0; header.spacing(3) = 1.0;
+  header.transform().setIdentity();
+  header.transform().translation() = Eigen::Vector3 (-10.0, 4.0, 7.5);
+  header.stride(0) = 2; header.stride(1) = 3; header.stride(2) = 4; header.stride(3) = 1;
+
+  auto image = Image<value_type>::scratch (header);
+  for (auto l = Loop (image) (image); l; ++l)
+    image.value() = Eigen::Matrix<value_type,1,1>::Random()[0];
+
+  // Includes positions outside the image, and more positions than a single block
+  positions_type positions = positions_type::Random (3, 1000);
+  for (ssize_t n = 0; n != positions.cols(); ++n)
+    positions.col(n) = Transform (image).voxel2scanner * Eigen::Vector3 (
+        (positions(0,n) + 1.0) * 0.6 * image.size(0) - 1.0,
+        (positions(1,n) + 1.0) * 0.6 * image.size(1) - 1.0,
+        (positions(2,n) + 1.0) * 0.6 * image.size(2) - 1.0);
+
+  // Direct memory access
+  check_all (image, positions, "direct");
+
+  // Access through an adapter
+  Adapter::Subset<Image<value_type>> subset (image, vector<int> { 0, 0, 0, 0 }, vector<int> { 13, 9, 7, 5 });
+  check_all (subset, positions, "adapter");
+}
@@ -0,0 +1,127 @@
+/* Copyright (c) 2008-2020 the MRtrix3 contributors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Covered Software is provided under this License on an "as is"
+ * basis, without warranty of any kind, either expressed, implied, or
+ * statutory, including, without limitation, warranties that the
+ * Covered Software is free of defects, merchantable, fit for a
+ * particular purpose or non-infringing.
+ * See the Mozilla Public License v. 2.0 for more details.
+ *
+ * For more details, see http://www.mrtrix.org/.
+ */
+
+#include "command.h"
+#include "header.h"
+#include "image.h"
+#include "algo/loop.h"
+#include "connectome/enhance.h"
+#include "connectome/mat2vec.h"
+#include "misc/voxel2vector.h"
+#include "stats/cluster.h"
+#include "stats/tfce.h"
+
+
+using namespace MR;
+using namespace App;
+
+
+void usage ()
+{
+  AUTHOR = "agent (agent@local)";
+
+  SYNOPSIS = "Verify that single-pass TFCE integration matches integration over explicit thresholds";
+
+  REQUIRES_AT_LEAST_ONE_ARGUMENT = false;
+}
+
+using value_type = Math::Stats::value_type;
+using matrix_type = Math::Stats::matrix_type;
+
+const value_type dh = 0.1, E = 0.5, H = 2.0;
+
+
+
+// Explicit integration, using the enhancer at each threshold in turn
+template <class EnhancerType>
+matrix_type reference (EnhancerType& enhancer, const matrix_type& input)
+{
+  matrix_type result = matrix_type::Zero (input.rows(), 1);
+  matrix_type temp (input.rows(), 1);
+  const value_type max_input_value = input.maxCoeff();
+  for (value_type h = dh; (h-dh) < max_input_value; h += dh) {
+    enhancer.set_threshold (h);
+    static_cast<const Stats::EnhancerBase&> (enhancer) (input, temp);
+    for (ssize_t i = 0; i != input.rows(); ++i)
+      result(i,0) += std::pow (temp(i,0), E) * std::pow (h, H);
+  }
+  return result;
+}
+
+
+
+void compare (const matrix_type& a, const matrix_type& b, const std::string& name)
+{
+  for (ssize_t i = 0; i != a.rows(); ++i) {
+    if (std::abs (a(i,0) - b(i,0)) > 1e-9 * (1.0 + std::abs (a(i,0))))
+      throw Exception ("single-pass TFCE differs from explicit integration for " + name + " (element " + str(i)
+                       + ": " + str(b(i,0)) + " vs " + str(a(i,0)) + ")");
+  }
+}
+
+
+
+void run ()
+{
+  // Voxel-wise clusters within a mask, using both 6- and 26-connectivity
+  Header header;
+  header.ndim() = 3;
+  header.size(0) = 17; header.size(1) = 13; header.size(2) = 11;
+  header.spacing(0) = header.spacing(1) = header.spacing(2) = 1.0;
+  header.transform().setIdentity();
+  header.datatype() = DataType::Bit;
+
+  auto mask = Image<bool>::scratch (header);
+  for (auto l = Loop (mask) (mask); l; ++l)
+    mask.value() = (Eigen::Matrix<value_type,1,1>::Random()[0] > -0.8);
+  Voxel2Vector v2v (mask, header);
+
+  // Spatially smooth statistics, such that clusters merge over a range of heights
+  matrix_type input (v2v.size(), 1);
+  for (size_t i = 0; i != v2v.size(); ++i) {
+    const auto& v = v2v[i];
+    input(i,0) = 2.0 + 1.5 * std::sin (0.5*v[0]) * std::cos (0.4*v[1]) * std::sin (0.7*v[2] + 0.3)
+                 + 0.5 * Eigen::Matrix<value_type,1,1>::Random()[0];
+  }
+
+  for (const bool use_26_neighbours : { false, true }) {
+    Filter::Connector connector;
+    connector.adjacency.set_26_adjacency (use_26_neighbours);
+    connector.adjacency.initialise (header, v2v);
+
+    std::shared_ptr<Stats::Cluster::ClusterSize> cluster_size (new Stats::Cluster::ClusterSize (connector, 0.0));
+    Stats::TFCE::Wrapper wrapper (cluster_size, dh, E, H);
+    matrix_type result (input.rows(), 1);
+    static_cast<const Stats::EnhancerBase&> (wrapper) (input, result);
+    compare (reference (*cluster_size, input), result, use_26_neighbours ? "26-connectivity" : "6-connectivity");
+  }
+
+  // Network-based statistic: edges are adjacent if they share a node
+  const Connectome::node_t num_nodes = 12;
+  const Connectome::Mat2Vec mat2vec (num_nodes);
+  matrix_type edge_input (mat2vec.vec_size(), 1);
+  for (ssize_t i = 0; i != edge_input.rows(); ++i)
+    edge_input(i,0) = 1.5 + 1.5 * Eigen::Matrix<value_type,1,1>::Random()[0];
+  // Include statistics lying exactly on a threshold
+  edge_input(1,0) = edge_input(2,0) = 10*dh;
+
+  std::shared_ptr<Connectome::Enhance::NBS> nbs (new Connectome::Enhance::NBS (num_nodes));
+  Stats::TFCE::Wrapper wrapper (nbs, dh, E, H);
+  matrix_type result (edge_input.rows(), 1);
+  static_cast<const Stats::EnhancerBase&> (wrapper) (edge_input, result);
+  compare (reference (*nbs, edge_input), result, "network-based statistic");
+}
+